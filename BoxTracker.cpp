@@ -0,0 +1,165 @@
+#include "BoxTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BOX_TRACKER_SSE2
+#endif
+
+namespace
+{
+	// Patches are at most this many gray pixels across, and their widths are multiples of 8, so that
+	// every row is a whole number of vector steps.
+	const int maxPatchSize = 32;
+	const int patchAlignment = 8;
+
+	struct Sums
+	{
+		int64_t product;
+		int64_t sum;
+		int64_t squares;
+	};
+
+	// Sums the products of a row of pixels with a row of weights, and the pixels and their squares.
+	void sumRow(const uint8_t* pixels, const int16_t* weights, int width, Sums* sums)
+	{
+		int x = 0;
+#ifdef BOX_TRACKER_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ones = _mm_set1_epi16(1);
+		__m128i products = zero;
+		__m128i values = zero;
+		__m128i squares = zero;
+		for (; x + 8 <= width; x += 8)
+		{
+			// Eight pixels widened to 16 bits, multiplied and summed in pairs into 32-bit lanes.
+			const __m128i pixel = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels + x)), zero);
+			const __m128i weight = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + x));
+			products = _mm_add_epi32(products, _mm_madd_epi16(pixel, weight));
+			values = _mm_add_epi32(values, _mm_madd_epi16(pixel, ones));
+			squares = _mm_add_epi32(squares, _mm_madd_epi16(pixel, pixel));
+		}
+
+		int32_t lanes[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), products);
+		sums->product += static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), values);
+		sums->sum += static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), squares);
+		sums->squares += static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#endif
+		for (; x < width; ++x)
+		{
+			sums->product += pixels[x] * weights[x];
+			sums->sum += pixels[x];
+			sums->squares += pixels[x] * pixels[x];
+		}
+	}
+}
+
+void BoxTracker::reset(const std::vector<Box>& boxes, const GrayImage& frame)
+{
+	trackedBoxes = boxes;
+	matchConfidences.assign(boxes.size(), 1.0f);
+	frameWidth = frame.width;
+	frameHeight = frame.height;
+
+	patches.clear();
+	for (const Letterbox& rect : cropBoxes(boxes, frame.width, frame.height))
+	{
+		// The middle of the box, which is the part least likely to contain background.
+		Patch patch;
+		patch.width = std::min(std::max(std::min(rect.width, maxPatchSize), patchAlignment), frame.width) / patchAlignment * patchAlignment;
+		patch.height = std::min(std::max(std::min(rect.height, maxPatchSize), patchAlignment), frame.height);
+		patch.x = std::min(std::max(rect.x + (rect.width - patch.width) / 2, 0), frame.width - patch.width);
+		patch.y = std::min(std::max(rect.y + (rect.height - patch.height) / 2, 0), frame.height - patch.height);
+		patch.norm = 0.0f;
+
+		if (patch.width > 0)
+		{
+			int sum = 0;
+			for (int y = 0; y < patch.height; ++y)
+			{
+				const uint8_t* row = frame.row(patch.y + y) + patch.x;
+				for (int x = 0; x < patch.width; ++x)
+				{
+					sum += row[x];
+				}
+			}
+			const int count = patch.width * patch.height;
+			const int mean = (sum + count / 2) / count;
+
+			double squares = 0.0;
+			patch.weights.resize(count);
+			for (int y = 0; y < patch.height; ++y)
+			{
+				const uint8_t* row = frame.row(patch.y + y) + patch.x;
+				for (int x = 0; x < patch.width; ++x)
+				{
+					const int weight = row[x] - mean;
+					patch.weights[y * patch.width + x] = static_cast<int16_t>(weight);
+					squares += weight * weight;
+				}
+			}
+			patch.norm = static_cast<float>(std::sqrt(squares));
+		}
+		patches.push_back(patch);
+	}
+}
+
+float BoxTracker::update(const GrayImage& frame, int radius)
+{
+	// Positions from a differently sized frame mean nothing, so those boxes are lost.
+	const bool sameSize = frame.width == frameWidth && frame.height == frameHeight;
+
+	float lowest = 1.0f;
+	for (size_t i = 0; i < patches.size(); ++i)
+	{
+		Patch& patch = patches[i];
+		if (!sameSize || patch.norm <= 0.0f)
+		{
+			// A flat patch has nothing to match against.
+			matchConfidences[i] = 0.0f;
+			lowest = 0.0f;
+			continue;
+		}
+
+		const int count = patch.width * patch.height;
+		float best = -1.0f;
+		int bestX = patch.x;
+		int bestY = patch.y;
+		for (int y = std::max(patch.y - radius, 0); y <= std::min(patch.y + radius, frame.height - patch.height); ++y)
+		{
+			for (int x = std::max(patch.x - radius, 0); x <= std::min(patch.x + radius, frame.width - patch.width); ++x)
+			{
+				Sums sums = {};
+				for (int row = 0; row < patch.height; ++row)
+				{
+					sumRow(frame.row(y + row) + x, patch.weights.data() + row * patch.width, patch.width, &sums);
+				}
+
+				// The weights sum to (about) zero, so the product is already the covariance.
+				const double variance = sums.squares - static_cast<double>(sums.sum) * sums.sum / count;
+				const float correlation = variance > 0.0 ? static_cast<float>(sums.product / (std::sqrt(variance) * patch.norm)) : 0.0f;
+				if (correlation > best)
+				{
+					best = correlation;
+					bestX = x;
+					bestY = y;
+				}
+			}
+		}
+
+		// Boxes are normalized with the origin at the bottom, the gray image is stored top-down.
+		trackedBoxes[i].x += static_cast<float>(bestX - patch.x) / frame.width;
+		trackedBoxes[i].y -= static_cast<float>(bestY - patch.y) / frame.height;
+		patch.x = bestX;
+		patch.y = bestY;
+
+		matchConfidences[i] = std::min(std::max(best, 0.0f), 1.0f);
+		lowest = std::min(lowest, matchConfidences[i]);
+	}
+	return lowest;
+}
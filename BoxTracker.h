@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Boxes.h"
+#include "GrayImage.h"
+
+// Carries boxes forward between runs of the model by template matching. On a keyframe, a patch from
+// the middle of each box is cut out of a gray copy of the frame. Every later frame searches a small
+// window around each box's last position for the offset where the patch's normalized
+// cross-correlation (NCC) is highest. The best NCC doubles as the tracker's confidence: it drops
+// when the content of a box changes, or leaves the search window, which is when the model should
+// run again.
+//
+// Patches are always matched against the keyframe, so the boxes don't drift. Box sizes are kept as
+// they were on the keyframe.
+class BoxTracker
+{
+public:
+	// Starts tracking `boxes` in `frame`, replacing whatever was tracked before.
+	void reset(const std::vector<Box>& boxes, const GrayImage& frame);
+
+	// Moves every box to its best match within `radius` gray pixels of its last position, and
+	// returns the lowest confidence of any box (1 if there are none). The sums are vectorized (SSE2).
+	float update(const GrayImage& frame, int radius);
+
+	const std::vector<Box>& boxes() const
+	{
+		return trackedBoxes;
+	}
+
+	// The NCC (0-1) of each box's last match.
+	const std::vector<float>& confidences() const
+	{
+		return matchConfidences;
+	}
+
+	size_t size() const
+	{
+		return trackedBoxes.size();
+	}
+
+private:
+	// A patch in the gray image's pixels, with its values stored minus their mean, so that the
+	// correlation with a candidate doesn't depend on the candidate's brightness.
+	struct Patch
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+		std::vector<int16_t> weights;
+		float norm;
+	};
+
+	std::vector<Box> trackedBoxes;
+	std::vector<float> matchConfidences;
+	std::vector<Patch> patches;
+	int frameWidth = 0;
+	int frameHeight = 0;
+};
@@ -0,0 +1,87 @@
+#include "Boxes.h"
+
+#include <algorithm>
+#include <string>
+
+std::vector<Box> readBoxes(const OP_CHOPInput* chop)
+{
+	std::vector<Box> boxes;
+	if (chop == nullptr || chop->numChannels < 4)
+	{
+		return boxes;
+	}
+
+	const char* names[] = { "x", "y", "w", "h" };
+	const float* channels[4];
+	for (int c = 0; c < 4; ++c)
+	{
+		channels[c] = chop->getChannelData(c);
+		for (int i = 0; i < chop->numChannels; ++i)
+		{
+			if (std::string(chop->getChannelName(i)) == names[c])
+			{
+				channels[c] = chop->getChannelData(i);
+				break;
+			}
+		}
+	}
+
+	for (int i = 0; i < chop->numSamples; ++i)
+	{
+		boxes.push_back({ channels[0][i], channels[1][i], channels[2][i], channels[3][i] });
+	}
+	return boxes;
+}
+
+std::vector<Box> pyramidBoxes(int levels)
+{
+	std::vector<Box> boxes;
+	boxes.push_back({ 0.0f, 0.0f, 1.0f, 1.0f });
+
+	float size = 1.0f;
+	for (int level = 1; level < levels; ++level)
+	{
+		size *= 0.5f;
+		const float far = 1.0f - size;
+		boxes.push_back({ far * 0.5f, far * 0.5f, size, size });
+		boxes.push_back({ 0.0f, 0.0f, size, size });
+		boxes.push_back({ far, 0.0f, size, size });
+		boxes.push_back({ 0.0f, far, size, size });
+		boxes.push_back({ far, far, size, size });
+	}
+	return boxes;
+}
+
+std::vector<Box> fiveCropBoxes(float size)
+{
+	size = std::min(std::max(size, 0.0f), 1.0f);
+	const float far = 1.0f - size;
+
+	std::vector<Box> boxes;
+	boxes.push_back({ far * 0.5f, far * 0.5f, size, size });
+	boxes.push_back({ 0.0f, 0.0f, size, size });
+	boxes.push_back({ far, 0.0f, size, size });
+	boxes.push_back({ 0.0f, far, size, size });
+	boxes.push_back({ far, far, size, size });
+	return boxes;
+}
+
+std::vector<Letterbox> cropBoxes(const std::vector<Box>& boxes, int width, int height)
+{
+	std::vector<Letterbox> crops;
+	for (const Box& box : boxes)
+	{
+		const int left = std::min(std::max(static_cast<int>(box.x * width), 0), width - 1);
+		const int right = std::min(std::max(static_cast<int>((box.x + box.width) * width), left + 1), width);
+		const int top = std::min(std::max(static_cast<int>((1.0f - box.y - box.height) * height), 0), height - 1);
+		const int bottom = std::min(std::max(static_cast<int>((1.0f - box.y) * height), top + 1), height);
+
+		Letterbox crop;
+		crop.x = left;
+		crop.y = top;
+		crop.width = right - left;
+		crop.height = bottom - top;
+		crops.push_back(crop);
+	}
+	return crops;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include "CPlusPlus_Common.h"
+#include "ShapeBuckets.h"
+
+// A rectangle in normalized coordinates (0-1), with TouchDesigner's origin at the bottom left.
+struct Box
+{
+	float x;
+	float y;
+	float width;
+	float height;
+};
+
+inline bool operator==(const Box& a, const Box& b)
+{
+	return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+inline bool operator!=(const Box& a, const Box& b)
+{
+	return !(a == b);
+}
+
+// Reads one box per sample from channels named x, y, w and h (or the first four channels).
+std::vector<Box> readBoxes(const OP_CHOPInput* chop);
+
+// The boxes of an image pyramid: the whole image, then for every further level a center crop and the
+// four corner crops at half the size of the previous level.
+std::vector<Box> pyramidBoxes(int levels);
+
+// The center crop and the four corner crops of an image, each `size` (0-1) of its width and height.
+// Together with their mirrored copies, these are the standard ten crops of test-time augmentation.
+std::vector<Box> fiveCropBoxes(float size);
+
+// Converts boxes into pixel rectangles of an image that is stored top-down (as downloaded with
+// `verticalFlip`). Boxes are clipped to the image, and every box keeps at least one pixel.
+std::vector<Letterbox> cropBoxes(const std::vector<Box>& boxes, int width, int height);
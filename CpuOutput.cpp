@@ -0,0 +1,277 @@
+#include "CpuOutput.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+	uint8_t toByte(float value)
+	{
+		return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	void writePixel(uint8_t* pixel, float r, float g, float b, float a)
+	{
+		pixel[0] = toByte(b);
+		pixel[1] = toByte(g);
+		pixel[2] = toByte(r);
+		pixel[3] = toByte(a);
+	}
+
+	void writeClassColor(uint8_t* pixel, float index)
+	{
+		// Class 0 is usually the background.
+		const uint32_t label = static_cast<uint32_t>(std::max(index, 0.0f) + 0.5f);
+		if (label == 0)
+		{
+			writePixel(pixel, 0.0f, 0.0f, 0.0f, 1.0f);
+			return;
+		}
+
+		uint32_t hash = label * 2654435761u;
+		hash ^= hash >> 16;
+		const float r = (hash & 0xff) / 255.0f;
+		const float g = ((hash >> 8) & 0xff) / 255.0f;
+		const float b = ((hash >> 16) & 0xff) / 255.0f;
+		writePixel(pixel, r * 0.75f + 0.25f, g * 0.75f + 0.25f, b * 0.75f + 0.25f, 1.0f);
+	}
+
+	// Bilinear taps along one axis, with the same sampling as a `GL_LINEAR` texture lookup.
+	struct Taps
+	{
+		std::vector<int> first;
+		std::vector<int> second;
+		std::vector<float> lerp;
+	};
+
+	Taps linearTaps(int outputSize, int inputSize)
+	{
+		Taps taps;
+		taps.first.resize(outputSize);
+		taps.second.resize(outputSize);
+		taps.lerp.resize(outputSize);
+
+		for (int i = 0; i < outputSize; ++i)
+		{
+			const float position = std::min(std::max((i + 0.5f) * inputSize / outputSize - 0.5f, 0.0f), static_cast<float>(inputSize - 1));
+			taps.first[i] = static_cast<int>(position);
+			taps.second[i] = std::min(taps.first[i] + 1, inputSize - 1);
+			taps.lerp[i] = position - taps.first[i];
+		}
+		return taps;
+	}
+}
+
+void drawScoreBars(const float* scores, size_t count, int bars, uint8_t* pixels, int width, int height)
+{
+	// Every pixel has to be written, since the memory isn't cleared between frames.
+	std::fill(pixels, pixels + static_cast<size_t>(width) * height * 4, 0);
+
+	bars = std::min(bars, static_cast<int>(count));
+	if (bars <= 0)
+	{
+		return;
+	}
+
+	std::vector<size_t> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	std::partial_sort(order.begin(), order.begin() + bars, order.end(), [scores](size_t a, size_t b)
+	{
+		return scores[a] > scores[b];
+	});
+
+	// Rows are stored bottom-up, so the first bar ends at the last row. Bars are separated by a gap
+	// of one row when there is room for it.
+	const int band = std::max(1, height / bars);
+	const int gap = band > 2 ? 1 : 0;
+	for (int i = 0; i < bars; ++i)
+	{
+		const int length = static_cast<int>(std::min(std::max(scores[order[i]], 0.0f), 1.0f) * width);
+		const int top = height - i * band;
+		for (int y = std::max(0, top - band + gap); y < top; ++y)
+		{
+			uint8_t* row = pixels + static_cast<size_t>(y) * width * 4;
+			std::fill(row, row + length * 4, 255);
+		}
+	}
+}
+
+void drawTensorImage(const tensorflow::Tensor& tensor, const ImageStyle& style, uint8_t* pixels, int width, int height)
+{
+	const int tensorHeight = static_cast<int>(tensor.dim_size(1));
+	const int tensorWidth = static_cast<int>(tensor.dim_size(2));
+	int channels = static_cast<int>(tensor.dim_size(3));
+	const float* data = tensor.flat<float>().data();
+
+	// Per-class scores are reduced to the best class first.
+	std::vector<float> labels;
+	if (channels > 4)
+	{
+		labels.resize(static_cast<size_t>(tensorWidth) * tensorHeight);
+		for (size_t i = 0; i < labels.size(); ++i)
+		{
+			const float* scores = data + i * channels;
+			labels[i] = static_cast<float>(std::max_element(scores, scores + channels) - scores);
+		}
+		data = labels.data();
+		channels = 1;
+	}
+
+	if (style.colormap == 2)
+	{
+		// Class indices must not be interpolated.
+		for (int y = 0; y < height; ++y)
+		{
+			// Rows are stored bottom-up, tensors top-down.
+			const int sourceY = std::min(tensorHeight - 1, (height - 1 - y) * tensorHeight / height);
+			uint8_t* row = pixels + static_cast<size_t>(y) * width * 4;
+			for (int x = 0; x < width; ++x)
+			{
+				const int sourceX = std::min(tensorWidth - 1, x * tensorWidth / width);
+				writeClassColor(row + x * 4, data[(static_cast<size_t>(sourceY) * tensorWidth + sourceX) * channels]);
+			}
+		}
+		return;
+	}
+
+	const Taps columns = linearTaps(width, tensorWidth);
+	const Taps rows = linearTaps(height, tensorHeight);
+
+	float value[4];
+	for (int y = 0; y < height; ++y)
+	{
+		const int flipped = height - 1 - y;
+		const float* topRow = data + static_cast<size_t>(rows.first[flipped]) * tensorWidth * channels;
+		const float* bottomRow = data + static_cast<size_t>(rows.second[flipped]) * tensorWidth * channels;
+		const float yLerp = rows.lerp[flipped];
+		uint8_t* row = pixels + static_cast<size_t>(y) * width * 4;
+
+		for (int x = 0; x < width; ++x)
+		{
+			const float* topLeft = topRow + columns.first[x] * channels;
+			const float* topRight = topRow + columns.second[x] * channels;
+			const float* bottomLeft = bottomRow + columns.first[x] * channels;
+			const float* bottomRight = bottomRow + columns.second[x] * channels;
+
+			for (int c = 0; c < channels; ++c)
+			{
+				const float top = topLeft[c] + (topRight[c] - topLeft[c]) * columns.lerp[x];
+				const float bottom = bottomLeft[c] + (bottomRight[c] - bottomLeft[c]) * columns.lerp[x];
+				value[c] = (top + (bottom - top) * yLerp) * style.gain + style.offset;
+			}
+
+			uint8_t* pixel = row + x * 4;
+			if (style.colormap == 1)
+			{
+				const float t = value[0];
+				writePixel(pixel, 3.0f * t, 3.0f * t - 1.0f, 3.0f * t - 2.0f, 1.0f);
+			}
+			else if (channels == 1)
+			{
+				writePixel(pixel, value[0], value[0], value[0], 1.0f);
+			}
+			else if (channels == 2)
+			{
+				writePixel(pixel, value[0], value[1], 0.0f, 1.0f);
+			}
+			else if (channels == 3)
+			{
+				writePixel(pixel, value[0], value[1], value[2], 1.0f);
+			}
+			else
+			{
+				writePixel(pixel, value[0], value[1], value[2], value[3]);
+			}
+		}
+	}
+}
+
+CpuFrameWriter::CpuFrameWriter() :
+	running(true),
+	working(false),
+	jobPixels(nullptr),
+	jobWidth(0),
+	jobHeight(0),
+	pendingLocation(-1),
+	nextLocation(0)
+{
+	worker = std::thread(&CpuFrameWriter::workerLoop, this);
+}
+
+CpuFrameWriter::~CpuFrameWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_all();
+	worker.join();
+}
+
+void CpuFrameWriter::collect(const TOP_OutputFormatSpecs* outputFormat)
+{
+	if (pendingLocation < 0)
+	{
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this] { return !working; });
+	}
+
+	// A frame rendered before the output was resized is dropped.
+	if (jobWidth == outputFormat->width && jobHeight == outputFormat->height)
+	{
+		outputFormat->newCPUPixelDataLocation = pendingLocation;
+	}
+	nextLocation = (pendingLocation + 1) % locationCount;
+	pendingLocation = -1;
+}
+
+bool CpuFrameWriter::start(const TOP_OutputFormatSpecs* outputFormat, Renderer render)
+{
+	if (pendingLocation >= 0)
+	{
+		return false;
+	}
+
+	// `nextLocation` is never the location that is being uploaded after this `execute()`.
+	pendingLocation = nextLocation;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = std::move(render);
+		jobPixels = static_cast<uint8_t*>(outputFormat->cpuPixelData[pendingLocation]);
+		jobWidth = outputFormat->width;
+		jobHeight = outputFormat->height;
+		working = true;
+	}
+	condition.notify_all();
+
+	return true;
+}
+
+void CpuFrameWriter::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		condition.wait(lock, [this] { return !running || job; });
+		if (!running)
+		{
+			return;
+		}
+
+		Renderer render = std::move(job);
+		job = nullptr;
+
+		lock.unlock();
+		render(jobPixels, jobWidth, jobHeight);
+		lock.lock();
+
+		working = false;
+		condition.notify_all();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "TOP_CPlusPlusBase.h"
+
+#include "tensorflow/core/framework/tensor.h"
+
+// Renderers for the CPU output build (`TENSORFLOW_TOP_CPU_OUTPUT`), in which TouchDesigner uploads
+// the TOP's output from CPU memory and no GL calls are made at all. They write BGRA8 pixels whose
+// first row is the bottom of the image, and don't depend on GL, so they can run (and be checked)
+// headless.
+
+// How an image output is mapped to colors, matching `outputFragShaderSrc`.
+struct ImageStyle
+{
+	// 0: channels as colors, 1: heat ramp of the first channel, 2: class palette.
+	int colormap = 0;
+	float gain = 1.0f;
+	float offset = 0.0f;
+};
+
+// Draws the `bars` highest of `count` scores (e.g. class probabilities) as horizontal bars, with the
+// highest score at the top.
+void drawScoreBars(const float* scores, size_t count, int bars, uint8_t* pixels, int width, int height);
+
+// Upscales a `[1, height, width, channels]` float tensor to the output size and maps it to colors.
+// Tensors with more than four channels are reduced to the index of their highest-scoring channel.
+void drawTensorImage(const tensorflow::Tensor& tensor, const ImageStyle& style, uint8_t* pixels, int width, int height);
+
+// Renders frames into the CPU memory locations that TouchDesigner provides, on a worker thread.
+// A frame started at the end of one `execute()` is rendered while TouchDesigner goes on with the rest
+// of its frame, and is handed over (through `newCPUPixelDataLocation`) in the next `execute()`. The
+// locations rotate, so the worker never writes to the one that is being uploaded.
+class CpuFrameWriter
+{
+public:
+	using Renderer = std::function<void(uint8_t* pixels, int width, int height)>;
+
+	CpuFrameWriter();
+	~CpuFrameWriter();
+
+	// Hands the previously rendered frame (if any) over for upload. Must be called at the start of
+	// every `execute()`, since the memory locations are only guaranteed to be valid until then.
+	void collect(const TOP_OutputFormatSpecs* outputFormat);
+
+	// Starts rendering a frame, returning false if one is still waiting to be collected.
+	bool start(const TOP_OutputFormatSpecs* outputFormat, Renderer render);
+
+	// True if a frame has been started but not collected yet.
+	bool pending() const
+	{
+		return pendingLocation >= 0;
+	}
+
+private:
+	static const int locationCount = 3;
+
+	void workerLoop();
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool running;
+	bool working;
+
+	Renderer job;
+	uint8_t* jobPixels;
+	int jobWidth;
+	int jobHeight;
+
+	int pendingLocation;
+	int nextLocation;
+};
@@ -0,0 +1,347 @@
+#include "DenseFlow.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DENSE_FLOW_SSE2
+#endif
+
+namespace
+{
+	// out = a * b, element-wise.
+	void multiply(const float* a, const float* b, float* out, size_t count)
+	{
+		size_t i = 0;
+#ifdef DENSE_FLOW_SSE2
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			out[i] = a[i] * b[i];
+		}
+	}
+
+	// sums += row (or -= row), element-wise.
+	void accumulate(float* sums, const float* row, size_t count, bool subtract)
+	{
+		size_t i = 0;
+#ifdef DENSE_FLOW_SSE2
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 sum = _mm_loadu_ps(sums + i);
+			const __m128 value = _mm_loadu_ps(row + i);
+			_mm_storeu_ps(sums + i, subtract ? _mm_sub_ps(sum, value) : _mm_add_ps(sum, value));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			sums[i] += subtract ? -row[i] : row[i];
+		}
+	}
+
+	// Replaces every value with the sum over a (2 * radius + 1) square window around it, clipped to
+	// the image. Columns are summed a whole row at a time, rows with a running sum.
+	void boxFilter(float* data, int width, int height, int radius, std::vector<float>* scratch)
+	{
+		const size_t rowSize = width;
+		scratch->resize(rowSize * (height + 1));
+		float* columnSums = scratch->data() + rowSize * height;
+		std::fill(columnSums, columnSums + rowSize, 0.0f);
+		for (int y = 0; y <= std::min(radius, height - 1); ++y)
+		{
+			accumulate(columnSums, data + y * rowSize, rowSize, false);
+		}
+
+		for (int y = 0; y < height; ++y)
+		{
+			std::copy(columnSums, columnSums + rowSize, scratch->data() + y * rowSize);
+			if (y + radius + 1 < height)
+			{
+				accumulate(columnSums, data + (y + radius + 1) * rowSize, rowSize, false);
+			}
+			if (y - radius >= 0)
+			{
+				accumulate(columnSums, data + (y - radius) * rowSize, rowSize, true);
+			}
+		}
+
+		for (int y = 0; y < height; ++y)
+		{
+			const float* in = scratch->data() + y * rowSize;
+			float* out = data + y * rowSize;
+
+			float sum = 0.0f;
+			for (int x = 0; x <= std::min(radius, width - 1); ++x)
+			{
+				sum += in[x];
+			}
+			for (int x = 0; x < width; ++x)
+			{
+				out[x] = sum;
+				if (x + radius + 1 < width)
+				{
+					sum += in[x + radius + 1];
+				}
+				if (x - radius >= 0)
+				{
+					sum -= in[x - radius];
+				}
+			}
+		}
+	}
+
+	// Central differences, one-sided at the edges.
+	void gradients(const float* image, int width, int height, float* gradientX, float* gradientY)
+	{
+		for (int y = 0; y < height; ++y)
+		{
+			const float* row = image + static_cast<size_t>(y) * width;
+			const float* above = image + static_cast<size_t>(std::max(y - 1, 0)) * width;
+			const float* below = image + static_cast<size_t>(std::min(y + 1, height - 1)) * width;
+			float* outX = gradientX + static_cast<size_t>(y) * width;
+			float* outY = gradientY + static_cast<size_t>(y) * width;
+
+			int x = 1;
+#ifdef DENSE_FLOW_SSE2
+			const __m128 half = _mm_set1_ps(0.5f);
+			for (; x + 4 <= width - 1; x += 4)
+			{
+				_mm_storeu_ps(outX + x, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x + 1), _mm_loadu_ps(row + x - 1)), half));
+			}
+#endif
+			for (; x < width - 1; ++x)
+			{
+				outX[x] = (row[x + 1] - row[x - 1]) * 0.5f;
+			}
+			outX[0] = width > 1 ? row[1] - row[0] : 0.0f;
+			if (width > 1)
+			{
+				outX[width - 1] = row[width - 1] - row[width - 2];
+			}
+
+			const float scale = (y > 0 && y < height - 1) ? 0.5f : 1.0f;
+			for (int i = 0; i < width; ++i)
+			{
+				outY[i] = (below[i] - above[i]) * scale;
+			}
+		}
+	}
+
+	// Adds the solution of the (regularized) 2x2 Lucas-Kanade system of every pixel to the flow.
+	void solve(const float* xx, const float* xy, const float* yy, const float* errorX, const float* errorY, float regularization, size_t count, float* flowX, float* flowY)
+	{
+		size_t i = 0;
+#ifdef DENSE_FLOW_SSE2
+		const __m128 lambda = _mm_set1_ps(regularization);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 a = _mm_add_ps(_mm_loadu_ps(xx + i), lambda);
+			const __m128 b = _mm_loadu_ps(xy + i);
+			const __m128 c = _mm_add_ps(_mm_loadu_ps(yy + i), lambda);
+			const __m128 ex = _mm_loadu_ps(errorX + i);
+			const __m128 ey = _mm_loadu_ps(errorY + i);
+			const __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sub_ps(_mm_mul_ps(a, c), _mm_mul_ps(b, b)));
+			const __m128 u = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(c, ex), _mm_mul_ps(b, ey)), inverse);
+			const __m128 v = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(a, ey), _mm_mul_ps(b, ex)), inverse);
+			_mm_storeu_ps(flowX + i, _mm_add_ps(_mm_loadu_ps(flowX + i), u));
+			_mm_storeu_ps(flowY + i, _mm_add_ps(_mm_loadu_ps(flowY + i), v));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			const float a = xx[i] + regularization;
+			const float b = xy[i];
+			const float c = yy[i] + regularization;
+			const float inverse = 1.0f / (a * c - b * b);
+			flowX[i] += (c * errorX[i] - b * errorY[i]) * inverse;
+			flowY[i] += (a * errorY[i] - b * errorX[i]) * inverse;
+		}
+	}
+
+	float sample(const float* image, int width, int height, float x, float y)
+	{
+		x = std::min(std::max(x, 0.0f), static_cast<float>(width - 1));
+		y = std::min(std::max(y, 0.0f), static_cast<float>(height - 1));
+		const int left = static_cast<int>(x);
+		const int top = static_cast<int>(y);
+		const int right = std::min(left + 1, width - 1);
+		const int bottom = std::min(top + 1, height - 1);
+		const float xLerp = x - left;
+		const float yLerp = y - top;
+
+		const float* topRow = image + static_cast<size_t>(top) * width;
+		const float* bottomRow = image + static_cast<size_t>(bottom) * width;
+		const float upper = topRow[left] + (topRow[right] - topRow[left]) * xLerp;
+		const float lower = bottomRow[left] + (bottomRow[right] - bottomRow[left]) * xLerp;
+		return upper + (lower - upper) * yLerp;
+	}
+
+	void halve(const std::vector<float>& image, int width, int height, std::vector<float>* half, int halfWidth, int halfHeight)
+	{
+		half->resize(static_cast<size_t>(halfWidth) * halfHeight);
+		for (int y = 0; y < halfHeight; ++y)
+		{
+			const float* top = image.data() + static_cast<size_t>(2 * y) * width;
+			const float* bottom = image.data() + static_cast<size_t>(std::min(2 * y + 1, height - 1)) * width;
+			float* out = half->data() + static_cast<size_t>(y) * halfWidth;
+			for (int x = 0; x < halfWidth; ++x)
+			{
+				const int right = std::min(2 * x + 1, width - 1);
+				out[x] = (top[2 * x] + top[right] + bottom[2 * x] + bottom[right]) * 0.25f;
+			}
+		}
+	}
+}
+
+void DenseFlow::estimate(const GrayImage& from, const GrayImage& to, int levels)
+{
+	pyramid.resize(std::max(levels, 1));
+	Level& base = pyramid[0];
+	base.width = from.width;
+	base.height = from.height;
+	base.from.assign(from.pixels.begin(), from.pixels.end());
+	base.to.assign(to.pixels.begin(), to.pixels.end());
+
+	// Levels stop before they get smaller than the window.
+	for (size_t i = 1; i < pyramid.size(); ++i)
+	{
+		const Level& finer = pyramid[i - 1];
+		if (finer.width < 4 * windowRadius || finer.height < 4 * windowRadius)
+		{
+			pyramid.resize(i);
+			break;
+		}
+
+		Level& level = pyramid[i];
+		level.width = finer.width / 2;
+		level.height = finer.height / 2;
+		halve(finer.from, finer.width, finer.height, &level.from, level.width, level.height);
+		halve(finer.to, finer.width, finer.height, &level.to, level.width, level.height);
+	}
+
+	// Coarse to fine: every level starts from twice the flow of the level above it.
+	const Level& coarsest = pyramid.back();
+	flowX.assign(static_cast<size_t>(coarsest.width) * coarsest.height, 0.0f);
+	flowY.assign(flowX.size(), 0.0f);
+	for (size_t i = pyramid.size(); i-- > 0;)
+	{
+		const Level& level = pyramid[i];
+		if (i + 1 < pyramid.size())
+		{
+			const Level& coarser = pyramid[i + 1];
+			errorX.resize(static_cast<size_t>(level.width) * level.height);
+			errorY.resize(errorX.size());
+			for (int y = 0; y < level.height; ++y)
+			{
+				const size_t coarseRow = static_cast<size_t>(std::min(y / 2, coarser.height - 1)) * coarser.width;
+				for (int x = 0; x < level.width; ++x)
+				{
+					const size_t coarse = coarseRow + std::min(x / 2, coarser.width - 1);
+					errorX[static_cast<size_t>(y) * level.width + x] = flowX[coarse] * 2.0f;
+					errorY[static_cast<size_t>(y) * level.width + x] = flowY[coarse] * 2.0f;
+				}
+			}
+			flowX.swap(errorX);
+			flowY.swap(errorY);
+		}
+		refine(level);
+	}
+
+	flowWidth = base.width;
+	flowHeight = base.height;
+}
+
+void DenseFlow::refine(const Level& level)
+{
+	const int width = level.width;
+	const int height = level.height;
+	const size_t count = static_cast<size_t>(width) * height;
+	gradientX.resize(count);
+	gradientY.resize(count);
+	xx.resize(count);
+	xy.resize(count);
+	yy.resize(count);
+	errorX.resize(count);
+	errorY.resize(count);
+
+	// The gradients (and so the structure tensor) belong to `from`, which doesn't move.
+	gradients(level.from.data(), width, height, gradientX.data(), gradientY.data());
+	multiply(gradientX.data(), gradientX.data(), xx.data(), count);
+	multiply(gradientX.data(), gradientY.data(), xy.data(), count);
+	multiply(gradientY.data(), gradientY.data(), yy.data(), count);
+	boxFilter(xx.data(), width, height, windowRadius, &rowSums);
+	boxFilter(xy.data(), width, height, windowRadius, &rowSums);
+	boxFilter(yy.data(), width, height, windowRadius, &rowSums);
+
+	// Keeps flat areas (where the system is close to singular) from picking up noise.
+	const int window = 2 * windowRadius + 1;
+	const float regularization = static_cast<float>(window * window);
+
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		// The difference between `from` and `to` warped by the current flow.
+		for (int y = 0; y < height; ++y)
+		{
+			const size_t row = static_cast<size_t>(y) * width;
+			for (int x = 0; x < width; ++x)
+			{
+				const size_t i = row + x;
+				const float difference = level.from[i] - sample(level.to.data(), width, height, x + flowX[i], y + flowY[i]);
+				errorX[i] = difference;
+				errorY[i] = difference;
+			}
+		}
+		multiply(errorX.data(), gradientX.data(), errorX.data(), count);
+		multiply(errorY.data(), gradientY.data(), errorY.data(), count);
+		boxFilter(errorX.data(), width, height, windowRadius, &rowSums);
+		boxFilter(errorY.data(), width, height, windowRadius, &rowSums);
+
+		solve(xx.data(), xy.data(), yy.data(), errorX.data(), errorY.data(), regularization, count, flowX.data(), flowY.data());
+	}
+}
+
+void warpTensor(const tensorflow::Tensor& source, const DenseFlow& flow, tensorflow::Tensor* out)
+{
+	const int height = static_cast<int>(source.dim_size(1));
+	const int width = static_cast<int>(source.dim_size(2));
+	const int channels = static_cast<int>(source.dim_size(3));
+	const float* in = source.flat<float>().data();
+	float* result = out->flat<float>().data();
+
+	const float scaleX = static_cast<float>(width) / flow.width();
+	const float scaleY = static_cast<float>(height) / flow.height();
+	for (int y = 0; y < height; ++y)
+	{
+		const int flowRow = std::min(static_cast<int>((y + 0.5f) / scaleY), flow.height() - 1);
+		for (int x = 0; x < width; ++x)
+		{
+			const size_t i = static_cast<size_t>(flowRow) * flow.width() + std::min(static_cast<int>((x + 0.5f) / scaleX), flow.width() - 1);
+			const float sourceX = std::min(std::max(x + flow.dx()[i] * scaleX, 0.0f), static_cast<float>(width - 1));
+			const float sourceY = std::min(std::max(y + flow.dy()[i] * scaleY, 0.0f), static_cast<float>(height - 1));
+
+			const int left = static_cast<int>(sourceX);
+			const int top = static_cast<int>(sourceY);
+			const int right = std::min(left + 1, width - 1);
+			const int bottom = std::min(top + 1, height - 1);
+			const float xLerp = sourceX - left;
+			const float yLerp = sourceY - top;
+
+			const float* topLeft = in + (static_cast<size_t>(top) * width + left) * channels;
+			const float* topRight = in + (static_cast<size_t>(top) * width + right) * channels;
+			const float* bottomLeft = in + (static_cast<size_t>(bottom) * width + left) * channels;
+			const float* bottomRight = in + (static_cast<size_t>(bottom) * width + right) * channels;
+			float* pixel = result + (static_cast<size_t>(y) * width + x) * channels;
+			for (int c = 0; c < channels; ++c)
+			{
+				const float upper = topLeft[c] + (topRight[c] - topLeft[c]) * xLerp;
+				const float lower = bottomLeft[c] + (bottomRight[c] - bottomLeft[c]) * xLerp;
+				pixel[c] = upper + (lower - upper) * yLerp;
+			}
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+
+#include "GrayImage.h"
+
+#include "tensorflow/core/framework/tensor.h"
+
+// Dense optical flow by pyramidal Lucas-Kanade, for carrying a dense output (a segmentation or a
+// heatmap) from the frame it was computed on to later frames. Every pixel gets the offset that best
+// explains the change within a small window around it. Offsets are found on a coarse copy of the
+// images first and refined on finer ones, so motion of several pixels is still found.
+//
+// All passes work on whole rows of float buffers, which are vectorized (SSE2) except for the
+// bilinear lookups of the warp. The buffers are kept between calls, so estimating the flow doesn't
+// allocate once the size is settled.
+class DenseFlow
+{
+public:
+	// Estimates, for every pixel of `from`, the offset at which its content appears in `to`. Both
+	// images must have the same size. `levels` includes the full-size level.
+	void estimate(const GrayImage& from, const GrayImage& to, int levels);
+
+	int width() const
+	{
+		return flowWidth;
+	}
+
+	int height() const
+	{
+		return flowHeight;
+	}
+
+	// Offsets in pixels of the images, row-major and top-down.
+	const std::vector<float>& dx() const
+	{
+		return flowX;
+	}
+
+	const std::vector<float>& dy() const
+	{
+		return flowY;
+	}
+
+private:
+	// Half the size of the window that every offset is fitted over.
+	static const int windowRadius = 4;
+	static const int iterations = 2;
+
+	struct Level
+	{
+		int width;
+		int height;
+		std::vector<float> from;
+		std::vector<float> to;
+	};
+
+	void refine(const Level& level);
+
+	std::vector<Level> pyramid;
+	std::vector<float> flowX;
+	std::vector<float> flowY;
+	int flowWidth = 0;
+	int flowHeight = 0;
+
+	// Scratch buffers, the size of the current level.
+	std::vector<float> gradientX;
+	std::vector<float> gradientY;
+	std::vector<float> xx;
+	std::vector<float> xy;
+	std::vector<float> yy;
+	std::vector<float> errorX;
+	std::vector<float> errorY;
+	std::vector<float> rowSums;
+};
+
+// Moves the content of a `[1, height, width, channels]` float tensor along the flow, which is
+// resampled to the tensor's size: every element of `out` is read (bilinearly) from where its content
+// was in `source`. The tensor is assumed to cover the same area as the images that the flow was
+// estimated on.
+void warpTensor(const tensorflow::Tensor& source, const DenseFlow& flow, tensorflow::Tensor* out);
@@ -0,0 +1,556 @@
+#include "Detections.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <utility>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DETECTIONS_SSE2
+#endif
+
+namespace
+{
+	const float negativeInfinity = -std::numeric_limits<float>::infinity();
+
+	float sigmoid(float x)
+	{
+		return 1.0f / (1.0f + std::exp(-x));
+	}
+
+	// The logit that a sigmoid maps to `probability`, so that scores can be thresholded before their
+	// sigmoids are taken.
+	float logit(float probability)
+	{
+		if (probability <= 0.0f)
+		{
+			return negativeInfinity;
+		}
+		if (probability >= 1.0f)
+		{
+			return std::numeric_limits<float>::infinity();
+		}
+		return std::log(probability / (1.0f - probability));
+	}
+
+	// The highest value of every row of `columns` values, from column `first` on.
+	void bestOfRows(const float* values, size_t rows, size_t columns, size_t first, std::vector<float>* best)
+	{
+		const size_t width = columns - first;
+		best->resize(rows);
+		for (size_t row = 0; row < rows; ++row)
+		{
+			const float* rowValues = values + row * columns + first;
+			float highest = negativeInfinity;
+			size_t column = 0;
+#ifdef DETECTIONS_SSE2
+			if (width >= 4)
+			{
+				__m128 highestLanes = _mm_loadu_ps(rowValues);
+				for (column = 4; column + 4 <= width; column += 4)
+				{
+					highestLanes = _mm_max_ps(highestLanes, _mm_loadu_ps(rowValues + column));
+				}
+				float lanes[4];
+				_mm_storeu_ps(lanes, highestLanes);
+				highest = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+			}
+#endif
+			for (; column < width; ++column)
+			{
+				highest = std::max(highest, rowValues[column]);
+			}
+			(*best)[row] = highest;
+		}
+	}
+
+	// The indices of the values that are at least `threshold`. Most values of a detector's output
+	// don't pass, so whole vectors are skipped with a single comparison.
+	void selectAtLeast(const float* values, size_t count, float threshold, std::vector<int>* indices)
+	{
+		indices->clear();
+		size_t i = 0;
+#ifdef DETECTIONS_SSE2
+		const __m128 limit = _mm_set1_ps(threshold);
+		for (; i + 4 <= count; i += 4)
+		{
+			int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(values + i), limit));
+			for (int lane = 0; mask != 0; ++lane, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					indices->push_back(static_cast<int>(i) + lane);
+				}
+			}
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			if (values[i] >= threshold)
+			{
+				indices->push_back(static_cast<int>(i));
+			}
+		}
+	}
+
+	// The column of the highest value of a row, from column `first` on.
+	int bestColumn(const float* row, size_t columns, size_t first)
+	{
+		return static_cast<int>(std::max_element(row + first, row + columns) - row);
+	}
+
+	float classAt(const tensorflow::Tensor& classes, tensorflow::int64 i)
+	{
+		switch (classes.dtype())
+		{
+		case tensorflow::DT_INT32:
+			return static_cast<float>(classes.flat<tensorflow::int32>()(i));
+		case tensorflow::DT_INT64:
+			return static_cast<float>(classes.flat<tensorflow::int64>()(i));
+		default:
+			return classes.flat<float>()(i);
+		}
+	}
+
+	// Candidates in the order they are suppressed in, with their areas, padded with empty boxes to
+	// whole vectors. Empty boxes never overlap anything, and their scores never win.
+	struct OrderedCandidates
+	{
+		size_t count;
+		std::vector<float> top;
+		std::vector<float> left;
+		std::vector<float> bottom;
+		std::vector<float> right;
+		std::vector<float> area;
+		std::vector<float> scores;
+		std::vector<int> index;
+	};
+
+	void orderCandidates(const BoxCandidates& candidates, const std::vector<int>& order, OrderedCandidates* ordered)
+	{
+		const size_t count = order.size();
+		const size_t padded = (count + 3) / 4 * 4;
+		ordered->count = count;
+		ordered->top.assign(padded, 0.0f);
+		ordered->left.assign(padded, 0.0f);
+		ordered->bottom.assign(padded, 0.0f);
+		ordered->right.assign(padded, 0.0f);
+		ordered->area.assign(padded, 0.0f);
+		ordered->scores.assign(padded, negativeInfinity);
+		ordered->index.assign(padded, 0);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const int source = order[i];
+			ordered->top[i] = candidates.top[source];
+			ordered->left[i] = candidates.left[source];
+			ordered->bottom[i] = candidates.bottom[source];
+			ordered->right[i] = candidates.right[source];
+			ordered->area[i] = (ordered->bottom[i] - ordered->top[i]) * (ordered->right[i] - ordered->left[i]);
+			ordered->scores[i] = candidates.scores[source];
+			ordered->index[i] = source;
+		}
+	}
+
+	float intersection(const OrderedCandidates& boxes, size_t a, size_t b)
+	{
+		const float width = std::min(boxes.right[a], boxes.right[b]) - std::max(boxes.left[a], boxes.left[b]);
+		const float height = std::min(boxes.bottom[a], boxes.bottom[b]) - std::max(boxes.top[a], boxes.top[b]);
+		return std::max(width, 0.0f) * std::max(height, 0.0f);
+	}
+
+#ifdef DETECTIONS_SSE2
+	// One box, broadcast to every lane.
+	struct BroadcastBox
+	{
+		explicit BroadcastBox(const OrderedCandidates& boxes, size_t i) :
+			top(_mm_set1_ps(boxes.top[i])),
+			left(_mm_set1_ps(boxes.left[i])),
+			bottom(_mm_set1_ps(boxes.bottom[i])),
+			right(_mm_set1_ps(boxes.right[i])),
+			area(_mm_set1_ps(boxes.area[i]))
+		{
+		}
+
+		__m128 top;
+		__m128 left;
+		__m128 bottom;
+		__m128 right;
+		__m128 area;
+	};
+
+	// The intersections of a box with the four boxes from `j` on.
+	__m128 intersections(const BroadcastBox& box, const OrderedCandidates& boxes, size_t j)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 width = _mm_sub_ps(_mm_min_ps(box.right, _mm_loadu_ps(&boxes.right[j])), _mm_max_ps(box.left, _mm_loadu_ps(&boxes.left[j])));
+		const __m128 height = _mm_sub_ps(_mm_min_ps(box.bottom, _mm_loadu_ps(&boxes.bottom[j])), _mm_max_ps(box.top, _mm_loadu_ps(&boxes.top[j])));
+		return _mm_mul_ps(_mm_max_ps(width, zero), _mm_max_ps(height, zero));
+	}
+#endif
+
+	Detection toDetection(const BoxCandidates& candidates, int i, float score)
+	{
+		// Flipped to TouchDesigner's origin at the bottom.
+		Detection detection;
+		detection.box.x = candidates.left[i];
+		detection.box.y = 1.0f - candidates.bottom[i];
+		detection.box.width = candidates.right[i] - candidates.left[i];
+		detection.box.height = candidates.bottom[i] - candidates.top[i];
+		detection.score = score;
+		detection.classIndex = candidates.classes[i];
+		return detection;
+	}
+
+	void suppressGreedy(const BoxCandidates& candidates, float iouThreshold, size_t maxCount, std::vector<Detection>* detections)
+	{
+		// Best first, and in their original order among equal scores.
+		std::vector<int> order(candidates.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&candidates](int a, int b)
+		{
+			return candidates.scores[a] > candidates.scores[b];
+		});
+
+		OrderedCandidates boxes;
+		orderCandidates(candidates, order, &boxes);
+		const size_t padded = boxes.scores.size();
+
+		// IoU > t is tested as intersection * (1 + t) > t * (area + other area), without a division.
+		std::vector<float> alive(padded, 1.0f);
+		for (size_t i = 0; i < boxes.count && detections->size() < maxCount; ++i)
+		{
+			if (alive[i] == 0.0f)
+			{
+				continue;
+			}
+			detections->push_back(toDetection(candidates, boxes.index[i], boxes.scores[i]));
+
+			// Boxes before `i` are already decided, so suppressing them (or `i` itself) changes nothing.
+			size_t j = (i + 1) / 4 * 4;
+#ifdef DETECTIONS_SSE2
+			const BroadcastBox box(boxes, i);
+			const __m128 factor = _mm_set1_ps(1.0f + iouThreshold);
+			const __m128 threshold = _mm_set1_ps(iouThreshold);
+			for (; j < padded; j += 4)
+			{
+				const __m128 areas = _mm_add_ps(box.area, _mm_loadu_ps(&boxes.area[j]));
+				const __m128 overlaps = _mm_cmpgt_ps(_mm_mul_ps(intersections(box, boxes, j), factor), _mm_mul_ps(threshold, areas));
+				_mm_storeu_ps(&alive[j], _mm_andnot_ps(overlaps, _mm_loadu_ps(&alive[j])));
+			}
+#endif
+			for (; j < padded; ++j)
+			{
+				if (intersection(boxes, i, j) * (1.0f + iouThreshold) > iouThreshold * (boxes.area[i] + boxes.area[j]))
+				{
+					alive[j] = 0.0f;
+				}
+			}
+		}
+	}
+
+	void suppressLinear(const BoxCandidates& candidates, float iouThreshold, float scoreThreshold, size_t maxCount, std::vector<Detection>* detections)
+	{
+		// Scores change as boxes are kept, so there is no order to sort by. Instead, the pass that scores
+		// the boxes down also finds the best of them for the next round.
+		std::vector<int> order(candidates.size());
+		std::iota(order.begin(), order.end(), 0);
+
+		OrderedCandidates boxes;
+		orderCandidates(candidates, order, &boxes);
+		std::vector<float>& scores = boxes.scores;
+		const size_t padded = scores.size();
+		if (padded == 0)
+		{
+			return;
+		}
+
+		size_t best = static_cast<size_t>(std::max_element(scores.begin(), scores.end()) - scores.begin());
+		while (detections->size() < maxCount && scores[best] >= scoreThreshold)
+		{
+			detections->push_back(toDetection(candidates, boxes.index[best], scores[best]));
+
+			// Kept boxes are taken out at -infinity (NaN once scaled by zero), which never compares greater.
+			const size_t kept = best;
+			scores[kept] = negativeInfinity;
+			float bestScore = negativeInfinity;
+			best = 0;
+			size_t j = 0;
+#ifdef DETECTIONS_SSE2
+			const BroadcastBox box(boxes, kept);
+			const __m128 threshold = _mm_set1_ps(iouThreshold);
+			const __m128 one = _mm_set1_ps(1.0f);
+			__m128 bestLanes = _mm_set1_ps(negativeInfinity);
+			__m128i bestIndices = _mm_setzero_si128();
+			__m128i indices = _mm_setr_epi32(0, 1, 2, 3);
+			const __m128i step = _mm_set1_epi32(4);
+			for (; j < padded; j += 4)
+			{
+				const __m128 shared = intersections(box, boxes, j);
+				const __m128 iou = _mm_div_ps(shared, _mm_sub_ps(_mm_add_ps(box.area, _mm_loadu_ps(&boxes.area[j])), shared));
+				const __m128 overlaps = _mm_cmpgt_ps(iou, threshold);
+				const __m128 factor = _mm_or_ps(_mm_and_ps(overlaps, _mm_sub_ps(one, iou)), _mm_andnot_ps(overlaps, one));
+				const __m128 scaled = _mm_mul_ps(_mm_loadu_ps(&scores[j]), factor);
+				_mm_storeu_ps(&scores[j], scaled);
+
+				// Blended rather than taking the maximum, which would let a NaN through.
+				const __m128 better = _mm_cmpgt_ps(scaled, bestLanes);
+				bestLanes = _mm_or_ps(_mm_and_ps(better, scaled), _mm_andnot_ps(better, bestLanes));
+				bestIndices = _mm_or_si128(_mm_and_si128(_mm_castps_si128(better), indices), _mm_andnot_si128(_mm_castps_si128(better), bestIndices));
+				indices = _mm_add_epi32(indices, step);
+			}
+
+			float laneScores[4];
+			int32_t laneIndices[4];
+			_mm_storeu_ps(laneScores, bestLanes);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(laneIndices), bestIndices);
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				if (laneScores[lane] > bestScore || (laneScores[lane] == bestScore && static_cast<size_t>(laneIndices[lane]) < best))
+				{
+					bestScore = laneScores[lane];
+					best = static_cast<size_t>(laneIndices[lane]);
+				}
+			}
+#endif
+			for (; j < padded; ++j)
+			{
+				const float shared = intersection(boxes, kept, j);
+				const float iou = shared / (boxes.area[kept] + boxes.area[j] - shared);
+				if (iou > iouThreshold)
+				{
+					scores[j] *= 1.0f - iou;
+				}
+				if (scores[j] > bestScore)
+				{
+					bestScore = scores[j];
+					best = j;
+				}
+			}
+		}
+	}
+}
+
+std::vector<float> readNumbers(const std::string& text)
+{
+	std::string spaced = text;
+	std::replace(spaced.begin(), spaced.end(), ',', ' ');
+
+	std::vector<float> numbers;
+	std::istringstream stream(spaced);
+	float number;
+	while (stream >> number)
+	{
+		numbers.push_back(number);
+	}
+	return numbers;
+}
+
+void ssdAnchors(const std::vector<float>& gridSizes, float minScale, float maxScale, Anchors* anchors)
+{
+	*anchors = Anchors();
+	const size_t layers = gridSizes.size();
+	const float aspectRatios[] = { 1.0f, 2.0f, 0.5f, 3.0f, 0.3333f };
+
+	for (size_t layer = 0; layer < layers; ++layer)
+	{
+		const float scale = layers > 1 ? minScale + (maxScale - minScale) * layer / (layers - 1) : minScale;
+		const float nextScale = layer + 1 < layers ? minScale + (maxScale - minScale) * (layer + 1) / (layers - 1) : 1.0f;
+
+		// (scale, aspect ratio) of every anchor of a cell. The lowest layer has fewer, smaller anchors.
+		std::vector<std::pair<float, float>> shapes;
+		if (layer == 0)
+		{
+			shapes = { { 0.1f, 1.0f }, { scale, 2.0f }, { scale, 0.5f } };
+		}
+		else
+		{
+			for (float ratio : aspectRatios)
+			{
+				shapes.push_back({ scale, ratio });
+			}
+			shapes.push_back({ std::sqrt(scale * nextScale), 1.0f });
+		}
+
+		const int cells = std::max(1, static_cast<int>(gridSizes[layer]));
+		const float stride = 1.0f / cells;
+		for (int y = 0; y < cells; ++y)
+		{
+			for (int x = 0; x < cells; ++x)
+			{
+				for (const auto& shape : shapes)
+				{
+					const float ratio = std::sqrt(shape.second);
+					anchors->y.push_back((y + 0.5f) * stride);
+					anchors->x.push_back((x + 0.5f) * stride);
+					anchors->height.push_back(shape.first / ratio);
+					anchors->width.push_back(shape.first * ratio);
+				}
+			}
+		}
+	}
+}
+
+tensorflow::Status readDetections(const tensorflow::Tensor& boxes,
+								  const tensorflow::Tensor& scores,
+								  const tensorflow::Tensor* classes,
+								  float threshold,
+								  BoxCandidates* candidates)
+{
+	candidates->clear();
+	if (boxes.dtype() != tensorflow::DT_FLOAT || boxes.NumElements() % 4 != 0)
+	{
+		return tensorflow::errors::InvalidArgument("Detection boxes have to be [1, count, 4] floats.");
+	}
+
+	const tensorflow::int64 count = boxes.NumElements() / 4;
+	if (scores.dtype() != tensorflow::DT_FLOAT || count == 0 || scores.NumElements() % count != 0)
+	{
+		return tensorflow::errors::InvalidArgument("Detection scores have to be [1, count] or [1, count, classes] floats.");
+	}
+	if (classes != nullptr && classes->NumElements() != count)
+	{
+		return tensorflow::errors::InvalidArgument("Detection classes have to be [1, count].");
+	}
+
+	const size_t classCount = static_cast<size_t>(scores.NumElements() / count);
+	const float* boxData = boxes.flat<float>().data();
+	const float* scoreData = scores.flat<float>().data();
+
+	std::vector<float> best;
+	if (classCount > 1)
+	{
+		bestOfRows(scoreData, static_cast<size_t>(count), classCount, 0, &best);
+	}
+	std::vector<int> selected;
+	selectAtLeast(classCount > 1 ? best.data() : scoreData, static_cast<size_t>(count), threshold, &selected);
+
+	for (int i : selected)
+	{
+		const float* corners = boxData + i * 4;
+		const float* row = scoreData + i * classCount;
+		const int column = bestColumn(row, classCount, 0);
+		const int classIndex = classes != nullptr ? static_cast<int>(classAt(*classes, i)) : column;
+		candidates->add(corners[0], corners[1], corners[2], corners[3], row[column], classIndex);
+	}
+	return tensorflow::Status::OK();
+}
+
+tensorflow::Status decodeSsd(const tensorflow::Tensor& encodings,
+							 const tensorflow::Tensor& logits,
+							 const Anchors& anchors,
+							 float threshold,
+							 BoxCandidates* candidates)
+{
+	candidates->clear();
+	const size_t count = anchors.size();
+	if (encodings.dtype() != tensorflow::DT_FLOAT || static_cast<size_t>(encodings.NumElements()) != count * 4)
+	{
+		return tensorflow::errors::InvalidArgument("SSD box encodings have to be [1, ", count, ", 4] floats, to match the anchors.");
+	}
+	if (logits.dtype() != tensorflow::DT_FLOAT || count == 0 || logits.NumElements() % count != 0 || static_cast<size_t>(logits.NumElements()) / count < 2)
+	{
+		return tensorflow::errors::InvalidArgument("SSD class predictions have to be [1, ", count, ", classes] floats, with the background first.");
+	}
+
+	// Sigmoids keep the order of the logits, so the threshold is applied to the logits instead, and
+	// only the boxes that pass are decoded.
+	const size_t classCount = static_cast<size_t>(logits.NumElements()) / count;
+	const float* logitData = logits.flat<float>().data();
+	std::vector<float> best;
+	bestOfRows(logitData, count, classCount, 1, &best);
+	std::vector<int> selected;
+	selectAtLeast(best.data(), count, logit(threshold), &selected);
+
+	const float* codes = encodings.flat<float>().data();
+	for (int i : selected)
+	{
+		const float* code = codes + i * 4;
+		const float centerY = code[0] / 10.0f * anchors.height[i] + anchors.y[i];
+		const float centerX = code[1] / 10.0f * anchors.width[i] + anchors.x[i];
+		const float height = std::exp(code[2] / 5.0f) * anchors.height[i];
+		const float width = std::exp(code[3] / 5.0f) * anchors.width[i];
+		const int classIndex = bestColumn(logitData + i * classCount, classCount, 1);
+		candidates->add(centerY - height * 0.5f, centerX - width * 0.5f, centerY + height * 0.5f, centerX + width * 0.5f, sigmoid(best[i]), classIndex);
+	}
+	return tensorflow::Status::OK();
+}
+
+tensorflow::Status decodeYolo(const tensorflow::Tensor& output,
+							  const std::vector<float>& anchorSizes,
+							  float threshold,
+							  BoxCandidates* candidates)
+{
+	candidates->clear();
+	const int anchorCount = static_cast<int>(anchorSizes.size() / 2);
+	if (output.dtype() != tensorflow::DT_FLOAT || output.dims() != 4 || anchorCount == 0 ||
+		output.dim_size(3) % anchorCount != 0 || output.dim_size(3) / anchorCount < 6)
+	{
+		return tensorflow::errors::InvalidArgument("YOLO output has to be [1, rows, columns, anchors * (5 + classes)] floats.");
+	}
+
+	const int rows = static_cast<int>(output.dim_size(1));
+	const int columns = static_cast<int>(output.dim_size(2));
+	const int stride = static_cast<int>(output.dim_size(3) / anchorCount);
+	const int classCount = stride - 5;
+
+	// A box can't score more than its objectness, which rules most of them out before any class
+	// probabilities are computed.
+	const float objectnessThreshold = logit(threshold);
+	const float* data = output.flat<float>().data();
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int column = 0; column < columns; ++column)
+		{
+			for (int anchor = 0; anchor < anchorCount; ++anchor)
+			{
+				const float* values = data + ((static_cast<size_t>(row) * columns + column) * anchorCount + anchor) * stride;
+				if (values[4] < objectnessThreshold)
+				{
+					continue;
+				}
+
+				const float* classLogits = values + 5;
+				const int classIndex = bestColumn(classLogits, classCount, 0);
+				float sum = 0.0f;
+				for (int c = 0; c < classCount; ++c)
+				{
+					sum += std::exp(classLogits[c] - classLogits[classIndex]);
+				}
+				const float score = sigmoid(values[4]) / sum;
+				if (score < threshold)
+				{
+					continue;
+				}
+
+				const float centerY = (row + sigmoid(values[1])) / rows;
+				const float centerX = (column + sigmoid(values[0])) / columns;
+				const float height = std::exp(values[3]) * anchorSizes[anchor * 2 + 1] / rows;
+				const float width = std::exp(values[2]) * anchorSizes[anchor * 2] / columns;
+				candidates->add(centerY - height * 0.5f, centerX - width * 0.5f, centerY + height * 0.5f, centerX + width * 0.5f, score, classIndex);
+			}
+		}
+	}
+	return tensorflow::Status::OK();
+}
+
+void suppressOverlaps(const BoxCandidates& candidates,
+					  Suppression method,
+					  float iouThreshold,
+					  float scoreThreshold,
+					  size_t maxCount,
+					  std::vector<Detection>* detections)
+{
+	detections->clear();
+	if (method == Suppression::Linear)
+	{
+		suppressLinear(candidates, iouThreshold, scoreThreshold, maxCount, detections);
+	}
+	else
+	{
+		suppressGreedy(candidates, iouThreshold, maxCount, detections);
+	}
+}
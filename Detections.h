@@ -0,0 +1,145 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Boxes.h"
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+
+// A box found by a detection model, with its score and class.
+struct Detection
+{
+	Box box;
+	float score;
+	int classIndex;
+};
+
+// Boxes that passed the score threshold, before suppression. They are stored as flat arrays (a
+// structure of arrays) so that overlaps are tested four boxes at a time. Corners are normalized with
+// the origin at the top, as detection models output them.
+struct BoxCandidates
+{
+	std::vector<float> top;
+	std::vector<float> left;
+	std::vector<float> bottom;
+	std::vector<float> right;
+	std::vector<float> scores;
+	std::vector<int> classes;
+
+	size_t size() const
+	{
+		return scores.size();
+	}
+
+	void clear()
+	{
+		top.clear();
+		left.clear();
+		bottom.clear();
+		right.clear();
+		scores.clear();
+		classes.clear();
+	}
+
+	// Boxes without an area are dropped.
+	void add(float boxTop, float boxLeft, float boxBottom, float boxRight, float score, int classIndex)
+	{
+		if (boxBottom <= boxTop || boxRight <= boxLeft)
+		{
+			return;
+		}
+		top.push_back(boxTop);
+		left.push_back(boxLeft);
+		bottom.push_back(boxBottom);
+		right.push_back(boxRight);
+		scores.push_back(score);
+		classes.push_back(classIndex);
+	}
+};
+
+// The anchor boxes of an SSD model, by center and size (normalized), as flat arrays.
+struct Anchors
+{
+	std::vector<float> y;
+	std::vector<float> x;
+	std::vector<float> height;
+	std::vector<float> width;
+
+	size_t size() const
+	{
+		return y.size();
+	}
+};
+
+// How a detection model outputs its boxes.
+enum class BoxEncoding
+{
+	// Already decoded, in the layout of TensorFlow's object detection models.
+	Decoded,
+	// As offsets from SSD anchors, with a score per class.
+	Ssd,
+	// As a YOLO (v2) region layer.
+	Yolo
+};
+
+// How overlapping boxes are suppressed.
+enum class Suppression
+{
+	// Every box that overlaps a better one by more than the threshold is dropped.
+	Greedy,
+	// Soft-NMS: the scores of overlapping boxes are scaled by (1 - IoU) instead, so that close
+	// objects survive when they score well on their own.
+	Linear
+};
+
+// Reads a list of numbers separated by spaces or commas (e.g. "19 10 5 3 2 1").
+std::vector<float> readNumbers(const std::string& text);
+
+// The anchors of TensorFlow's SSD models (its multiple grid anchor generator, with the settings of
+// the SSD MobileNet configurations): one square grid per feature map, `gridSizes` cells across, with
+// scales spread evenly from `minScale` to `maxScale`. The first grid has 3 anchors per cell, the
+// others 6.
+void ssdAnchors(const std::vector<float>& gridSizes, float minScale, float maxScale, Anchors* anchors);
+
+// Reads boxes that the model already decoded, in the layout of TensorFlow's object detection models.
+// `boxes` is `[1, count, 4]`, each (ymin, xmin, ymax, xmax). `scores` is either `[1, count]`, with
+// the classes in `classes` (if given), or `[1, count, classes]`, of which each box's best class is
+// taken.
+tensorflow::Status readDetections(const tensorflow::Tensor& boxes,
+								  const tensorflow::Tensor& scores,
+								  const tensorflow::Tensor* classes,
+								  float threshold,
+								  BoxCandidates* candidates);
+
+// Decodes the raw outputs of an SSD model. `encodings` is `[1, anchors, 4]`, as offsets from the
+// anchors (ty, tx, th, tw, scaled by 10, 10, 5 and 5 as in TensorFlow's box coder). `logits` is
+// `[1, anchors, classes]`, with the background as class 0, and scores are their sigmoids. Only the
+// boxes that pass the threshold are decoded.
+tensorflow::Status decodeSsd(const tensorflow::Tensor& encodings,
+							 const tensorflow::Tensor& logits,
+							 const Anchors& anchors,
+							 float threshold,
+							 BoxCandidates* candidates);
+
+// Decodes the output of a YOLO (v2) region layer, `[1, rows, columns, anchors * (5 + classes)]`.
+// `anchorSizes` are the anchors' widths and heights in grid cells, in pairs. Scores are the
+// objectness times the (softmax) probability of the best class.
+tensorflow::Status decodeYolo(const tensorflow::Tensor& output,
+							  const std::vector<float>& anchorSizes,
+							  float threshold,
+							  BoxCandidates* candidates);
+
+// Non-maximum suppression over the candidates, regardless of class: the best remaining box is kept,
+// and the boxes that overlap it by more than `iouThreshold` (intersection over union) are dropped or,
+// with soft-NMS, scored down until they fall below `scoreThreshold`. At most `maxCount` boxes are
+// kept, best first. Every kept box takes one vectorized (SSE2) pass over the candidates, so the cost
+// grows with the candidates times the kept boxes rather than with the candidates squared.
+void suppressOverlaps(const BoxCandidates& candidates,
+					  Suppression method,
+					  float iouThreshold,
+					  float scoreThreshold,
+					  size_t maxCount,
+					  std::vector<Detection>* detections);
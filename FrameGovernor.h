@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Decides how often inference should run so that the node stays within a per-frame time budget.
+// With synchronous inference, a frame that runs the model costs `base + inference`, while every
+// other frame only costs `base`, so running the model every Nth frame brings the average frame
+// time down to `base + inference / N`. The governor picks the smallest N that fits the budget.
+//
+// To avoid oscillating between two factors, N only increases after the budget has been exceeded
+// for several consecutive frames, and only decreases once the next smaller factor fits with some
+// headroom to spare.
+class FrameGovernor
+{
+public:
+	FrameGovernor() :
+		budgetMs(16.6),
+		maxDecimation(8),
+		baseMs(0.0),
+		inferenceMs(0.0),
+		factor(1),
+		overBudgetFrames(0),
+		underBudgetFrames(0),
+		frameCounter(0),
+		hasInferenceSample(false)
+	{
+	}
+
+	void configure(double budget, int maxFactor)
+	{
+		budgetMs = std::max(budget, 1.0);
+		maxDecimation = std::max(maxFactor, 1);
+		factor = std::min(factor, maxDecimation);
+	}
+
+	// Returns true if inference should run on this frame. Call once per cook.
+	bool shouldRun()
+	{
+		return (frameCounter++ % static_cast<uint64_t>(factor)) == 0;
+	}
+
+	// Records how long the cook took and, if the model ran during it, how much of that was inference.
+	void record(double cookMs, bool ranInference, double inferenceCostMs)
+	{
+		if (ranInference)
+		{
+			inferenceMs = hasInferenceSample ? smooth(inferenceMs, inferenceCostMs) : inferenceCostMs;
+			hasInferenceSample = true;
+			baseMs = smooth(baseMs, std::max(cookMs - inferenceCostMs, 0.0));
+		}
+		else
+		{
+			baseMs = smooth(baseMs, cookMs);
+		}
+
+		if (!hasInferenceSample)
+		{
+			return;
+		}
+
+		if (projectedMs(factor) > budgetMs && factor < maxDecimation)
+		{
+			underBudgetFrames = 0;
+			if (++overBudgetFrames >= hysteresisFrames)
+			{
+				overBudgetFrames = 0;
+				++factor;
+			}
+		}
+		else if (factor > 1 && projectedMs(factor - 1) < budgetMs * headroom)
+		{
+			overBudgetFrames = 0;
+			if (++underBudgetFrames >= hysteresisFrames)
+			{
+				underBudgetFrames = 0;
+				--factor;
+			}
+		}
+		else
+		{
+			overBudgetFrames = 0;
+			underBudgetFrames = 0;
+		}
+	}
+
+	// Inference runs on every `decimation()`-th frame.
+	int decimation() const
+	{
+		return factor;
+	}
+
+	double averageInferenceMs() const
+	{
+		return inferenceMs;
+	}
+
+	double averageBaseMs() const
+	{
+		return baseMs;
+	}
+
+	// The expected average frame time if inference runs every `n`-th frame.
+	double projectedMs(int n) const
+	{
+		return baseMs + inferenceMs / n;
+	}
+
+	void reset()
+	{
+		factor = 1;
+		overBudgetFrames = 0;
+		underBudgetFrames = 0;
+		hasInferenceSample = false;
+	}
+
+private:
+	static double smooth(double average, double sample)
+	{
+		return average + (sample - average) * smoothing;
+	}
+
+	static constexpr double smoothing = 0.1;
+	static constexpr double headroom = 0.8;
+	static constexpr int hysteresisFrames = 10;
+
+	double budgetMs;
+	int maxDecimation;
+	double baseMs;
+	double inferenceMs;
+	int factor;
+	int overBudgetFrames;
+	int underBudgetFrames;
+	uint64_t frameCounter;
+	bool hasInferenceSample;
+};
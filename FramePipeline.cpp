@@ -0,0 +1,262 @@
+#include "FramePipeline.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	int64_t microsecondsSince(PipelineClock::time_point start)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(PipelineClock::now() - start).count();
+	}
+}
+
+FramePipeline::FramePipeline() :
+	spareFrame(nullptr),
+	running(false),
+	queueDepth(0),
+	overwriteStale(false),
+	nextIndex(0),
+	latestIndex(0),
+	takenIndex(0),
+	readbackBusy(0),
+	preprocessBusy(0),
+	inferenceBusy(0),
+	latencyTotal(0),
+	latencyFrames(0),
+	completed(0),
+	dropped(0)
+{
+}
+
+FramePipeline::~FramePipeline()
+{
+	stop();
+}
+
+void FramePipeline::start(size_t depth, bool latestWins, Stage preprocess, Stage inference)
+{
+	stop();
+
+	preprocessStage = preprocess;
+	inferenceStage = inference;
+	queueDepth = depth;
+	overwriteStale = latestWins;
+
+	// Enough frames to fill both queues, plus the one that each stage is working on.
+	const size_t frameCount = depth * 2 + 3;
+	frames.clear();
+	preprocessQueue.reset(new SpscQueue<Frame>(depth, latestWins ? SpscQueue<Frame>::Policy::OverwriteOldest : SpscQueue<Frame>::Policy::RejectNewest));
+	inferenceQueue.reset(new SpscQueue<Frame>(depth));
+	freeFrames.reset(new SpscQueue<Frame>(frameCount));
+	spareFrame = nullptr;
+	for (size_t i = 0; i < frameCount; ++i)
+	{
+		frames.emplace_back(new Frame());
+		freeFrames->push(frames.back().get());
+	}
+
+	latestOutputs.clear();
+	latestIndex = 0;
+	takenIndex = 0;
+	dropped = 0;
+	stats();
+
+	running = true;
+	preprocessThread = std::thread(&FramePipeline::preprocessLoop, this);
+	inferenceThread = std::thread(&FramePipeline::inferenceLoop, this);
+}
+
+void FramePipeline::stop()
+{
+	if (!running)
+	{
+		return;
+	}
+	running = false;
+
+	preprocessSignal.notify();
+	inferenceSignal.notify();
+
+	preprocessThread.join();
+	inferenceThread.join();
+}
+
+bool FramePipeline::submit(const void* pixels,
+						   int width,
+						   int height,
+						   PixelFormat format,
+						   PipelineClock::time_point captureTime,
+						   PipelineClock::time_point readbackStart)
+{
+	Frame* frame = spareFrame;
+	spareFrame = nullptr;
+	if (!running || (!frame && !freeFrames->pop(&frame)))
+	{
+		spareFrame = frame;
+		++dropped;
+		return false;
+	}
+
+	// The pixels returned by `getTOPDataInCPUMemory()` are only valid during `execute()`, so they
+	// have to be copied before another thread can touch them.
+	const size_t bytes = static_cast<size_t>(width) * height * bytesPerPixel(format);
+	frame->pixels.resize(bytes);
+	std::memcpy(frame->pixels.data(), pixels, bytes);
+	frame->width = width;
+	frame->height = height;
+	frame->format = format;
+	frame->captureTime = captureTime;
+	frame->index = ++nextIndex;
+	frame->valid = true;
+
+	addBusyTime(readbackBusy, readbackStart);
+
+	// With the latest-wins policy, a full queue hands back its oldest (stale) frame, which becomes 
+	// the next one that we fill. Otherwise, this frame is the one that gets dropped.
+	Frame* evicted = nullptr;
+	if (!preprocessQueue->push(frame, &evicted))
+	{
+		spareFrame = frame;
+		++dropped;
+		return false;
+	}
+	spareFrame = evicted;
+	preprocessSignal.notify();
+
+	return true;
+}
+
+bool FramePipeline::takeLatest(std::vector<tensorflow::Tensor>* outputs, uint64_t* index)
+{
+	// Never wait for the inference thread here: if it is publishing a result right now, we'll pick
+	// it up on the next cook.
+	std::unique_lock<std::mutex> lock(resultMutex, std::try_to_lock);
+	if (!lock.owns_lock() || latestIndex == takenIndex)
+	{
+		return false;
+	}
+	*outputs = latestOutputs;
+	takenIndex = latestIndex;
+	if (index != nullptr)
+	{
+		*index = latestIndex;
+	}
+	return true;
+}
+
+PipelineStats FramePipeline::stats()
+{
+	const auto now = PipelineClock::now();
+	const double elapsed = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(now - statsStart).count());
+	statsStart = now;
+
+	PipelineStats result;
+	const uint64_t frameCount = completed.exchange(0);
+	if (elapsed > 0.0)
+	{
+		result.fps = frameCount / (elapsed * 1e-6);
+		result.readbackOccupancy = readbackBusy.exchange(0) / elapsed;
+		result.preprocessOccupancy = preprocessBusy.exchange(0) / elapsed;
+		result.inferenceOccupancy = inferenceBusy.exchange(0) / elapsed;
+	}
+
+	const int64_t latency = latencyTotal.exchange(0);
+	const uint64_t latencyCount = latencyFrames.exchange(0);
+	if (latencyCount > 0)
+	{
+		result.latencyMs = latency * 1e-3 / latencyCount;
+	}
+	result.droppedFrames = dropped;
+	result.staleFrames = preprocessQueue ? preprocessQueue->overwrittenCount() : 0;
+
+	return result;
+}
+
+void FramePipeline::preprocessLoop()
+{
+	Frame* frame = nullptr;
+	while (running)
+	{
+		if (!preprocessQueue->pop(&frame))
+		{
+			preprocessSignal.wait([this] { return !running || !preprocessQueue->empty(); });
+			continue;
+		}
+
+		const auto start = PipelineClock::now();
+		const tensorflow::Status status = preprocessStage(frame);
+		addBusyTime(preprocessBusy, start);
+
+		if (!status.ok())
+		{
+			std::cout << "Preprocessing failed: " << status.error_message() << "\n";
+			frame->valid = false;
+		}
+
+		// Only the inference thread returns frames to the cook thread (so that the free list keeps a
+		// single producer), which means that failed frames are passed along as well. Waiting for space
+		// here applies backpressure, which keeps frames flowing in order.
+		while (!inferenceQueue->push(frame))
+		{
+			if (!running)
+			{
+				return;
+			}
+			preprocessSignal.wait([this] { return !running || inferenceQueue->size() < queueDepth; });
+		}
+		inferenceSignal.notify();
+	}
+}
+
+void FramePipeline::inferenceLoop()
+{
+	Frame* frame = nullptr;
+	while (running)
+	{
+		if (!inferenceQueue->pop(&frame))
+		{
+			inferenceSignal.wait([this] { return !running || !inferenceQueue->empty(); });
+			continue;
+		}
+
+		// There is space in the inference queue again.
+		preprocessSignal.notify();
+
+		if (frame->valid)
+		{
+			const auto start = PipelineClock::now();
+			const tensorflow::Status status = inferenceStage(frame);
+			addBusyTime(inferenceBusy, start);
+
+			if (status.ok())
+			{
+				{
+					std::lock_guard<std::mutex> lock(resultMutex);
+					latestOutputs = frame->outputs;
+					latestIndex = frame->index;
+				}
+				if (frame->captureTime != PipelineClock::time_point())
+				{
+					latencyTotal += microsecondsSince(frame->captureTime);
+					++latencyFrames;
+				}
+				++completed;
+			}
+			else
+			{
+				std::cout << "Inference failed: " << status.error_message() << "\n";
+			}
+		}
+
+		// Release our references so the input tensor can be rewritten in place.
+		frame->input = tensorflow::Tensor();
+		frame->outputs.clear();
+		freeFrames->push(frame);
+	}
+}
+
+void FramePipeline::addBusyTime(std::atomic<int64_t>& counter, PipelineClock::time_point start)
+{
+	counter += microsecondsSince(start);
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PixelConversion.h"
+#include "SpscQueue.h"
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+
+using PipelineClock = std::chrono::high_resolution_clock;
+
+// A frame as it moves through the pipeline: the downloaded pixels, the input tensor that the
+// preprocessing stage fills and the outputs of the inference stage.
+struct Frame
+{
+	std::vector<uint8_t> pixels;
+	int width = 0;
+	int height = 0;
+	PixelFormat format = PixelFormat::BGRA8;
+
+	tensorflow::Tensor input;
+	std::vector<tensorflow::Tensor> outputs;
+
+	// When the readback for this frame was requested, used to measure end-to-end latency. Left at
+	// the clock's epoch when that isn't known, in which case the frame isn't counted.
+	PipelineClock::time_point captureTime;
+	uint64_t index = 0;
+
+	// Cleared if preprocessing fails, in which case the inference stage just recycles the frame.
+	bool valid = true;
+};
+
+// Wakes a worker thread that is waiting for one of its queues to change. Notifying never takes the
+// lock, so the producer (e.g. the cook thread) never waits on the worker. A wakeup that races with
+// the worker going to sleep is only delayed by the wait timeout, not lost.
+class WorkerSignal
+{
+public:
+	void notify()
+	{
+		condition.notify_one();
+	}
+
+	template <typename Predicate>
+	void wait(Predicate ready)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait_for(lock, std::chrono::milliseconds(1), ready);
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable condition;
+};
+
+// Throughput and utilization of the pipeline, measured since the previous call to `FramePipeline::stats()`.
+struct PipelineStats
+{
+	double fps = 0.0;
+
+	// The fraction of wall-clock time that each stage spent working.
+	double readbackOccupancy = 0.0;
+	double preprocessOccupancy = 0.0;
+	double inferenceOccupancy = 0.0;
+
+	// Average time from requesting a frame's readback until its inference results are available.
+	double latencyMs = 0.0;
+
+	// Frames that were dropped because the pipeline was backed up, and (with the latest-wins policy)
+	// queued frames that were replaced by a newer one before they could be preprocessed.
+	uint64_t droppedFrames = 0;
+	uint64_t staleFrames = 0;
+};
+
+// Overlaps readback, preprocessing and inference across consecutive frames: while frame N is
+// running through the model, frame N+1 is being preprocessed and the readback of frame N+2 is in
+// flight. The readback stage runs on TouchDesigner's cook thread (via `submit()`), the other two
+// stages each have their own worker thread. Stages are connected by lock-free SPSC queues, and
+// frames are recycled back to the cook thread through a third one, so the cook thread never blocks.
+class FramePipeline
+{
+public:
+	using Stage = std::function<tensorflow::Status(Frame*)>;
+
+	FramePipeline();
+	~FramePipeline();
+
+	// Starts the worker threads. `depth` is the capacity of the queues between stages: deeper queues
+	// absorb more jitter (higher throughput) at the cost of end-to-end latency. With `latestWins`,
+	// a new frame replaces the oldest queued one when the preprocessing stage falls behind, instead
+	// of being dropped.
+	void start(size_t depth, bool latestWins, Stage preprocess, Stage inference);
+	void stop();
+
+	bool isRunning() const
+	{
+		return running;
+	}
+
+	size_t depth() const
+	{
+		return queueDepth;
+	}
+
+	bool latestWins() const
+	{
+		return overwriteStale;
+	}
+
+	// Called from the cook thread with freshly downloaded pixels. This never waits on the other
+	// stages: if the pipeline is backed up, the frame is dropped and false is returned.
+	bool submit(const void* pixels,
+				int width,
+				int height,
+				PixelFormat format,
+				PipelineClock::time_point captureTime,
+				PipelineClock::time_point readbackStart);
+
+	// The index of the most recently submitted frame, which `takeLatest()` reports once its outputs
+	// are ready.
+	uint64_t lastSubmitted() const
+	{
+		return nextIndex;
+	}
+
+	// Copies the outputs of the most recently completed frame (and optionally its index), returning
+	// false if no new frame has completed since the last call.
+	bool takeLatest(std::vector<tensorflow::Tensor>* outputs, uint64_t* index = nullptr);
+
+	PipelineStats stats();
+
+private:
+	void preprocessLoop();
+	void inferenceLoop();
+	void addBusyTime(std::atomic<int64_t>& counter, PipelineClock::time_point start);
+
+	Stage preprocessStage;
+	Stage inferenceStage;
+
+	std::vector<std::unique_ptr<Frame>> frames;
+
+	// cook thread -> preprocessing -> inference -> cook thread
+	std::unique_ptr<SpscQueue<Frame>> preprocessQueue;
+	std::unique_ptr<SpscQueue<Frame>> inferenceQueue;
+	std::unique_ptr<SpscQueue<Frame>> freeFrames;
+
+	// A frame evicted from the preprocessing queue, which the cook thread reuses for the next submit.
+	Frame* spareFrame;
+
+	WorkerSignal preprocessSignal;
+	WorkerSignal inferenceSignal;
+
+	std::thread preprocessThread;
+	std::thread inferenceThread;
+	std::atomic<bool> running;
+	size_t queueDepth;
+	bool overwriteStale;
+	uint64_t nextIndex;
+
+	std::mutex resultMutex;
+	std::vector<tensorflow::Tensor> latestOutputs;
+	uint64_t latestIndex;
+	uint64_t takenIndex;
+
+	// Statistics, accumulated in microseconds.
+	std::atomic<int64_t> readbackBusy;
+	std::atomic<int64_t> preprocessBusy;
+	std::atomic<int64_t> inferenceBusy;
+	std::atomic<int64_t> latencyTotal;
+	std::atomic<uint64_t> latencyFrames;
+	std::atomic<uint64_t> completed;
+	std::atomic<uint64_t> dropped;
+	PipelineClock::time_point statsStart;
+};
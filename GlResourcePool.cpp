@@ -0,0 +1,96 @@
+#include "GlResourcePool.h"
+
+#include <algorithm>
+#include <cassert>
+
+GlResourcePool::GlResourcePool(size_t maxIdleTextures) :
+	maxIdle(maxIdleTextures)
+{
+}
+
+GlResourcePool::~GlResourcePool()
+{
+	// There might not be a current GL context at this point, so the owner has to call `clear()`.
+	assert(textures.empty() && framebuffers.empty());
+}
+
+GLuint GlResourcePool::acquireTexture(GLsizei width, GLsizei height, GLenum internalFormat)
+{
+	const Key key(width, height, internalFormat);
+	for (auto it = idle.begin(); it != idle.end(); ++it)
+	{
+		if (textures.at(*it) == key)
+		{
+			const GLuint texture = *it;
+			idle.erase(it);
+			return texture;
+		}
+	}
+
+	// Immutable storage can't be resized, which is fine: a different size is a different key.
+	GLuint texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureStorage2D(texture, 1, internalFormat, width, height);
+
+	textures[texture] = key;
+	return texture;
+}
+
+void GlResourcePool::releaseTexture(GLuint texture)
+{
+	if (texture == 0 || textures.find(texture) == textures.end())
+	{
+		return;
+	}
+	assert(std::find(idle.begin(), idle.end(), texture) == idle.end());
+
+	idle.push_back(texture);
+	while (idle.size() > maxIdle)
+	{
+		destroyTexture(idle.front());
+		idle.pop_front();
+	}
+}
+
+GLuint GlResourcePool::framebufferFor(GLuint texture)
+{
+	auto it = framebuffers.find(texture);
+	if (it != framebuffers.end())
+	{
+		return it->second;
+	}
+
+	// The attachment never changes, since the texture's storage is immutable.
+	GLuint framebuffer;
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, texture, 0);
+
+	framebuffers[texture] = framebuffer;
+	return framebuffer;
+}
+
+void GlResourcePool::clear()
+{
+	while (!textures.empty())
+	{
+		destroyTexture(textures.begin()->first);
+	}
+	idle.clear();
+}
+
+void GlResourcePool::destroyTexture(GLuint texture)
+{
+	auto framebuffer = framebuffers.find(texture);
+	if (framebuffer != framebuffers.end())
+	{
+		glDeleteFramebuffers(1, &framebuffer->second);
+		framebuffers.erase(framebuffer);
+	}
+
+	glDeleteTextures(1, &texture);
+	textures.erase(texture);
+}
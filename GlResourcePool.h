@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <tuple>
+
+#include "CPlusPlus_Common.h"
+
+// Hands out immutable-storage 2D textures (and a framebuffer for each of them), keyed by their
+// width, height and internal format. Released textures are kept around for reuse, so that toggling
+// between a few input resolutions doesn't create new GL objects every time, and the number of idle
+// textures is capped, so that an ever-changing resolution doesn't grow GPU memory either.
+//
+// All methods (including `clear()`, which the owner has to call before it is destroyed) must be
+// called while the owner's GL context is current.
+class GlResourcePool
+{
+public:
+	explicit GlResourcePool(size_t maxIdleTextures = 4);
+	~GlResourcePool();
+
+	// Returns a texture with the given dimensions and format, reusing an idle one if possible.
+	GLuint acquireTexture(GLsizei width, GLsizei height, GLenum internalFormat);
+
+	// Returns a texture to the pool. Passing 0 is a no-op.
+	void releaseTexture(GLuint texture);
+
+	// Returns a framebuffer with `texture` attached as its only color attachment. The framebuffer is
+	// owned by the pool and lives for as long as the texture does.
+	GLuint framebufferFor(GLuint texture);
+
+	// Deletes every texture and framebuffer that the pool created, including ones still in use.
+	void clear();
+
+	size_t textureCount() const
+	{
+		return textures.size();
+	}
+
+	size_t framebufferCount() const
+	{
+		return framebuffers.size();
+	}
+
+private:
+	using Key = std::tuple<GLsizei, GLsizei, GLenum>;
+
+	void destroyTexture(GLuint texture);
+
+	size_t maxIdle;
+
+	// Every texture that the pool created, with its key.
+	std::map<GLuint, Key> textures;
+
+	// Released textures, least recently released first.
+	std::deque<GLuint> idle;
+
+	std::map<GLuint, GLuint> framebuffers;
+};
@@ -0,0 +1,70 @@
+#include "GrayImage.h"
+
+#include <algorithm>
+
+namespace
+{
+	template <typename Pixels>
+	float luma(const typename Pixels::Component* pixel)
+	{
+		return (0.299f * pixel[Pixels::source(0)] + 0.587f * pixel[Pixels::source(1)] + 0.114f * pixel[Pixels::source(2)]) * Pixels::scale();
+	}
+
+	template <typename Pixels>
+	void downscale(const void* pixelData, int pixelsWidth, int pixelsHeight, GrayImage* gray)
+	{
+		using Component = typename Pixels::Component;
+		const Component* pixels = static_cast<const Component*>(pixelData);
+		const size_t rowComponents = static_cast<size_t>(pixelsWidth) * Pixels::channels;
+
+		// The 2x2 taps at the center of each block, clamped to the image.
+		const int half = gray->factor / 2;
+		std::vector<size_t> left(gray->width);
+		std::vector<size_t> right(gray->width);
+		for (int x = 0; x < gray->width; ++x)
+		{
+			const int center = std::min(x * gray->factor + half, pixelsWidth - 1);
+			left[x] = std::max(center - 1, 0) * Pixels::channels;
+			right[x] = center * Pixels::channels;
+		}
+
+		for (int y = 0; y < gray->height; ++y)
+		{
+			const int center = std::min(y * gray->factor + half, pixelsHeight - 1);
+			const Component* top = pixels + std::max(center - 1, 0) * rowComponents;
+			const Component* bottom = pixels + center * rowComponents;
+			uint8_t* out = gray->pixels.data() + static_cast<size_t>(y) * gray->width;
+
+			for (int x = 0; x < gray->width; ++x)
+			{
+				const float sum = luma<Pixels>(top + left[x]) + luma<Pixels>(top + right[x]) + luma<Pixels>(bottom + left[x]) + luma<Pixels>(bottom + right[x]);
+				out[x] = static_cast<uint8_t>(std::min(std::max(sum * 0.25f + 0.5f, 0.0f), 255.0f));
+			}
+		}
+	}
+}
+
+void downscaleToGray(const void* pixels, int pixelsWidth, int pixelsHeight, PixelFormat format, int maxWidth, GrayImage* gray)
+{
+	maxWidth = std::max(maxWidth, 1);
+	gray->factor = std::max(1, (pixelsWidth + maxWidth - 1) / maxWidth);
+	gray->width = std::max(1, pixelsWidth / gray->factor);
+	gray->height = std::max(1, pixelsHeight / gray->factor);
+	gray->pixels.resize(static_cast<size_t>(gray->width) * gray->height);
+
+	switch (format)
+	{
+	case PixelFormat::BGRA8:
+		downscale<Bgra8Pixels>(pixels, pixelsWidth, pixelsHeight, gray);
+		break;
+	case PixelFormat::RGBA32F:
+		downscale<Rgba32fPixels>(pixels, pixelsWidth, pixelsHeight, gray);
+		break;
+	case PixelFormat::R8:
+		downscale<R8Pixels>(pixels, pixelsWidth, pixelsHeight, gray);
+		break;
+	case PixelFormat::R32F:
+		downscale<R32fPixels>(pixels, pixelsWidth, pixelsHeight, gray);
+		break;
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PixelConversion.h"
+
+// A small 8-bit grayscale copy of downloaded pixels, stored top-down. Tracking only needs coarse
+// structure, so working at a fraction of the input's resolution keeps it far cheaper than a run of
+// the model.
+struct GrayImage
+{
+	int width = 0;
+	int height = 0;
+
+	// How many input pixels one gray pixel stands for, along each axis.
+	int factor = 1;
+	std::vector<uint8_t> pixels;
+
+	const uint8_t* row(int y) const
+	{
+		return pixels.data() + static_cast<size_t>(y) * width;
+	}
+};
+
+// Reduces downloaded pixels by the smallest integer factor that brings them to at most `maxWidth`
+// pixels across, and converts them to luma. Every gray pixel averages the 2x2 input pixels at the
+// center of the block it stands for, which avoids most of the aliasing of point sampling at a
+// fraction of the cost of averaging whole blocks.
+void downscaleToGray(const void* pixels, int pixelsWidth, int pixelsHeight, PixelFormat format, int maxWidth, GrayImage* gray);
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/mem.h"
+
+// An allocator that always returns 64-byte aligned memory, so that preprocessing can use aligned,
+// full-width (AVX-512) loads and stores on the input tensors.
+class AlignedAllocator : public tensorflow::Allocator
+{
+public:
+	static const size_t alignment = 64;
+
+	tensorflow::string Name() override
+	{
+		return "aligned_input";
+	}
+
+	void* AllocateRaw(size_t requestedAlignment, size_t numBytes) override
+	{
+		return tensorflow::port::AlignedMalloc(numBytes, static_cast<int>(requestedAlignment > alignment ? requestedAlignment : alignment));
+	}
+
+	void DeallocateRaw(void* ptr) override
+	{
+		tensorflow::port::AlignedFree(ptr);
+	}
+
+	// Tensors may outlive the TOP that created them (e.g. while a session is still holding a
+	// reference), so the allocator is never destroyed.
+	static AlignedAllocator* get()
+	{
+		static AlignedAllocator* instance = new AlignedAllocator();
+		return instance;
+	}
+};
+
+// A small ring of persistent input tensors. Preprocessing writes directly into the tensor
+// returned by `next()`, while the previous one(s) may still be read by an inference run.
+class InputTensorRing
+{
+public:
+	explicit InputTensorRing(size_t count = 3) :
+		tensors(count),
+		index(0)
+	{
+	}
+
+	// Makes sure that the ring holds `count` tensors (or keeps its current size if `count` is 0) of
+	// the given shape and type, returning true if the tensors had to be (re)allocated. This is a no-op
+	// unless the model's input or the number of tensors in flight changes.
+	bool reserve(const tensorflow::TensorShape& shape, size_t count = 0, tensorflow::DataType dtype = tensorflow::DT_FLOAT)
+	{
+		if (allocated && shape == currentShape && dtype == currentType && (count == 0 || count == tensors.size()))
+		{
+			return false;
+		}
+
+		if (count > 0)
+		{
+			tensors.resize(count);
+		}
+		for (auto& tensor : tensors)
+		{
+			tensor = tensorflow::Tensor(AlignedAllocator::get(), dtype, shape);
+		}
+		currentShape = shape;
+		currentType = dtype;
+		allocated = true;
+		index = 0;
+
+		return true;
+	}
+
+	// Returns the next tensor in the ring, which is the one that was used least recently.
+	tensorflow::Tensor& next()
+	{
+		tensorflow::Tensor& tensor = tensors[index];
+		index = (index + 1) % tensors.size();
+		return tensor;
+	}
+
+	const tensorflow::TensorShape& shape() const
+	{
+		return currentShape;
+	}
+
+	size_t size() const
+	{
+		return tensors.size();
+	}
+
+private:
+	std::vector<tensorflow::Tensor> tensors;
+	tensorflow::TensorShape currentShape;
+	tensorflow::DataType currentType = tensorflow::DT_FLOAT;
+	size_t index;
+	bool allocated = false;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Decides, frame by frame, whether a small model's result is good enough or the full model has to
+// run as well, and keeps track of what that saves. Most frames of a typical scene are easy, and the
+// small model tells them apart by the margin between its two best classes: a clear winner is kept,
+// a close call escalates to the full model.
+//
+// The savings are measured against running the full model alone, whose cost is averaged over the
+// frames that escalate. Until the full model has run once there is nothing to compare against, so
+// the first frame always escalates.
+class ModelCascade
+{
+public:
+	ModelCascade() :
+		threshold(0.2f),
+		frames(0),
+		escalations(0),
+		fullMs(0.0),
+		savedMs(0.0)
+	{
+	}
+
+	void configure(float marginThreshold)
+	{
+		threshold = marginThreshold;
+	}
+
+	// The difference between the two highest scores.
+	static float margin(const float* scores, size_t count)
+	{
+		if (count < 2)
+		{
+			return 1.0f;
+		}
+
+		// One pass over the scores, since this runs on every frame.
+		float first = std::max(scores[0], scores[1]);
+		float second = std::min(scores[0], scores[1]);
+		for (size_t i = 2; i < count; ++i)
+		{
+			if (scores[i] > first)
+			{
+				second = first;
+				first = scores[i];
+			}
+			else if (scores[i] > second)
+			{
+				second = scores[i];
+			}
+		}
+		return first - second;
+	}
+
+	bool shouldEscalate(float margin) const
+	{
+		return escalations == 0 || margin < threshold;
+	}
+
+	// Records one frame: the time the small model took, and the full model's if it ran as well.
+	void record(double smallMs, bool escalated, double fullModelMs)
+	{
+		++frames;
+		if (escalated)
+		{
+			++escalations;
+			fullMs += (fullModelMs - fullMs) / escalations;
+		}
+		const double frameMs = smallMs + (escalated ? fullModelMs : 0.0);
+		savedMs += ((fullMs - frameMs) - savedMs) / frames;
+	}
+
+	// The fraction of frames that ran the full model.
+	double escalationRate() const
+	{
+		return frames > 0 ? static_cast<double>(escalations) / frames : 0.0;
+	}
+
+	double averageFullMs() const
+	{
+		return fullMs;
+	}
+
+	// The average time per frame saved compared to always running the full model (negative if the
+	// cascade costs more than it saves).
+	double averageSavedMs() const
+	{
+		return savedMs;
+	}
+
+	void reset()
+	{
+		frames = 0;
+		escalations = 0;
+		fullMs = 0.0;
+		savedMs = 0.0;
+	}
+
+private:
+	float threshold;
+	uint64_t frames;
+	uint64_t escalations;
+	double fullMs;
+	double savedMs;
+};
@@ -0,0 +1,142 @@
+#include "PixelConversion.h"
+
+namespace
+{
+	// Fills in the kernels for every pixel format, given the rest of the model's input.
+	template <typename Layout, ChannelOrder Order, typename Value>
+	void selectKernels(PixelKernel* kernels)
+	{
+		kernels[static_cast<int>(PixelFormat::BGRA8)] = &resizePixelsIntoTensor<Bgra8Pixels, Layout, Order, Value>;
+		kernels[static_cast<int>(PixelFormat::RGBA32F)] = &resizePixelsIntoTensor<Rgba32fPixels, Layout, Order, Value>;
+		kernels[static_cast<int>(PixelFormat::R8)] = &resizePixelsIntoTensor<R8Pixels, Layout, Order, Value>;
+		kernels[static_cast<int>(PixelFormat::R32F)] = &resizePixelsIntoTensor<R32fPixels, Layout, Order, Value>;
+	}
+
+	template <typename Layout, ChannelOrder Order>
+	bool selectKernels(tensorflow::DataType type, PixelKernel* kernels)
+	{
+		switch (type)
+		{
+		case tensorflow::DT_FLOAT:
+			selectKernels<Layout, Order, float>(kernels);
+			return true;
+		case tensorflow::DT_UINT8:
+			selectKernels<Layout, Order, uint8_t>(kernels);
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	template <typename Layout>
+	bool selectKernels(const InputFormat& input, PixelKernel* kernels)
+	{
+		return input.order == ChannelOrder::BGR ?
+			selectKernels<Layout, ChannelOrder::BGR>(input.type, kernels) :
+			selectKernels<Layout, ChannelOrder::RGB>(input.type, kernels);
+	}
+
+	// The layouts are specialized for the number of channels, so that their strides are constants.
+	template <template <int> class Layout>
+	bool selectKernels(const InputFormat& input, PixelKernel* kernels)
+	{
+		switch (input.channels)
+		{
+		case 1:
+			return selectKernels<Layout<1>>(input, kernels);
+		case 2:
+			return selectKernels<Layout<2>>(input, kernels);
+		case 3:
+			return selectKernels<Layout<3>>(input, kernels);
+		case 4:
+			return selectKernels<Layout<4>>(input, kernels);
+		default:
+			return false;
+		}
+	}
+}
+
+size_t bytesPerPixel(PixelFormat format)
+{
+	switch (format)
+	{
+	case PixelFormat::BGRA8:
+		return 4;
+	case PixelFormat::RGBA32F:
+		return 4 * sizeof(float);
+	case PixelFormat::R8:
+		return 1;
+	case PixelFormat::R32F:
+		return sizeof(float);
+	}
+	return 0;
+}
+
+PixelConverter::PixelConverter() :
+	scale(1.0f),
+	bias(0.0f)
+{
+	std::fill(kernels, kernels + formatCount, nullptr);
+}
+
+bool PixelConverter::select(const InputFormat& input)
+{
+	// Every normalization is a multiply-add, so it doesn't need its own kernels.
+	switch (input.normalization)
+	{
+	case Normalization::Centered:
+		scale = 1.0f / 128.0f;
+		bias = -1.0f;
+		break;
+	case Normalization::Unit:
+		scale = 1.0f / 255.0f;
+		bias = 0.0f;
+		break;
+	case Normalization::Raw:
+		scale = 1.0f;
+		bias = 0.0f;
+		break;
+	}
+
+	const bool selected = input.layout == TensorLayout::NCHW ?
+		selectKernels<NchwLayout>(input, kernels) :
+		selectKernels<NhwcLayout>(input, kernels);
+	if (!selected)
+	{
+		std::fill(kernels, kernels + formatCount, nullptr);
+	}
+	return selected;
+}
+
+tensorflow::Status PixelConverter::convert(const void* pixels,
+										   int pixelsWidth,
+										   int pixelsHeight,
+										   PixelFormat format,
+										   const Letterbox& region,
+										   tensorflow::Tensor* tensor,
+										   int batch) const
+{
+	Letterbox crop;
+	crop.width = pixelsWidth;
+	crop.height = pixelsHeight;
+
+	return convert(pixels, pixelsWidth, pixelsHeight, format, crop, region, tensor, batch);
+}
+
+tensorflow::Status PixelConverter::convert(const void* pixels,
+										   int pixelsWidth,
+										   int pixelsHeight,
+										   PixelFormat format,
+										   const Letterbox& crop,
+										   const Letterbox& region,
+										   tensorflow::Tensor* tensor,
+										   int batch,
+										   bool mirror) const
+{
+	const PixelKernel kernel = kernels[static_cast<int>(format)];
+	if (kernel == nullptr)
+	{
+		return tensorflow::errors::InvalidArgument("Only float and uint8 model inputs with 1 to 4 channels are supported.");
+	}
+	return kernel(pixels, pixelsWidth, pixelsHeight, crop, mirror, region, scale, bias, batch, tensor);
+}
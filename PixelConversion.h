@@ -0,0 +1,375 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ShapeBuckets.h"
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+
+// The pixel layouts that the TOP downloads its input as. 8-bit layouts are the cheapest to download,
+// float layouts preserve HDR / 16-bit sources, and single-channel layouts avoid expanding (and then
+// discarding) three extra channels for grayscale models.
+enum class PixelFormat
+{
+	BGRA8,
+	RGBA32F,
+	R8,
+	R32F
+};
+
+size_t bytesPerPixel(PixelFormat format);
+
+// Compile-time descriptions of each pixel layout, used to specialize the conversion kernels below.
+// `scale` maps a component to the 0-255 range that the normalization parameters are expressed in,
+// and `source(c)` returns the component that holds the model's channel `c` (RGB(A) order).
+struct Bgra8Pixels
+{
+	using Component = uint8_t;
+	static const int channels = 4;
+	static float scale() { return 1.0f; }
+	static int source(int c) { return c < 3 ? 2 - c : c; }
+};
+
+struct Rgba32fPixels
+{
+	using Component = float;
+	static const int channels = 4;
+	static float scale() { return 255.0f; }
+	static int source(int c) { return c; }
+};
+
+struct R8Pixels
+{
+	using Component = uint8_t;
+	static const int channels = 1;
+	static float scale() { return 1.0f; }
+	static int source(int) { return 0; }
+};
+
+struct R32fPixels
+{
+	using Component = float;
+	static const int channels = 1;
+	static float scale() { return 255.0f; }
+	static int source(int) { return 0; }
+};
+
+// How the model's input tensor is laid out: interleaved channels (`[1, height, width, channels]`, the
+// TensorFlow default) or one plane per channel (`[1, channels, height, width]`, common in models
+// converted from other frameworks).
+enum class TensorLayout
+{
+	NHWC,
+	NCHW
+};
+
+// The order that the model expects color channels in.
+enum class ChannelOrder
+{
+	RGB,
+	BGR
+};
+
+// How 0-255 pixel values are mapped to float inputs: centered on zero ((value - 128) / 128), scaled to
+// 0-1, or left as they are. 8-bit inputs always take the raw value.
+enum class Normalization
+{
+	Centered,
+	Unit,
+	Raw
+};
+
+// Everything about the model's input that the conversion depends on, worked out when the model is loaded.
+struct InputFormat
+{
+	TensorLayout layout = TensorLayout::NHWC;
+	ChannelOrder order = ChannelOrder::RGB;
+	Normalization normalization = Normalization::Centered;
+	tensorflow::DataType type = tensorflow::DT_FLOAT;
+	int channels = 3;
+
+	tensorflow::TensorShape shape(tensorflow::int64 height, tensorflow::int64 width, tensorflow::int64 batch = 1) const
+	{
+		return layout == TensorLayout::NCHW ?
+			tensorflow::TensorShape({ batch, channels, height, width }) :
+			tensorflow::TensorShape({ batch, height, width, channels });
+	}
+};
+
+// Compile-time descriptions of each tensor layout, for a model with `Channels` input channels.
+// `pixelStride` is the distance between neighboring pixels of one channel and `spans` the number of
+// contiguous runs that a row of the image is stored as: one run of interleaved channels for NHWC,
+// one per channel plane for NCHW. Both are constants, so that the inner loops store contiguously.
+template <int Channels>
+struct NhwcLayout
+{
+	static const int channels = Channels;
+	static const int pixelStride = Channels;
+	static const int spans = 1;
+	static int height(const tensorflow::Tensor& tensor) { return static_cast<int>(tensor.dim_size(1)); }
+	static int width(const tensorflow::Tensor& tensor) { return static_cast<int>(tensor.dim_size(2)); }
+	static int tensorChannels(const tensorflow::Tensor& tensor) { return static_cast<int>(tensor.dim_size(3)); }
+	static size_t channelStride(size_t) { return 1; }
+};
+
+template <int Channels>
+struct NchwLayout
+{
+	static const int channels = Channels;
+	static const int pixelStride = 1;
+	static const int spans = Channels;
+	static int height(const tensorflow::Tensor& tensor) { return static_cast<int>(tensor.dim_size(2)); }
+	static int width(const tensorflow::Tensor& tensor) { return static_cast<int>(tensor.dim_size(3)); }
+	static int tensorChannels(const tensorflow::Tensor& tensor) { return static_cast<int>(tensor.dim_size(1)); }
+	static size_t channelStride(size_t planeSize) { return planeSize; }
+};
+
+// Maps a value on the 0-255 scale to the model's input type: floats are normalized with `scale` and
+// `bias`, while 8-bit models take the value as is.
+inline void storeValue(float value, float scale, float bias, float* out)
+{
+	*out = value * scale + bias;
+}
+
+inline void storeValue(float value, float, float, uint8_t* out)
+{
+	*out = static_cast<uint8_t>(std::min(std::max(value + 0.5f, 0.0f), 255.0f));
+}
+
+// Resizes the `crop` rectangle of `pixels` into `region` of image `batch` of the tensor with the same
+// sampling as `ResizeBilinear` (`align_corners = false`) applied to the cropped image, and fills the
+// rest of that image with mid-gray padding. With `mirror`, the crop is flipped horizontally on the
+// way, which only changes the order of the horizontal taps. Rows of the input are read top-down.
+// Images of a batch can be converted concurrently. Everything that varies per model is a template
+// parameter, so the channel lookups and strides are constants.
+//
+// Each input row that is needed is first resampled horizontally into a row laid out like the
+// tensor's (this is the only pass that gathers, and it runs once per input row rather than once per
+// output row and channel). Output rows are then blends of two of those, which read and store
+// contiguously and vectorize.
+template <typename Pixels, typename Layout, ChannelOrder Order, typename Value>
+tensorflow::Status resizePixelsIntoTensor(const void* pixelData,
+										  int pixelsWidth,
+										  int pixelsHeight,
+										  const Letterbox& crop,
+										  bool mirror,
+										  const Letterbox& region,
+										  float scale,
+										  float bias,
+										  int batch,
+										  tensorflow::Tensor* tensor)
+{
+	using Component = typename Pixels::Component;
+	const int channels = Layout::channels;
+	const int pixelStride = Layout::pixelStride;
+
+	const int tensorHeight = Layout::height(*tensor);
+	const int tensorWidth = Layout::width(*tensor);
+
+	if (Layout::tensorChannels(*tensor) != channels)
+	{
+		return tensorflow::errors::InvalidArgument("The tensor has ", Layout::tensorChannels(*tensor), " channels, but the conversion was set up for ", channels, ".");
+	}
+	if (region.x < 0 || region.y < 0 || region.x + region.width > tensorWidth || region.y + region.height > tensorHeight)
+	{
+		return tensorflow::errors::InvalidArgument("Letterbox region lies outside of the tensor.");
+	}
+	if (crop.x < 0 || crop.y < 0 || crop.width < 1 || crop.height < 1 || crop.x + crop.width > pixelsWidth || crop.y + crop.height > pixelsHeight)
+	{
+		return tensorflow::errors::InvalidArgument("Crop lies outside of the image.");
+	}
+	if (batch < 0 || batch >= tensor->dim_size(0))
+	{
+		return tensorflow::errors::InvalidArgument("Batch index ", batch, " lies outside of the tensor.");
+	}
+
+	const size_t planeSize = static_cast<size_t>(tensorWidth) * tensorHeight;
+	const Component* pixels = static_cast<const Component*>(pixelData);
+	Value* data = tensor->flat<Value>().data() + (batch * planeSize * channels);
+	const size_t channelStride = Layout::channelStride(planeSize);
+	const size_t rowStride = static_cast<size_t>(tensorWidth) * pixelStride;
+
+	// Padding is written separately, since the image overwrites everything else.
+	Value padding;
+	storeValue(128.0f, scale, bias, &padding);
+	auto pad = [&](int y, int begin, int end)
+	{
+		for (int c = 0; c < channels; ++c)
+		{
+			Value* row = data + (y * rowStride) + (c * channelStride);
+			for (int x = begin; x < end; ++x)
+			{
+				row[x * pixelStride] = padding;
+			}
+		}
+	};
+	for (int y = 0; y < tensorHeight; ++y)
+	{
+		if (y < region.y || y >= region.y + region.height)
+		{
+			pad(y, 0, tensorWidth);
+		}
+		else
+		{
+			pad(y, 0, region.x);
+			pad(y, region.x + region.width, tensorWidth);
+		}
+	}
+
+	const float scaleY = static_cast<float>(crop.height) / region.height;
+	const float scaleX = static_cast<float>(crop.width) / region.width;
+
+	// The component that holds each of the model's channels. Channel order only applies to color.
+	int sources[channels];
+	for (int c = 0; c < channels; ++c)
+	{
+		sources[c] = Pixels::source(Order == ChannelOrder::BGR && channels >= 3 && c < 3 ? 2 - c : c);
+	}
+
+	// Horizontal taps are the same for every row, so compute them once (as component offsets).
+	std::vector<int> x0(region.width);
+	std::vector<int> x1(region.width);
+	std::vector<float> xLerp(region.width);
+	for (int x = 0; x < region.width; ++x)
+	{
+		const float inX = x * scaleX;
+		const int left = static_cast<int>(inX);
+		x0[x] = (crop.x + left) * Pixels::channels;
+		x1[x] = (crop.x + std::min(left + 1, crop.width - 1)) * Pixels::channels;
+		xLerp[x] = inX - left;
+	}
+	if (mirror)
+	{
+		std::reverse(x0.begin(), x0.end());
+		std::reverse(x1.begin(), x1.end());
+		std::reverse(xLerp.begin(), xLerp.end());
+	}
+
+	// Input rows resampled to the region's width, in the tensor's layout: for NHWC one run of
+	// interleaved channels, for NCHW one run per channel, `spanLength` apart.
+	const int rowLength = region.width * channels;
+	const int spanLength = rowLength / Layout::spans;
+	const size_t spanStride = Layout::spans == 1 ? 0 : channelStride;
+	std::vector<float> resampled(2 * static_cast<size_t>(rowLength));
+	float* rows[2] = { resampled.data(), resampled.data() + rowLength };
+	int rowSources[2] = { -1, -1 };
+
+	auto resampleRow = [&](int inputRow, float* row)
+	{
+		const Component* input = pixels + (static_cast<size_t>(inputRow) * pixelsWidth * Pixels::channels);
+		for (int c = 0; c < channels; ++c)
+		{
+			const Component* source = input + sources[c];
+			float* out = row + (c * (Layout::spans == 1 ? 1 : region.width));
+			for (int x = 0; x < region.width; ++x)
+			{
+				const float left = source[x0[x]];
+				out[x * pixelStride] = left + (source[x1[x]] - left) * xLerp[x];
+			}
+		}
+	};
+	// Returns the resampled input row, reusing the rows of the previous output row (when upscaling,
+	// consecutive output rows share their input rows).
+	auto fetchRow = [&](int inputRow, int slot) -> const float*
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			if (rowSources[i] == inputRow)
+			{
+				if (i != slot)
+				{
+					std::swap(rows[i], rows[slot]);
+					std::swap(rowSources[i], rowSources[slot]);
+				}
+				return rows[slot];
+			}
+		}
+		resampleRow(inputRow, rows[slot]);
+		rowSources[slot] = inputRow;
+		return rows[slot];
+	};
+
+	for (int y = 0; y < region.height; ++y)
+	{
+		const float inY = y * scaleY;
+		const int top = static_cast<int>(inY);
+		const int y0 = crop.y + top;
+		const int y1 = crop.y + std::min(top + 1, crop.height - 1);
+		const float yLerp = inY - top;
+
+		const float* topRow = fetchRow(y0, 0);
+		const float* bottomRow = fetchRow(y1, 1);
+
+		Value* output = data + ((region.y + y) * rowStride) + (region.x * pixelStride);
+		for (int span = 0; span < Layout::spans; ++span)
+		{
+			const float* topSpan = topRow + (span * spanLength);
+			const float* bottomSpan = bottomRow + (span * spanLength);
+			Value* out = output + (span * spanStride);
+			for (int i = 0; i < spanLength; ++i)
+			{
+				const float pixel = (topSpan[i] + (bottomSpan[i] - topSpan[i]) * yLerp) * Pixels::scale();
+				storeValue(pixel, scale, bias, &out[i]);
+			}
+		}
+	}
+
+	return tensorflow::Status::OK();
+}
+
+// One instantiation of `resizePixelsIntoTensor`.
+using PixelKernel = tensorflow::Status (*)(const void* pixels,
+										   int pixelsWidth,
+										   int pixelsHeight,
+										   const Letterbox& crop,
+										   bool mirror,
+										   const Letterbox& region,
+										   float scale,
+										   float bias,
+										   int batch,
+										   tensorflow::Tensor* tensor);
+
+// Converts downloaded pixels into the model's input tensor. The kernels for the model's layout,
+// channel order and input type (one per pixel format) are looked up once by `select()`, so converting
+// a frame is a single indirect call with no per-pixel branching.
+class PixelConverter
+{
+public:
+	PixelConverter();
+
+	// Returns false (and keeps converting nothing) if the input type isn't float or uint8, or the model
+	// doesn't take 1 to 4 channels.
+	bool select(const InputFormat& input);
+
+	tensorflow::Status convert(const void* pixels,
+							   int pixelsWidth,
+							   int pixelsHeight,
+							   PixelFormat format,
+							   const Letterbox& region,
+							   tensorflow::Tensor* tensor,
+							   int batch = 0) const;
+
+	// Converts only the `crop` rectangle of the pixels (e.g. a region of interest), optionally mirrored.
+	tensorflow::Status convert(const void* pixels,
+							   int pixelsWidth,
+							   int pixelsHeight,
+							   PixelFormat format,
+							   const Letterbox& crop,
+							   const Letterbox& region,
+							   tensorflow::Tensor* tensor,
+							   int batch,
+							   bool mirror = false) const;
+
+private:
+	static const int formatCount = 4;
+
+	PixelKernel kernels[formatCount];
+	float scale;
+	float bias;
+};
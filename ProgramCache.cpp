@@ -0,0 +1,232 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace
+{
+	// FNV-1a, which (unlike `std::hash`) is the same in every build, so it can name files on disk.
+	void hashBytes(const char* bytes, size_t length, uint64_t* hash)
+	{
+		for (size_t i = 0; i < length; ++i)
+		{
+			*hash ^= static_cast<unsigned char>(bytes[i]);
+			*hash *= 1099511628211ull;
+		}
+	}
+
+	void hashString(const char* text, uint64_t* hash)
+	{
+		// Include the terminator, so that ("ab", "c") and ("a", "bc") hash differently.
+		hashBytes(text, std::strlen(text) + 1, hash);
+	}
+
+	// Binaries are only valid for the driver that produced them, so the driver is part of the key.
+	uint64_t hashProgram(const std::string& vertSrc, const std::string& fragSrc)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		hashString(vertSrc.c_str(), &hash);
+		hashString(fragSrc.c_str(), &hash);
+		hashString(reinterpret_cast<const char*>(glGetString(GL_VENDOR)), &hash);
+		hashString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)), &hash);
+		hashString(reinterpret_cast<const char*>(glGetString(GL_VERSION)), &hash);
+		return hash;
+	}
+}
+
+ProgramCache& ProgramCache::get()
+{
+	static ProgramCache instance;
+	return instance;
+}
+
+ProgramCache::ProgramCache()
+{
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats <= 0)
+	{
+		std::cout << "The driver doesn't support program binaries, so shaders will be compiled on every launch.\n";
+		return;
+	}
+
+	const char* root = std::getenv("LOCALAPPDATA");
+	const std::string folder = tensorflow::io::JoinPath(root ? root : ".", "TensorFlowTOP", "programs");
+	if (tensorflow::Env::Default()->RecursivelyCreateDir(folder).ok())
+	{
+		directory = folder;
+	}
+}
+
+GLuint ProgramCache::acquire(const std::string& vertSrc, const std::string& fragSrc, Source* source)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const uint64_t key = hashProgram(vertSrc, fragSrc);
+	auto it = programs.find(key);
+	if (it != programs.end())
+	{
+		++it->second.references;
+		if (source)
+		{
+			*source = Source::Shared;
+		}
+		return it->second.program;
+	}
+
+	std::string path;
+	if (!directory.empty())
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+		path = tensorflow::io::JoinPath(directory, name);
+	}
+
+	Source built = Source::Binary;
+	GLuint program = loadBinary(path);
+	if (program == 0)
+	{
+		built = Source::Compiled;
+		program = createGlslProgram(vertSrc, fragSrc, !path.empty());
+		storeBinary(program, path);
+	}
+
+	programs[key] = { program, 1 };
+	if (source)
+	{
+		*source = built;
+	}
+	return program;
+}
+
+void ProgramCache::release(GLuint program)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (auto it = programs.begin(); it != programs.end(); ++it)
+	{
+		if (it->second.program == program)
+		{
+			if (--it->second.references == 0)
+			{
+				glDeleteProgram(program);
+				programs.erase(it);
+			}
+			return;
+		}
+	}
+}
+
+GLuint ProgramCache::loadBinary(const std::string& path)
+{
+	// Stored as the binary format, followed by the binary itself.
+	std::string contents;
+	if (path.empty() ||
+		!tensorflow::ReadFileToString(tensorflow::Env::Default(), path, &contents).ok() ||
+		contents.size() <= sizeof(GLenum))
+	{
+		return 0;
+	}
+
+	GLenum format;
+	std::memcpy(&format, contents.data(), sizeof(format));
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, format, contents.data() + sizeof(format), static_cast<GLsizei>(contents.size() - sizeof(format)));
+
+	// Drivers are free to reject binaries (e.g. after an update), in which case we compile from source.
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		std::cout << "Stored program binary was rejected by the driver, recompiling.\n";
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+void ProgramCache::storeBinary(GLuint program, const std::string& path)
+{
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (path.empty() || !success || length <= 0)
+	{
+		return;
+	}
+
+	std::string contents(sizeof(GLenum) + length, '\0');
+	GLenum format;
+	glGetProgramBinary(program, length, nullptr, &format, &contents[sizeof(GLenum)]);
+	std::memcpy(&contents[0], &format, sizeof(format));
+
+	if (!tensorflow::WriteStringToFile(tensorflow::Env::Default(), path, contents).ok())
+	{
+		std::cout << "Failed to store program binary at " << path << "\n";
+	}
+}
+
+GLuint createGlslProgram(const std::string& vertSrc, const std::string& fragSrc, bool retrievable)
+{
+	// Vertex shader
+	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	const char* vertSrcPtr = vertSrc.c_str();
+	glShaderSource(vertexShader, 1, &vertSrcPtr, nullptr);
+	glCompileShader(vertexShader);
+
+	// Check for compile time errors
+	GLint success;
+	GLchar infoLog[512];
+	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+		std::cout << "Error compiling vertex shader:\n" << infoLog << std::endl;
+	}
+
+	// Fragment shader
+	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	const char* fragSrcPtr = fragSrc.c_str();
+	glShaderSource(fragmentShader, 1, &fragSrcPtr, NULL);
+	glCompileShader(fragmentShader);
+
+	// Check for compile time errors
+	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+		std::cout << "Error compiling fragment shader:\n" << infoLog << std::endl;
+	}
+
+	// Link shaders
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	if (retrievable)
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(program);
+
+	// Check for linking errors
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) 
+	{
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		std::cout << "Error linking program:\n" << infoLog << std::endl;
+	}
+
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	return program;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "CPlusPlus_Common.h"
+
+// A process-wide cache of linked GLSL programs, keyed by a hash of their sources. Every instance of
+// the TOP uses the same shaders, so only the first one builds them: the others share its program
+// (TouchDesigner's C++ TOPs share GL objects with each other). Linked programs are also written to
+// disk with `glGetProgramBinary()`, so that later launches can skip compiling altogether. If the
+// driver rejects a stored binary (e.g. after a driver update), the program is compiled from source.
+//
+// All methods must be called while a GL context is current.
+class ProgramCache
+{
+public:
+	enum class Source
+	{
+		// The program was compiled and linked from source.
+		Compiled,
+
+		// The program was loaded from a binary stored on disk.
+		Binary,
+
+		// Another instance had already built the program.
+		Shared
+	};
+
+	static ProgramCache& get();
+
+	// Returns a program built from the given sources, which has to be handed back with `release()`.
+	GLuint acquire(const std::string& vertSrc, const std::string& fragSrc, Source* source = nullptr);
+
+	// Deletes the program once no instance is using it anymore.
+	void release(GLuint program);
+
+private:
+	struct Entry
+	{
+		GLuint program;
+		int references;
+	};
+
+	ProgramCache();
+
+	GLuint loadBinary(const std::string& path);
+	void storeBinary(GLuint program, const std::string& path);
+
+	// The folder that binaries are stored in (empty if the driver can't retrieve program binaries).
+	std::string directory;
+
+	std::mutex mutex;
+	std::map<uint64_t, Entry> programs;
+};
+
+// Compiles and links a program, printing any errors. Returns the program even if linking failed.
+GLuint createGlslProgram(const std::string& vertSrc, const std::string& fragSrc, bool retrievable = false);
@@ -0,0 +1,344 @@
+#include "Quantization.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/cc/ops/image_ops.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/tools/graph_transforms/transform_graph.h"
+
+using tensorflow::GraphDef;
+using tensorflow::Status;
+using tensorflow::Tensor;
+using tensorflow::string;
+
+namespace
+{
+	// Strips the `.pb` extension (if any) so that cache files can be placed next to the model.
+	std::string stripExtension(const std::string& path)
+	{
+		const std::string extension = ".pb";
+		if (path.size() > extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0)
+		{
+			return path.substr(0, path.size() - extension.size());
+		}
+		return path;
+	}
+
+	// Returns true if `cachePath` exists and was written after `sourcePath`.
+	bool isCacheFresh(const std::string& cachePath, const std::string& sourcePath)
+	{
+		tensorflow::FileStatistics cacheStats;
+		tensorflow::FileStatistics sourceStats;
+		if (!tensorflow::Env::Default()->Stat(cachePath, &cacheStats).ok() ||
+			!tensorflow::Env::Default()->Stat(sourcePath, &sourceStats).ok())
+		{
+			return false;
+		}
+		return cacheStats.mtime_nsec >= sourceStats.mtime_nsec;
+	}
+
+	// Everything besides the float graph that a quantized graph depends on. It's stored next to the
+	// cached graph, which is only reused while it matches.
+	std::string cacheKey(const std::vector<std::string>& calibrationImages,
+						 const std::string& inputLayer,
+						 const std::string& outputLayer,
+						 const InputFormat& input,
+						 int inputHeight,
+						 int inputWidth)
+	{
+		const tensorflow::TensorShape shape = input.shape(inputHeight, inputWidth);
+		std::ostringstream key;
+		key << "input_layer " << inputLayer << "\n"
+			<< "output_layer " << outputLayer << "\n"
+			<< "input_shape " << shape.DebugString() << "\n"
+			<< "input_type " << tensorflow::DataTypeString(input.type) << "\n"
+			<< "channel_order " << static_cast<int>(input.order) << "\n"
+			<< "normalization " << static_cast<int>(input.normalization) << "\n";
+		for (const auto& path : calibrationImages)
+		{
+			key << "calibration_image " << path << "\n";
+		}
+		return key.str();
+	}
+
+	Status runTransforms(const std::string& transforms,
+						 const std::vector<string>& inputs,
+						 const std::vector<string>& outputs,
+						 GraphDef* graph)
+	{
+		tensorflow::graph_transforms::TransformParameters parameters;
+		TF_RETURN_IF_ERROR(tensorflow::graph_transforms::ParseTransformParameters(transforms, &parameters));
+		return tensorflow::graph_transforms::TransformGraph(inputs, outputs, parameters, graph);
+	}
+}
+
+Status quantizeGraph(const GraphDef& floatGraph,
+					 const std::string& inputLayer,
+					 const std::string& outputLayer,
+					 const tensorflow::TensorShape& inputShape,
+					 tensorflow::DataType inputType,
+					 GraphDef* quantizedGraph)
+{
+	std::ostringstream shape;
+	for (int i = 0; i < inputShape.dims(); ++i)
+	{
+		shape << (i > 0 ? "," : "") << inputShape.dim_size(i);
+	}
+
+	// Fold away everything that only matters during training first, so that `quantize_nodes`
+	// sees the fused Conv2D / MatMul + BiasAdd + Relu patterns it knows how to rewrite.
+	std::ostringstream transforms;
+	transforms << "add_default_attributes "
+			   << "strip_unused_nodes(type=" << tensorflow::DataTypeString(inputType) << ", shape=\"" << shape.str() << "\") "
+			   << "remove_nodes(op=Identity, op=CheckNumerics) "
+			   << "fold_constants(ignore_errors=true) "
+			   << "fold_batch_norms "
+			   << "fold_old_batch_norms "
+			   << "quantize_weights "
+			   << "quantize_nodes "
+			   << "strip_unused_nodes "
+			   << "sort_by_execution_order";
+
+	*quantizedGraph = floatGraph;
+	return runTransforms(transforms.str(), { inputLayer }, { outputLayer }, quantizedGraph);
+}
+
+Status calibrateRequantizationRanges(const GraphDef& quantizedGraph,
+									 const std::string& inputLayer,
+									 const std::vector<Tensor>& samples,
+									 const std::string& logPath)
+{
+	std::vector<string> rangeNodes;
+	for (const auto& node : quantizedGraph.node())
+	{
+		if (node.op() == "RequantizationRange")
+		{
+			rangeNodes.push_back(node.name());
+		}
+	}
+
+	if (rangeNodes.empty() || samples.empty())
+	{
+		return tensorflow::errors::FailedPrecondition("Nothing to calibrate: the graph has no dynamic ranges or no samples were found.");
+	}
+
+	// Each `RequantizationRange` op produces its observed minimum and maximum as two scalar outputs.
+	std::vector<string> fetches;
+	for (const auto& name : rangeNodes)
+	{
+		fetches.push_back(name + ":0");
+		fetches.push_back(name + ":1");
+	}
+
+	std::unique_ptr<tensorflow::Session> session(tensorflow::NewSession(tensorflow::SessionOptions()));
+	TF_RETURN_IF_ERROR(session->Create(quantizedGraph));
+
+	std::vector<std::pair<float, float>> ranges(rangeNodes.size(), { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() });
+	for (const auto& sample : samples)
+	{
+		std::vector<Tensor> outputs;
+		TF_RETURN_IF_ERROR(session->Run({ { inputLayer, sample } }, fetches, {}, &outputs));
+
+		for (size_t i = 0; i < rangeNodes.size(); ++i)
+		{
+			ranges[i].first = std::min(ranges[i].first, outputs[i * 2 + 0].scalar<float>()());
+			ranges[i].second = std::max(ranges[i].second, outputs[i * 2 + 1].scalar<float>()());
+		}
+	}
+
+	// This mirrors the lines emitted by the `insert_logging` transform:
+	// ;<node name>__print__;__requant_min_max:[<min>][<max>]
+	std::ostringstream log;
+	for (size_t i = 0; i < rangeNodes.size(); ++i)
+	{
+		log << ";" << rangeNodes[i] << "__print__;__requant_min_max:[" << ranges[i].first << "][" << ranges[i].second << "]\n";
+	}
+
+	return tensorflow::WriteStringToFile(tensorflow::Env::Default(), logPath, log.str());
+}
+
+Status freezeRequantizationRanges(const std::string& logPath, GraphDef* quantizedGraph)
+{
+	// The inputs and outputs are only used by transforms that prune the graph, which this one doesn't.
+	const std::string transforms = "freeze_requantization_ranges(min_max_log_file=\"" + logPath + "\")";
+	return runTransforms(transforms, {}, {}, quantizedGraph);
+}
+
+Status loadQuantizedGraph(const std::string& graphPath,
+						  const GraphDef& floatGraph,
+						  const std::vector<std::string>& calibrationImages,
+						  const std::string& inputLayer,
+						  const std::string& outputLayer,
+						  const InputFormat& input,
+						  int inputHeight,
+						  int inputWidth,
+						  GraphDef* quantizedGraph)
+{
+	const std::string cachePath = stripExtension(graphPath) + ".quantized.pb";
+	const std::string keyPath = stripExtension(graphPath) + ".quantized.txt";
+	const std::string logPath = stripExtension(graphPath) + ".minmax.txt";
+	const std::string key = cacheKey(calibrationImages, inputLayer, outputLayer, input, inputHeight, inputWidth);
+
+	std::string cachedKey;
+	if (isCacheFresh(cachePath, graphPath) &&
+		tensorflow::ReadFileToString(tensorflow::Env::Default(), keyPath, &cachedKey).ok() && cachedKey == key &&
+		ReadBinaryProto(tensorflow::Env::Default(), cachePath, quantizedGraph).ok())
+	{
+		std::cout << "Using cached quantized graph: " << cachePath << "\n";
+		return Status::OK();
+	}
+
+	std::cout << "Quantizing graph...\n";
+
+	TF_RETURN_IF_ERROR(quantizeGraph(floatGraph, inputLayer, outputLayer, input.shape(inputHeight, inputWidth), input.type, quantizedGraph));
+
+	// Without calibration, every `RequantizationRange` op has to scan its input on each run, so try
+	// to bake in ranges measured on the sample images. They're converted like the TOP's input, so
+	// the ranges are the ones the model will see. A quantized graph that still computes its ranges
+	// dynamically is slower, but correct, so failure here isn't fatal.
+	const std::vector<Tensor> samples = readSamples(calibrationImages, input, inputHeight, inputWidth);
+
+	Status calibrated = calibrateRequantizationRanges(*quantizedGraph, inputLayer, samples, logPath);
+	if (calibrated.ok())
+	{
+		TF_RETURN_IF_ERROR(freezeRequantizationRanges(logPath, quantizedGraph));
+	}
+	else
+	{
+		std::cout << "Skipping calibration: " << calibrated.error_message() << "\n";
+	}
+
+	if (!WriteBinaryProto(tensorflow::Env::Default(), cachePath, *quantizedGraph).ok() ||
+		!tensorflow::WriteStringToFile(tensorflow::Env::Default(), keyPath, key).ok())
+	{
+		std::cout << "Failed to cache quantized graph at: " << cachePath << "\n";
+	}
+
+	return Status::OK();
+}
+
+std::vector<std::string> listImageFiles(const std::string& folder)
+{
+	std::vector<std::string> paths;
+	for (const char* pattern : { "*.jpg", "*.jpeg" })
+	{
+		std::vector<string> matches;
+		if (tensorflow::Env::Default()->GetMatchingPaths(tensorflow::io::JoinPath(folder, pattern), &matches).ok())
+		{
+			paths.insert(paths.end(), matches.begin(), matches.end());
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+
+	return paths;
+}
+
+void splitImageFiles(const std::string& calibrationFolder,
+					 const std::string& evaluationFolder,
+					 std::vector<std::string>* calibrationImages,
+					 std::vector<std::string>* evaluationImages)
+{
+	calibrationImages->clear();
+	evaluationImages->clear();
+	if (calibrationFolder != evaluationFolder)
+	{
+		*calibrationImages = listImageFiles(calibrationFolder);
+		*evaluationImages = listImageFiles(evaluationFolder);
+		return;
+	}
+
+	const std::vector<std::string> images = listImageFiles(calibrationFolder);
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		(i % 2 == 0 ? calibrationImages : evaluationImages)->push_back(images[i]);
+	}
+}
+
+std::vector<Tensor> readSamples(const std::vector<std::string>& paths, const InputFormat& input, int height, int width)
+{
+	PixelConverter converter;
+	std::vector<Tensor> samples;
+	if (!converter.select(input))
+	{
+		return samples;
+	}
+
+	const PixelFormat format = input.channels == 1 ? PixelFormat::R8 : PixelFormat::BGRA8;
+	Letterbox region;
+	region.width = width;
+	region.height = height;
+
+	for (const auto& path : paths)
+	{
+		std::vector<uint8_t> pixels;
+		int pixelsWidth;
+		int pixelsHeight;
+		Tensor sample(input.type, input.shape(height, width));
+		if (readPixelsFromImageFile(path, format, &pixels, &pixelsWidth, &pixelsHeight).ok() &&
+			converter.convert(pixels.data(), pixelsWidth, pixelsHeight, format, region, &sample).ok())
+		{
+			samples.push_back(sample);
+		}
+	}
+	return samples;
+}
+
+Status readPixelsFromImageFile(const std::string& path,
+							   PixelFormat format,
+							   std::vector<uint8_t>* pixels,
+							   int* width,
+							   int* height)
+{
+	if (format != PixelFormat::BGRA8 && format != PixelFormat::R8)
+	{
+		return tensorflow::errors::InvalidArgument("Images can only be read as BGRA8 or R8 pixels.");
+	}
+	const bool gray = format == PixelFormat::R8;
+
+	auto root = tensorflow::Scope::NewRootScope();
+	using namespace ::tensorflow::ops;
+
+	const std::string outputName = "decoded";
+	auto fileReader = ReadFile(root.WithOpName("file_reader"), path);
+	DecodeJpeg(root.WithOpName(outputName), fileReader, DecodeJpeg::Channels(gray ? 1 : 3));
+
+	GraphDef graph;
+	TF_RETURN_IF_ERROR(root.ToGraphDef(&graph));
+
+	std::vector<Tensor> outputs;
+	std::unique_ptr<tensorflow::Session> session(tensorflow::NewSession(tensorflow::SessionOptions()));
+	TF_RETURN_IF_ERROR(session->Create(graph));
+	TF_RETURN_IF_ERROR(session->Run({}, { outputName }, {}, &outputs));
+
+	// The decoded image is `[height, width, channels]`, with its rows top-down.
+	const Tensor& image = outputs[0];
+	*height = static_cast<int>(image.dim_size(0));
+	*width = static_cast<int>(image.dim_size(1));
+	const size_t count = static_cast<size_t>(*width) * *height;
+	const uint8_t* decoded = image.flat<uint8_t>().data();
+
+	if (gray)
+	{
+		pixels->assign(decoded, decoded + count);
+		return Status::OK();
+	}
+
+	pixels->resize(count * 4);
+	for (size_t i = 0; i < count; ++i)
+	{
+		(*pixels)[i * 4 + 0] = decoded[i * 3 + 2];
+		(*pixels)[i * 4 + 1] = decoded[i * 3 + 1];
+		(*pixels)[i * 4 + 2] = decoded[i * 3 + 0];
+		(*pixels)[i * 4 + 3] = 255;
+	}
+	return Status::OK();
+}
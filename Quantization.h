@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "PixelConversion.h"
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+
+// Rewrites a frozen float graph with the `graph_transforms` tool so that convolutions and matrix
+// multiplies run as `QuantizedConv2D` / `QuantizedMatMul` (backed by gemmlowp) on the CPU. The input
+// is pinned to `inputShape` (in the model's own layout) and `inputType`.
+tensorflow::Status quantizeGraph(const tensorflow::GraphDef& floatGraph,
+								 const std::string& inputLayer,
+								 const std::string& outputLayer,
+								 const tensorflow::TensorShape& inputShape,
+								 tensorflow::DataType inputType,
+								 tensorflow::GraphDef* quantizedGraph);
+
+// Runs the quantized graph over a set of sample inputs and records the range observed at every
+// `RequantizationRange` node. The ranges are written to `logPath` in the same format that the
+// `freeze_requantization_ranges` transform expects, so that they can be baked into the graph.
+tensorflow::Status calibrateRequantizationRanges(const tensorflow::GraphDef& quantizedGraph,
+												 const std::string& inputLayer,
+												 const std::vector<tensorflow::Tensor>& samples,
+												 const std::string& logPath);
+
+// Replaces the dynamic `RequantizationRange` ops in the graph with the constants stored in `logPath`.
+tensorflow::Status freezeRequantizationRanges(const std::string& logPath, tensorflow::GraphDef* quantizedGraph);
+
+// Returns a quantized version of `floatGraph`, which was read from `graphPath`. Its ranges are
+// calibrated on `calibrationImages`, converted for `input` at `inputHeight` x `inputWidth` exactly as
+// the TOP's input is. The quantized graph and its calibrated ranges are cached next to the original
+// model (`<model>.quantized.pb` and `<model>.minmax.txt`), along with the settings they were built
+// for (`<model>.quantized.txt`: the layers, the input's shape, type, channel order and normalization,
+// and the calibration images). The cache is reused for as long as it is newer than the float graph
+// and was built for the same settings.
+tensorflow::Status loadQuantizedGraph(const std::string& graphPath,
+									  const tensorflow::GraphDef& floatGraph,
+									  const std::vector<std::string>& calibrationImages,
+									  const std::string& inputLayer,
+									  const std::string& outputLayer,
+									  const InputFormat& input,
+									  int inputHeight,
+									  int inputWidth,
+									  tensorflow::GraphDef* quantizedGraph);
+
+// Returns the paths of all of the JPEG images in `folder`.
+std::vector<std::string> listImageFiles(const std::string& folder);
+
+// Picks the images to calibrate on and the ones to evaluate on. Folders that differ are used as they
+// are. If they're the same folder, its images are split, with every other one held out for
+// evaluation, so that agreement is never measured on the images the ranges were calibrated on.
+void splitImageFiles(const std::string& calibrationFolder,
+					 const std::string& evaluationFolder,
+					 std::vector<std::string>* calibrationImages,
+					 std::vector<std::string>* evaluationImages);
+
+// Decodes the images at `paths` and converts them into `[1, ...]` tensors of the model's input, with
+// the same kernels as the TOP's input. Images that can't be read are skipped.
+std::vector<tensorflow::Tensor> readSamples(const std::vector<std::string>& paths, const InputFormat& input, int height, int width);
+
+// Decodes a JPEG image from disk into `BGRA8` or `R8` pixels, as the TOP downloads them, so that they
+// can go through the same conversion as its input.
+tensorflow::Status readPixelsFromImageFile(const std::string& path,
+										   PixelFormat format,
+										   std::vector<uint8_t>* pixels,
+										   int* width,
+										   int* height);
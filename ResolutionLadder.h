@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Picks the input resolution of a fully convolutional model from a fixed set of rungs (e.g. 224,
+// 299 and 384) based on how long inference takes compared to a budget. The cost of a convolutional
+// network scales roughly with the number of input pixels, which is used to predict whether the
+// next rung up would still fit.
+//
+// Like the frame governor, the ladder only moves after several consecutive measurements agree, and
+// only steps up when the prediction leaves some headroom, so that it doesn't oscillate.
+class ResolutionLadder
+{
+public:
+	ResolutionLadder() :
+		index(0),
+		averageMs(0.0),
+		overBudgetRuns(0),
+		underBudgetRuns(0),
+		hasSample(false)
+	{
+	}
+
+	// Parses a whitespace or comma separated list of resolutions, returning true if the ladder changed.
+	// The ladder starts at its highest rung.
+	bool configure(const std::string& description)
+	{
+		if (description == currentDescription)
+		{
+			return false;
+		}
+		currentDescription = description;
+
+		std::string normalized = description;
+		std::replace(normalized.begin(), normalized.end(), ',', ' ');
+
+		std::istringstream stream(normalized);
+		std::vector<int> parsed;
+		int resolution;
+		while (stream >> resolution)
+		{
+			if (resolution > 0)
+			{
+				parsed.push_back(resolution);
+			}
+		}
+		std::sort(parsed.begin(), parsed.end());
+		parsed.erase(std::unique(parsed.begin(), parsed.end()), parsed.end());
+
+		ladder = parsed;
+		index = ladder.empty() ? 0 : ladder.size() - 1;
+		hasSample = false;
+		overBudgetRuns = 0;
+		underBudgetRuns = 0;
+
+		return true;
+	}
+
+	const std::vector<int>& rungs() const
+	{
+		return ladder;
+	}
+
+	bool empty() const
+	{
+		return ladder.empty();
+	}
+
+	// The resolution that the next inference should run at.
+	int current() const
+	{
+		return ladder[index];
+	}
+
+	// Records how long an inference at `current()` took.
+	void record(double inferenceMs, double budgetMs)
+	{
+		averageMs = hasSample ? averageMs + (inferenceMs - averageMs) * smoothing : inferenceMs;
+		hasSample = true;
+
+		if (averageMs > budgetMs && index > 0)
+		{
+			underBudgetRuns = 0;
+			if (++overBudgetRuns >= hysteresisRuns)
+			{
+				step(-1);
+			}
+		}
+		else if (index + 1 < ladder.size() && predictedMs(index + 1) < budgetMs * headroom)
+		{
+			overBudgetRuns = 0;
+			if (++underBudgetRuns >= hysteresisRuns)
+			{
+				step(1);
+			}
+		}
+		else
+		{
+			overBudgetRuns = 0;
+			underBudgetRuns = 0;
+		}
+	}
+
+private:
+	double predictedMs(size_t rung) const
+	{
+		const double ratio = static_cast<double>(ladder[rung]) / ladder[index];
+		return averageMs * ratio * ratio;
+	}
+
+	void step(int direction)
+	{
+		// Carry the estimate over to the new rung, so that the next decision doesn't wait for a fresh average.
+		const size_t next = direction > 0 ? index + 1 : index - 1;
+		averageMs = predictedMs(next);
+		index = next;
+		overBudgetRuns = 0;
+		underBudgetRuns = 0;
+	}
+
+	static constexpr double smoothing = 0.2;
+	static constexpr double headroom = 0.8;
+	static constexpr int hysteresisRuns = 5;
+
+	std::string currentDescription;
+	std::vector<int> ladder;
+	size_t index;
+	double averageMs;
+	int overBudgetRuns;
+	int underBudgetRuns;
+	bool hasSample;
+};
@@ -38,4 +38,76 @@ layout(location = 0) out vec4 o_color;
 void main()									
 {												
 	o_color = texture(u_input, fs_in.uv);			
-})";
\ No newline at end of file
+})";
+
+// Draws a model's output (see `TensorTexture`) at the TOP's resolution. The texture unit's bilinear
+// filtering does the upscaling, after which values are scaled and optionally mapped to colors.
+static const char* outputFragShaderSrc =
+R"(#version 430 core	
+		
+layout(binding = 0) uniform sampler2D u_output;
+
+layout(location = 0) uniform int u_colormap;	// 0: channels as colors, 1: heat, 2: class palette
+layout(location = 1) uniform float u_gain;
+layout(location = 2) uniform float u_offset;
+layout(location = 3) uniform int u_channels;
+		
+in VS_OUT 
+{
+	vec2 uv;
+} fs_in;
+
+layout(location = 0) out vec4 o_color;		
+
+vec3 heat(float t)
+{
+	t = clamp(t, 0.0, 1.0);
+	return clamp(vec3(3.0 * t, 3.0 * t - 1.0, 3.0 * t - 2.0), 0.0, 1.0);
+}
+
+vec3 classColor(float index)
+{
+	// Class 0 is usually the background.
+	if (index < 0.5)
+	{
+		return vec3(0.0);
+	}
+	return fract(sin(vec3(index) * vec3(12.9898, 78.233, 37.719)) * 43758.5453) * 0.75 + 0.25;
+}
+						
+void main()									
+{
+	// Tensors are stored top-down.
+	vec2 uv = vec2(fs_in.uv.x, 1.0 - fs_in.uv.y);
+
+	if (u_colormap == 2)
+	{
+		// Class indices must not be interpolated.
+		ivec2 size = textureSize(u_output, 0);
+		ivec2 texel = clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1);
+		o_color = vec4(classColor(texelFetch(u_output, texel, 0).r), 1.0);
+		return;
+	}
+
+	vec4 value = texture(u_output, uv) * u_gain + u_offset;
+	if (u_colormap == 1)
+	{
+		o_color = vec4(heat(value.r), 1.0);
+	}
+	else if (u_channels == 1)
+	{
+		o_color = vec4(value.rrr, 1.0);
+	}
+	else if (u_channels == 2)
+	{
+		o_color = vec4(value.rg, 0.0, 1.0);
+	}
+	else if (u_channels == 3)
+	{
+		o_color = vec4(value.rgb, 1.0);
+	}
+	else
+	{
+		o_color = value;
+	}
+})";
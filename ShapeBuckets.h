@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Where the input image is placed inside a bucket: everything outside of this rectangle is padding.
+struct Letterbox
+{
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+};
+
+// Quantizes the input size of a model with dynamic spatial dimensions to a small, fixed set of
+// buckets (e.g. 320x180, 640x360 and 1280x720). The first run at a new input shape is expensive
+// (buffers are allocated and kernels set up for it), so if the input were fed at its own size, every
+// resolution change would cause a spike. With buckets, each shape is only ever set up once and the
+// input is letterboxed into the bucket that fits it best.
+class ShapeBuckets
+{
+public:
+	// Width, height.
+	using Size = std::pair<int, int>;
+
+	// Parses a whitespace or comma separated list of `<width>x<height>` sizes, returning true if the
+	// buckets changed.
+	bool configure(const std::string& description)
+	{
+		if (description == currentDescription)
+		{
+			return false;
+		}
+		currentDescription = description;
+
+		std::string normalized = description;
+		std::replace(normalized.begin(), normalized.end(), ',', ' ');
+
+		std::istringstream stream(normalized);
+		std::vector<Size> parsed;
+		std::string token;
+		while (stream >> token)
+		{
+			int width;
+			int height;
+			if (std::sscanf(token.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+			{
+				parsed.push_back({ width, height });
+			}
+		}
+
+		// Smallest first, so that `select()` prefers the cheapest bucket that fits.
+		std::sort(parsed.begin(), parsed.end(), [](const Size& a, const Size& b)
+		{
+			return area(a) < area(b) || (area(a) == area(b) && a < b);
+		});
+		parsed.erase(std::unique(parsed.begin(), parsed.end()), parsed.end());
+		buckets = parsed;
+
+		return true;
+	}
+
+	const std::vector<Size>& sizes() const
+	{
+		return buckets;
+	}
+
+	bool empty() const
+	{
+		return buckets.empty();
+	}
+
+	// Returns the smallest bucket that holds an input of the given size without scaling it. If the
+	// input is larger than all of the buckets, it will be scaled down, so the bucket that keeps the
+	// most of its pixels is returned instead.
+	Size select(int width, int height) const
+	{
+		for (const auto& bucket : buckets)
+		{
+			if (bucket.first >= width && bucket.second >= height)
+			{
+				return bucket;
+			}
+		}
+
+		Size best = buckets.front();
+		int bestArea = -1;
+		for (const auto& bucket : buckets)
+		{
+			const Letterbox box = fit(width, height, bucket);
+			if (box.width * box.height > bestArea)
+			{
+				best = bucket;
+				bestArea = box.width * box.height;
+			}
+		}
+		return best;
+	}
+
+	// Centers an input of the given size in `bucket`, scaling it down (preserving its aspect ratio)
+	// if it doesn't fit. Inputs are never scaled up: the remaining space is padded instead.
+	static Letterbox fit(int width, int height, const Size& bucket)
+	{
+		const float scale = std::min(1.0f, std::min(static_cast<float>(bucket.first) / width, static_cast<float>(bucket.second) / height));
+
+		Letterbox box;
+		box.width = std::max(1, std::min(bucket.first, static_cast<int>(std::lround(width * scale))));
+		box.height = std::max(1, std::min(bucket.second, static_cast<int>(std::lround(height * scale))));
+		box.x = (bucket.first - box.width) / 2;
+		box.y = (bucket.second - box.height) / 2;
+		return box;
+	}
+
+private:
+	static int area(const Size& size)
+	{
+		return size.first * size.second;
+	}
+
+	std::string currentDescription;
+	std::vector<Size> buckets;
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+// A lock-free, bounded, single-producer / single-consumer queue of pointers (e.g. frames holding
+// tensors). Neither side ever waits on a lock, so it is safe to push from TouchDesigner's cook thread.
+//
+// With the `OverwriteOldest` policy, a push into a full queue evicts the oldest item instead of
+// failing, so that a slow consumer always sees the most recent frames ("latest wins"). Because the
+// consumer may be claiming the very same item at that moment, both sides advance the read position
+// with a compare-and-swap: whoever wins owns the item.
+template <typename T>
+class SpscQueue
+{
+public:
+	enum class Policy
+	{
+		// A push into a full queue fails and the caller keeps the new item.
+		RejectNewest,
+
+		// A push into a full queue evicts (and hands back) the oldest item.
+		OverwriteOldest
+	};
+
+	explicit SpscQueue(size_t capacity, Policy policy = Policy::RejectNewest) :
+		slots(new std::atomic<T*>[capacity]),
+		capacity(capacity),
+		policy(policy),
+		head(0),
+		tail(0),
+		overwritten(0),
+		rejected(0)
+	{
+		for (size_t i = 0; i < capacity; ++i)
+		{
+			slots[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	// Producer only. Returns false if the queue was full and the item was rejected. With the
+	// `OverwriteOldest` policy, the evicted item (if any) is returned through `evicted` so that the
+	// caller can recycle it.
+	bool push(T* item, T** evicted = nullptr)
+	{
+		if (evicted)
+		{
+			*evicted = nullptr;
+		}
+
+		const uint64_t writeIndex = head.load(std::memory_order_relaxed);
+		uint64_t readIndex = tail.load(std::memory_order_acquire);
+
+		if (writeIndex - readIndex >= capacity)
+		{
+			if (policy == Policy::RejectNewest)
+			{
+				rejected.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			assert(evicted != nullptr);
+
+			// If the CAS fails, the consumer has just taken the oldest item, which frees a slot just as well.
+			T* oldest = slots[readIndex % capacity].load(std::memory_order_relaxed);
+			if (tail.compare_exchange_strong(readIndex, readIndex + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				*evicted = oldest;
+				overwritten.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		slots[writeIndex % capacity].store(item, std::memory_order_relaxed);
+		head.store(writeIndex + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// Consumer only. Returns false if the queue is empty.
+	bool pop(T** item)
+	{
+		uint64_t readIndex = tail.load(std::memory_order_acquire);
+		while (true)
+		{
+			if (readIndex == head.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			// Read the slot before claiming it: once the tail moves past it, the producer may reuse it.
+			T* candidate = slots[readIndex % capacity].load(std::memory_order_relaxed);
+			if (tail.compare_exchange_weak(readIndex, readIndex + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				*item = candidate;
+				return true;
+			}
+
+			// The producer evicted the item we were about to take (or the CAS failed spuriously), so
+			// `readIndex` now holds the current tail: try again.
+		}
+	}
+
+	bool empty() const
+	{
+		return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+	}
+
+	// Approximate when called while the other side is active.
+	size_t size() const
+	{
+		const uint64_t readIndex = tail.load(std::memory_order_acquire);
+		return static_cast<size_t>(head.load(std::memory_order_acquire) - readIndex);
+	}
+
+	// The number of items evicted by the `OverwriteOldest` policy.
+	uint64_t overwrittenCount() const
+	{
+		return overwritten.load(std::memory_order_relaxed);
+	}
+
+	// The number of pushes that failed under the `RejectNewest` policy.
+	uint64_t rejectedCount() const
+	{
+		return rejected.load(std::memory_order_relaxed);
+	}
+
+private:
+	static const size_t cacheLineSize = 64;
+
+	std::unique_ptr<std::atomic<T*>[]> slots;
+	const size_t capacity;
+	const Policy policy;
+
+	// The indices are padded onto their own cache lines so that the producer and the consumer don't
+	// invalidate each other's cache on every operation. Padding (rather than `alignas`) still works
+	// when the queue itself is heap allocated without over-aligned `new`.
+	char pad0[cacheLineSize];
+	std::atomic<uint64_t> head;
+	char pad1[cacheLineSize - sizeof(std::atomic<uint64_t>)];
+	std::atomic<uint64_t> tail;
+	char pad2[cacheLineSize - sizeof(std::atomic<uint64_t>)];
+	std::atomic<uint64_t> overwritten;
+	std::atomic<uint64_t> rejected;
+	char pad3[cacheLineSize - 2 * sizeof(std::atomic<uint64_t>)];
+};
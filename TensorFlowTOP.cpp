@@ -10,13 +10,176 @@
 
 #include "TensorFlowTOP.h"
 
+namespace
+{
+	double millisecondsSince(PipelineClock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(PipelineClock::now() - start).count();
+	}
+
+	bool isEightBitFormat(GLint pixelFormat)
+	{
+		switch (pixelFormat)
+		{
+		case GL_R8:
+		case GL_RG8:
+		case GL_RGB8:
+		case GL_RGBA8:
+		case GL_SRGB8:
+		case GL_SRGB8_ALPHA8:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// The toggles that choose how the model runs. Each path through `cookModel()` only applies some of
+	// them, and the ones that are on but don't apply are named in the node's warning.
+	struct ModeToggle
+	{
+		const char* name;
+		const char* label;
+	};
+
+	const ModeToggle modeToggles[] =
+	{
+		{ "Governor", "Frame Budget Governor" },
+		{ "Tiled", "Tiled" },
+		{ "Detect", "Detect Boxes" },
+		{ "Keyframes", "Track Between Keyframes" },
+		{ "Augment", "Test-Time Augmentation" },
+		{ "Pyramid", "Pyramid" },
+		{ "Batchinputs", "Batch Inputs" },
+		{ "Cascade", "Cascade" },
+		{ "Shapebuckets", "Shape Buckets" },
+		{ "Adaptiveresolution", "Adaptive Resolution" }
+	};
+
+	bool isLayeredTexture(const OP_TOPInput* topInput)
+	{
+		return topInput->textureType == GL_TEXTURE_2D_ARRAY || topInput->textureType == GL_TEXTURE_3D;
+	}
+
+	OP_CPUMemPixelType toCpuMemPixelType(PixelFormat format)
+	{
+		switch (format)
+		{
+		case PixelFormat::RGBA32F:
+			return OP_CPUMemPixelType::RGBA32Float;
+		case PixelFormat::R8:
+			return OP_CPUMemPixelType::R8Fixed;
+		case PixelFormat::R32F:
+			return OP_CPUMemPixelType::R32Float;
+		default:
+			return OP_CPUMemPixelType::BGRA8Fixed;
+		}
+	}
+
+	// Reads the input's type, layout and channel count from its placeholder, which tells us which
+	// pixel format to download (models that take 8-bit input don't need float pixels, and
+	// single-channel models don't need color) and how to lay it out.
+	void readInputFormat(const tensorflow::GraphDef& graph, const std::string& inputName, InputFormat* format)
+	{
+		format->type = tensorflow::DT_FLOAT;
+		format->layout = TensorLayout::NHWC;
+		format->channels = 3;
+		for (const auto& node : graph.node())
+		{
+			if (node.name() != inputName)
+			{
+				continue;
+			}
+
+			const auto& attributes = node.attr();
+			auto type = attributes.find("dtype");
+			if (type == attributes.end())
+			{
+				type = attributes.find("T");
+			}
+			if (type != attributes.end() && (type->second.type() == tensorflow::DT_FLOAT || type->second.type() == tensorflow::DT_UINT8))
+			{
+				format->type = type->second.type();
+			}
+
+			// A small second dimension next to a large (or unknown) last one means planar channels.
+			const auto shape = attributes.find("shape");
+			if (shape != attributes.end() && shape->second.shape().dim_size() == 4)
+			{
+				const auto second = shape->second.shape().dim(1).size();
+				const auto last = shape->second.shape().dim(3).size();
+				if (second >= 1 && second <= 4 && (last < 1 || last > 4))
+				{
+					format->layout = TensorLayout::NCHW;
+					format->channels = static_cast<int>(second);
+				}
+				else if (last >= 1 && last <= 4)
+				{
+					format->channels = static_cast<int>(last);
+				}
+			}
+			break;
+		}
+	}
+
+	// Nodes that are added to every loaded graph to combine the scores of several crops of each image
+	// in the same run. The model's `[images * crops, classes]` output is reshaped to the fed
+	// `[images, crops, -1]` shape and reduced over the crops, so only one result per image is fetched.
+	const char* cropShapeNode = "touchdesigner_crop_shape";
+	const char* cropMeanNode = "touchdesigner_crop_mean";
+	const char* cropMaxNode = "touchdesigner_crop_max";
+
+	Status cropAggregationGraph(const std::string& scores, tensorflow::GraphDef* graph)
+	{
+		auto root = tensorflow::Scope::NewRootScope();
+		using namespace ::tensorflow::ops;
+
+		// The scores are a stand-in, which is wired to the model's output below.
+		const std::string standIn = "touchdesigner_crop_scores";
+		auto scoresInput = Placeholder(root.WithOpName(standIn), tensorflow::DT_FLOAT);
+		auto shape = Placeholder(root.WithOpName(cropShapeNode), tensorflow::DT_INT32);
+		auto crops = Reshape(root.WithOpName("touchdesigner_crops"), scoresInput, shape);
+		auto axis = Const(root.WithOpName("touchdesigner_crop_axis"), 1);
+		Mean(root.WithOpName(cropMeanNode), crops, axis);
+		Max(root.WithOpName(cropMaxNode), crops, axis);
+
+		tensorflow::GraphDef built;
+		TF_RETURN_IF_ERROR(root.ToGraphDef(&built));
+
+		graph->Clear();
+		for (const auto& node : built.node())
+		{
+			if (node.name() == standIn)
+			{
+				continue;
+			}
+
+			auto* added = graph->add_node();
+			*added = node;
+			for (int i = 0; i < added->input_size(); ++i)
+			{
+				if (added->input(i) == standIn)
+				{
+					added->set_input(i, scores);
+				}
+			}
+		}
+		return Status::OK();
+	}
+}
+
 extern "C"
 {
 	DLLEXPORT TOP_PluginInfo GetTOPPluginInfo(void)
 	{
 		TOP_PluginInfo info;
 		info.apiVersion = TOPCPlusPlusAPIVersion;
+#ifdef TENSORFLOW_TOP_CPU_OUTPUT
+		// All of the work happens on the CPU, so the output is written to CPU memory as well, which
+		// avoids switching GL contexts altogether.
+		info.executeMode = TOP_ExecuteMode::CPUMemWriteOnly;
+#else
 		info.executeMode = TOP_ExecuteMode::OpenGL_FBO;
+#endif
 		return info;
 	}
 
@@ -27,186 +190,296 @@ extern "C"
 
 	DLLEXPORT void DestroyTOPInstance(TOP_CPlusPlusBase* instance, TOP_Context *context)
 	{
+#ifdef TENSORFLOW_TOP_CPU_OUTPUT
 		delete (TensorFlowTOP*)instance;
+#else
+		// The destructor releases GL objects, so it needs our GL context to be current.
+		context->beginGLCommands();
+		delete (TensorFlowTOP*)instance;
+		context->endGLCommands();
+#endif
 	}
 };
 
-Status TensorFlowTOP::convertPixelsToTensor(std::vector<Tensor>* out_tensors,
-											uint8_t* pixels,
+Status TensorFlowTOP::convertPixelsToTensor(Tensor* out_tensor,
+											const void* pixels,
 											int pixels_width, 
 											int pixels_height, 
-											int pixels_channels,
-											const int expected_height, 
-											const int expected_width, 
-											const int expected_channels,
-											const float expected_mean,
-											const float expected_standard_dev) 
+											PixelFormat pixels_format) 
 {
-	auto root = tensorflow::Scope::NewRootScope();
-	using namespace ::tensorflow::ops; 
+	// The image covers the whole tensor.
+	Letterbox region;
+	region.width = static_cast<int>(out_tensor->dim_size(2));
+	region.height = static_cast<int>(out_tensor->dim_size(1));
 
-	// Create the input tensor.
-	tensorflow::Tensor input_tensor(tensorflow::DT_FLOAT, tensorflow::TensorShape({pixels_height, pixels_width, expected_channels}));
-	auto input_tensor_mapped = input_tensor.tensor<float, 3>();
+	return letterboxPixelsToTensor(out_tensor, region, pixels, pixels_width, pixels_height, pixels_format);
+}
+
+Status TensorFlowTOP::letterboxPixelsToTensor(Tensor* out_tensor,
+											  const Letterbox& region,
+											  const void* pixels,
+											  int pixels_width, 
+											  int pixels_height, 
+											  PixelFormat pixels_format) 
+{
+	// The destination is a persistent input tensor, which we resize and normalize into directly (this
+	// replaces a per-frame Cast / ResizeBilinear / Sub / Div graph and its copies). The kernel is
+	// specialized for the downloaded pixel format and the model's input, and was picked at load time.
+	return converter.convert(pixels, pixels_width, pixels_height, pixels_format, region, out_tensor);
+}
 
-	// Copying the pixel data into the tensor.
-	for (int y = 0; y < pixels_height; ++y) 
+PixelFormat TensorFlowTOP::downloadFormat(const OP_TOPInput* topInput) const
+{
+	// 8-bit sources gain nothing from a float download (and take four times the bandwidth), and
+	// 8-bit models can't use the extra range either.
+	const bool floatPixels = modelInput.type == tensorflow::DT_FLOAT && !isEightBitFormat(topInput->pixelFormat);
+	if (modelInput.channels == 1)
 	{
-		const uint8_t* source_row = pixels + (y * pixels_width * pixels_channels);
-		for (int x = 0; x < pixels_width; ++x) 
-		{
-			const uint8_t* source_pixel = source_row + (x * pixels_channels);
+		return floatPixels ? PixelFormat::R32F : PixelFormat::R8;
+	}
+	return floatPixels ? PixelFormat::RGBA32F : PixelFormat::BGRA8;
+}
 
-			// OpenGL texture data is read as BGRA, so we want to 
-			// ignore the alpha channel and reorder the other 3
-			// color channels
-			for (int c = 0; c < expected_channels; ++c)
-			{
-				const uint8_t* source_value = source_pixel + ((expected_channels - 1) - c);
-				float pixel = static_cast<float>(*source_value);
+void TensorFlowTOP::loadModel(const std::string& graphPath, bool quantize, const std::string& calibrationFolder, const std::string& evaluationFolder)
+{
+	modelPath = graphPath;
+	modelQuantized = quantize;
+	modelCalibrationFolder = calibrationFolder;
+	modelEvaluationFolder = evaluationFolder;
+	modelError = nullptr;
+	cropAggregationInGraph = false;
+	session.reset();
+	cascade.reset();
+	warmedShapes.clear();
 
-				input_tensor_mapped(y, x, c) = pixel;
-			}
-		}
+	std::cout << "Attempting to load graph file...\n";
+
+	tensorflow::GraphDef graphDefinition;
+	if (!ReadBinaryProto(tensorflow::Env::Default(), graphPath, &graphDefinition).ok()) 
+	{
+		modelError = "Failed to read .pb file - check that the path and file format are correct.";
+		return;
 	}
 
-	const std::string output_name = "normalized";
-	auto float_caster = Cast(root.WithOpName("float_caster"), input_tensor, tensorflow::DT_FLOAT);
-	auto dims_expander = ExpandDims(root, float_caster, 0);
-	auto resized = ResizeBilinear(root, dims_expander, Const(root.WithOpName("size"), {expected_height, expected_width}));
-	Div(root.WithOpName(output_name), Sub(root, resized, {expected_mean}), {expected_standard_dev});
+	// The input's format decides how calibration images are converted (and which shape the quantized
+	// graph is pinned to), so it's read from the float graph first.
+	readInputFormat(graphDefinition, inputLayer, &modelInput);
+	converter.select(modelInput);
+	std::cout << "Model input: " << tensorflow::DataTypeString(modelInput.type) << " with " << modelInput.channels << " channel(s), "
+			  << (modelInput.layout == TensorLayout::NCHW ? "NCHW" : "NHWC") << "\n";
 
-	// Run the graph.
-	tensorflow::GraphDef graph;
-	TF_RETURN_IF_ERROR(root.ToGraphDef(&graph));
+	if (quantize)
+	{
+		std::vector<std::string> calibrationImages;
+		std::vector<std::string> evaluationImages;
+		splitImageFiles(calibrationFolder, evaluationFolder, &calibrationImages, &evaluationImages);
 
-	std::unique_ptr<tensorflow::Session> session(tensorflow::NewSession(tensorflow::SessionOptions()));
-	TF_RETURN_IF_ERROR(session->Create(graph));
-	TF_RETURN_IF_ERROR(session->Run({}, {output_name}, {}, out_tensors));
+		tensorflow::GraphDef quantizedGraph;
+		if (!loadQuantizedGraph(graphPath, graphDefinition, calibrationImages, inputLayer, outputLayer, modelInput, expectedDims, expectedDims, &quantizedGraph).ok())
+		{
+			modelError = "Failed to quantize the graph.";
+			return;
+		}
+		graphDefinition.Swap(&quantizedGraph);
+	}
 	
-	return Status::OK();
-}
+	std::cout << "Attempting to start session...\n";
 
-GLuint TensorFlowTOP::createGlslProgram(const std::string& vertSrc, const std::string& fragSrc)
-{
-	// Vertex shader
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	const char* vertSrcPtr = vertSrc.c_str();
-	glShaderSource(vertexShader, 1, &vertSrcPtr, nullptr);
-	glCompileShader(vertexShader);
+	tensorflow::SessionOptions options;
+	options.config.mutable_gpu_options()->set_allow_growth(true);
+
+	(&session)->reset(tensorflow::NewSession(options));
 
-	// Check for compile time errors
-	GLint success;
-	GLchar infoLog[512];
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-	if (!success)
+	if (!session->Create(graphDefinition).ok()) 
 	{
-		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-		std::cout << "Error compiling vertex shader:\n" << infoLog << std::endl;
+		modelError = "Failed to create graph from .pb file.";
+		session.reset();
+		return;
 	}
 
-	// Fragment shader
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	const char* fragSrcPtr = fragSrc.c_str();
-	glShaderSource(fragmentShader, 1, &fragSrcPtr, NULL);
-	glCompileShader(fragmentShader);
-
-	// Check for compile time errors
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-	if (!success)
+	// If the graph can't be extended, crops are combined on the CPU instead. An extension has to carry
+	// the same versions as the graph it extends.
+	tensorflow::GraphDef aggregation;
+	cropAggregationInGraph = cropAggregationGraph(outputLayer, &aggregation).ok();
+	if (cropAggregationInGraph)
 	{
-		glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-		std::cout << "Error compiling fragment shader:\n" << infoLog << std::endl;
+		*aggregation.mutable_versions() = graphDefinition.versions();
+		cropAggregationInGraph = session->Extend(aggregation).ok();
 	}
+	std::cout << "Crop aggregation: " << (cropAggregationInGraph ? "in graph" : "on the CPU") << "\n";
+}
 
-	// Link shaders
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
-	glLinkProgram(program);
+void TensorFlowTOP::loadAuxiliaryModel(const std::string& graphPath, const std::string& inputName, const std::string& description, AuxiliaryModel* model)
+{
+	model->path = graphPath;
+	model->inputLayer = inputName;
+	model->session.reset();
+	model->loadError.clear();
+	if (graphPath.empty())
+	{
+		return;
+	}
 
-	// Check for linking errors
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-	if (!success) 
+	tensorflow::GraphDef graphDefinition;
+	if (!ReadBinaryProto(tensorflow::Env::Default(), graphPath, &graphDefinition).ok())
 	{
-		glGetProgramInfoLog(program, 512, NULL, infoLog);
-		std::cout << "Error linking program:\n" << infoLog << std::endl;
+		model->loadError = "Failed to read the " + description + "'s .pb file - check that the path and file format are correct.";
+		return;
 	}
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	// Channel order and normalization are shared with the main model.
+	model->input = modelInput;
+	readInputFormat(graphDefinition, inputName, &model->input);
+	model->converter.select(model->input);
+	std::cout << description << " input: " << tensorflow::DataTypeString(model->input.type) << " with " << model->input.channels << " channel(s), "
+			  << (model->input.layout == TensorLayout::NCHW ? "NCHW" : "NHWC") << "\n";
 
-	return program;
+	tensorflow::SessionOptions options;
+	options.config.mutable_gpu_options()->set_allow_growth(true);
+	model->session.reset(tensorflow::NewSession(options));
+	if (!model->session->Create(graphDefinition).ok())
+	{
+		model->loadError = "Failed to create graph from the " + description + "'s .pb file.";
+		model->session.reset();
+	}
 }
 
-void TensorFlowTOP::loadModel(const std::string& graphPath)
+void TensorFlowTOP::evaluateQuantization(const std::string& calibrationFolder, const std::string& evaluationFolder)
 {
-	std::cout << "Attempting to load graph file...\n";
+	infoEntries.clear();
 
-	tensorflow::GraphDef graphDefinition;
-	if (!ReadBinaryProto(tensorflow::Env::Default(), graphPath, &graphDefinition).ok()) 
+	// Agreement on the images the ranges were calibrated on would overstate the quantized graph's
+	// accuracy, so the two sets never overlap.
+	std::vector<std::string> calibrationImages;
+	std::vector<std::string> evaluationImages;
+	splitImageFiles(calibrationFolder, evaluationFolder, &calibrationImages, &evaluationImages);
+
+	tensorflow::GraphDef floatGraph;
+	tensorflow::GraphDef quantizedGraph;
+	if (!ReadBinaryProto(tensorflow::Env::Default(), modelPath, &floatGraph).ok() ||
+		!loadQuantizedGraph(modelPath, floatGraph, calibrationImages, inputLayer, outputLayer, modelInput, expectedDims, expectedDims, &quantizedGraph).ok())
 	{
-		error = "Failed to read .pb file - check that the path and file format are correct.";
+		error = "Failed to prepare float and quantized graphs for evaluation.";
+		return;
 	}
-	
-	// Print some information about this graph:
-	// `graphDefinition.node_size()` -> prints something like `1004`
-	for (size_t i = 0; i < 3; ++i)
+
+	// The images are converted like the TOP's input, so that they match the model's layout, channels,
+	// channel order, normalization and input type.
+	const std::vector<Tensor> samples = readSamples(evaluationImages, modelInput, expectedDims, expectedDims);
+
+	if (samples.empty())
+	{
+		error = "No evaluation images found - check the evaluation folder.";
+		return;
+	}
+
+	// Runs every sample through `graph`, returning the average latency and the top-1 class of each sample.
+	auto evaluate = [&](const tensorflow::GraphDef& graph, double* averageMs, std::vector<int>* top1) -> Status
 	{
-		auto node = graphDefinition.node(i);
-		std::cout << "Node at index " << i << " has name: " << node.name() << ", input size: " << node.input_size() << "\n";
-		for (const auto& pair : node.attr())
+		std::unique_ptr<tensorflow::Session> evaluationSession(tensorflow::NewSession(tensorflow::SessionOptions()));
+		TF_RETURN_IF_ERROR(evaluationSession->Create(graph));
+
+		// The first run pays for memory allocation and kernel setup, so keep it out of the timings.
+		std::vector<Tensor> outputs;
+		TF_RETURN_IF_ERROR(evaluationSession->Run({ { inputLayer, samples[0] } }, { outputLayer }, {}, &outputs));
+
+		double totalMs = 0.0;
+		for (const auto& sample : samples)
 		{
-			const auto& shape = pair.second.shape();
-			std::cout << "	" << pair.first << shape.DebugString() << "\n";
+			auto start = std::chrono::high_resolution_clock::now();
+			TF_RETURN_IF_ERROR(evaluationSession->Run({ { inputLayer, sample } }, { outputLayer }, {}, &outputs));
+			totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			Eigen::Map<Eigen::VectorXf> pred(outputs[0].flat<float>().data(), outputs[0].NumElements());
+			int maxIndex;
+			pred.maxCoeff(&maxIndex);
+			top1->push_back(maxIndex);
 		}
-	}
-	std::cout << "Attempting to start session...\n";
+		*averageMs = totalMs / samples.size();
 
-	tensorflow::SessionOptions options;
-	options.config.mutable_gpu_options()->set_allow_growth(true);
+		return Status::OK();
+	};
 
-	(&session)->reset(tensorflow::NewSession(options));
+	double floatMs;
+	double quantizedMs;
+	std::vector<int> floatTop1;
+	std::vector<int> quantizedTop1;
+	if (!evaluate(floatGraph, &floatMs, &floatTop1).ok() || !evaluate(quantizedGraph, &quantizedMs, &quantizedTop1).ok())
+	{
+		error = "Failed to run evaluation set.";
+		return;
+	}
 
-	if (!session->Create(graphDefinition).ok()) 
+	size_t agreements = 0;
+	for (size_t i = 0; i < samples.size(); ++i)
 	{
-		error = "Failed to create graph from .pb file.";
+		if (floatTop1[i] == quantizedTop1[i])
+		{
+			++agreements;
+		}
 	}
+	const float agreement = static_cast<float>(agreements) / samples.size();
+
+	// The serialized graph size is dominated by the weights, so it's a good proxy for the memory saved.
+	infoEntries.push_back({ "eval_images", std::to_string(samples.size()) });
+	infoEntries.push_back({ "float_latency_ms", std::to_string(floatMs) });
+	infoEntries.push_back({ "quantized_latency_ms", std::to_string(quantizedMs) });
+	infoEntries.push_back({ "float_model_bytes", std::to_string(floatGraph.ByteSizeLong()) });
+	infoEntries.push_back({ "quantized_model_bytes", std::to_string(quantizedGraph.ByteSizeLong()) });
+	infoEntries.push_back({ "top1_agreement", std::to_string(agreement) });
+
+	std::cout << "Float: " << floatMs << " ms, quantized: " << quantizedMs << " ms, top-1 agreement: " << agreement << "\n";
 }
 
-void TensorFlowTOP::allocateFbo()
+void TensorFlowTOP::allocateTextures(GLsizei width, GLsizei height) 
 {
-	glCreateFramebuffers(1, &fbo);
-	glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, inputTexture, 0);
+	// The previous input texture (and its framebuffer) go back to the pool, so that switching back to
+	// an earlier resolution reuses them instead of creating new ones.
+	textures.releaseTexture(inputTexture);
+	inputTexture = textures.acquireTexture(width, height, GL_RGBA8);
+	fbo = textures.framebufferFor(inputTexture);
 
 	if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 	{
 		error = "Framebuffer incomplete.";
 	}
-}
-
-void TensorFlowTOP::allocateTextures() 
-{
-	glCreateTextures(GL_TEXTURE_2D, 1, &inputTexture);
-	glTextureParameteri(inputTexture, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTextureParameteri(inputTexture, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glTextureParameteri(inputTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(inputTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTextureStorage2D(inputTexture, 1, GL_RGBA8, 1000, 1);
 
-	glCreateTextures(GL_TEXTURE_2D, 1, &outputTexture);
-	glTextureParameteri(outputTexture, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTextureParameteri(outputTexture, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glTextureParameteri(outputTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(outputTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTextureStorage2D(outputTexture, 1, GL_R8, 1000, 1);
+	// One texel per class, which doesn't depend on the input.
+	if (outputTexture == 0)
+	{
+		outputTexture = textures.acquireTexture(1000, 1, GL_R8);
+	}
 }
 
 TensorFlowTOP::TensorFlowTOP(const OP_NodeInfo* info, TOP_Context* context) :
 	runGraph(false),
+	error(nullptr),
+	modelError(nullptr),
 	inputWidth(1280),
-	inputHeight(720)
+	inputHeight(720),
+	inputLayer("Mul"),
+	outputLayer("softmax"),
+	expectedDims(299),
+	pipelineFormat(PixelFormat::BGRA8),
+	tileFormat(PixelFormat::BGRA8),
+	modelQuantized(false),
+	cropAggregationInGraph(false),
+	evaluatePending(false),
+	detectionBenchmarkPending(false),
+	batchChannels(0),
+	flowPropagation(false),
+	boxChannels(0),
+	framesSinceKeyframe(0),
+	trackingDetections(false),
+	trackConfidence(1.0f),
+	benchmarkPending(false),
+	imageOutput(false),
+	outputPending(false),
+	fbo(0),
+	inputTexture(0),
+	outputTexture(0)
 {
+#ifndef TENSORFLOW_TOP_CPU_OUTPUT
 #ifdef WIN32
 	static bool needGLEWInit = true;
 	if (needGLEWInit)
@@ -218,23 +491,50 @@ TensorFlowTOP::TensorFlowTOP(const OP_NodeInfo* info, TOP_Context* context) :
 	}
 #endif
 
-	program = createGlslProgram(vertShaderSrc, fragShaderSrc);
+	context->beginGLCommands();
+	{
+		// Every instance uses the same program, so only the first one (per launch) pays for building it.
+		const auto programStart = PipelineClock::now();
+		ProgramCache::Source programSource;
+		program = ProgramCache::get().acquire(vertShaderSrc, fragShaderSrc, &programSource);
+		setInfoChannel("program_setup_ms", static_cast<float>(millisecondsSince(programStart)));
+		setInfoChannel("program_source", static_cast<float>(programSource));
+		outputProgram = ProgramCache::get().acquire(vertShaderSrc, outputFragShaderSrc);
 
-	glCreateVertexArrays(1, &vao);
+		glCreateVertexArrays(1, &vao);
 
-	loadModel("C:/Users/michael.walczyk/Desktop/tensorflow_top/models/inception.pb");
-	allocateTextures();
-	allocateFbo();
+		allocateTextures(static_cast<GLsizei>(inputWidth), static_cast<GLsizei>(inputHeight));
+	}
+	context->endGLCommands();
+#endif
 }
 
 TensorFlowTOP::~TensorFlowTOP()
 {
+	pipeline.stop();
+
+#ifndef TENSORFLOW_TOP_CPU_OUTPUT
+	// `DestroyTOPInstance()` makes our GL context current, so everything we created can be released here.
+	tensorTexture.release(textures);
+	textures.clear();
+	glDeleteVertexArrays(1, &vao);
+	ProgramCache::get().release(program);
+	ProgramCache::get().release(outputProgram);
+#endif
 }
 
 void TensorFlowTOP::getGeneralInfo(TOP_GeneralInfo* ginfo)
 {
 	ginfo->cookEveryFrame = false;
 	ginfo->cookEveryFrameIfAsked = false;
+
+#ifdef TENSORFLOW_TOP_CPU_OUTPUT
+	ginfo->memPixelType = OP_CPUMemPixelType::BGRA8Fixed;
+
+	// A frame rendered after one cook is only handed over in the next one, so keep cooking while
+	// someone is looking at the output.
+	ginfo->cookEveryFrameIfAsked = true;
+#endif
 }
 
 bool TensorFlowTOP::getOutputFormat(TOP_OutputFormat* format)
@@ -246,19 +546,131 @@ bool TensorFlowTOP::getOutputFormat(TOP_OutputFormat* format)
 
 void TensorFlowTOP::execute(const TOP_OutputFormatSpecs* outputFormat, OP_Inputs* inputs, TOP_Context *context)
 {
-	auto topInput = inputs->getInputTOP(0);
-	if (topInput)
-	{	
-		if (inputWidth != topInput->width || inputHeight != topInput->height)
+	error = nullptr;
+	imageOutput = inputs->getParInt("Outputmode") == 1;
+
+#ifdef TENSORFLOW_TOP_CPU_OUTPUT
+	// The memory that the previous frame was rendered into is only valid until now.
+	cpuWriter.collect(outputFormat);
+
+	cookModel(inputs, context);
+
+	writeCpuOutput(outputFormat, inputs);
+#else
+	cookModel(inputs, context);
+
+	// The latest result is drawn on every cook, including the ones that didn't run the model.
+	if (imageOutput)
+	{
+		renderOutput(outputFormat, inputs, context);
+	}
+#endif
+}
+
+void TensorFlowTOP::cookModel(OP_Inputs* inputs, TOP_Context* context)
+{
+	const auto cookStart = PipelineClock::now();
+
+	// Quantizing the graph is a load-time operation, so reload whenever the model or the option changes.
+	const std::string path = inputs->getParFilePath("Modelpath");
+	const bool quantize = inputs->getParInt("Quantize") != 0;
+
+	// Channel order and normalization only change which conversion kernel runs.
+	const auto order = static_cast<ChannelOrder>(inputs->getParInt("Channelorder"));
+	const auto normalization = static_cast<Normalization>(inputs->getParInt("Normalization"));
+	const bool inputChanged = order != modelInput.order || normalization != modelInput.normalization;
+	if (inputChanged)
+	{
+		// The pipeline's preprocessing thread converts with the current kernels.
+		pipeline.stop();
+		modelInput.order = order;
+		modelInput.normalization = normalization;
+		converter.select(modelInput);
+		for (AuxiliaryModel* model : { &cascadeModel, &detectorModel })
+		{
+			model->input.order = order;
+			model->input.normalization = normalization;
+			model->converter.select(model->input);
+		}
+	}
+
+	// A quantized graph is also calibrated for the input's conversion and the calibration images
+	// (which depend on the evaluation folder when the two are split from the same one).
+	const std::string calibrationFolder = inputs->getParFilePath("Calibrationfolder");
+	const std::string evaluationFolder = inputs->getParFilePath("Evaluationfolder");
+	const bool recalibrate = quantize &&
+		(inputChanged || calibrationFolder != modelCalibrationFolder || evaluationFolder != modelEvaluationFolder);
+	if (path != modelPath || quantize != modelQuantized || recalibrate)
+	{
+		pipeline.stop();
+		loadModel(path, quantize, calibrationFolder, evaluationFolder);
+	}
+
+	// The cascade's small model and the detector are only loaded while they are in use.
+	const std::string cascadePath = inputs->getParInt("Cascade") != 0 ? inputs->getParFilePath("Cascademodel") : "";
+	const std::string cascadeInputName = inputs->getParString("Cascadeinput");
+	if (cascadePath != cascadeModel.path || cascadeInputName != cascadeModel.inputLayer)
+	{
+		cascade.reset();
+		loadAuxiliaryModel(cascadePath, cascadeInputName, "Cascade", &cascadeModel);
+	}
+
+	const std::string detectorPath = inputs->getParInt("Detect") != 0 ? inputs->getParFilePath("Detectormodel") : "";
+	const std::string detectorInputName = inputs->getParString("Detectorinput");
+	if (detectorPath != detectorModel.path || detectorInputName != detectorModel.inputLayer)
+	{
+		loadAuxiliaryModel(detectorPath, detectorInputName, "Detector", &detectorModel);
+	}
+
+	// A model that failed to load stays in error until it's loaded again. Everything else is only
+	// reported by the cook that ran into it.
+	if (modelError != nullptr)
+	{
+		error = modelError;
+	}
+	for (const AuxiliaryModel* model : { &cascadeModel, &detectorModel })
+	{
+		if (!model->loadError.empty())
 		{
-			allocateTextures();
-			inputWidth = topInput->width;
-			inputHeight = topInput->height;
+			error = model->loadError.c_str();
 		}
+	}
+
+	if (evaluatePending)
+	{
+		evaluatePending = false;
+		evaluateQuantization(calibrationFolder, evaluationFolder);
+	}
+
+	if (detectionBenchmarkPending)
+	{
+		detectionBenchmarkPending = false;
+		benchmarkDetections(static_cast<Suppression>(inputs->getParInt("Detectnms")), static_cast<float>(inputs->getParDouble("Detectoverlap")));
+	}
 
+	// Every path through the model sets the warning. Cooks that the governor skips keep the last one.
+	auto topInput = inputs->getInputTOP(0);
+	if (!topInput || !session)
+	{
+		warningMessage.clear();
+	}
+	if (topInput && session)
+	{	
+#ifndef TENSORFLOW_TOP_CPU_OUTPUT
 		// Draw the input texture into this TOP's FBO.
 		context->beginGLCommands();
 		{		
+			if (inputWidth != topInput->width || inputHeight != topInput->height)
+			{
+				allocateTextures(topInput->width, topInput->height);
+				inputWidth = topInput->width;
+				inputHeight = topInput->height;
+
+				// A resize that keeps creating new objects would show up here.
+				setInfoChannel("gl_textures", static_cast<float>(textures.textureCount()));
+				setInfoChannel("gl_framebuffers", static_cast<float>(textures.framebufferCount()));
+			}
+
 			glViewport(0, 0, topInput->width, topInput->height);
 			glClearColor(0.0, 0.0, 0.0, 0.0);
 			glClear(GL_COLOR_BUFFER_BIT);
@@ -270,118 +682,2486 @@ void TensorFlowTOP::execute(const TOP_OutputFormatSpecs* outputFormat, OP_Inputs
 			glDrawArrays(GL_TRIANGLES, 0, 6);
 		}
 		context->endGLCommands();
+#endif
 
-		// Tensors are interpretted top-down, so we need to flip the pixels here.
-		OP_TOPInputDownloadOptions options;
-		options.verticalFlip = true;
-		options.downloadType = OP_TOPInputDownloadType::Instant;
-
-		// Read pixels from GPU -> CPU.
-		uint8_t* pixels = static_cast<uint8_t*>(inputs->getTOPDataInCPUMemory(topInput, &options));
+		// Dense outputs can be warped along the input's motion on the frames in between results.
+		flowPropagation = imageOutput && inputs->getParInt("Flowpropagation") != 0;
+		if (!flowPropagation)
+		{
+			flowHistory.clear();
+			flowKeyOutput = Tensor();
+		}
 
-		// Per the TouchDesigner documentation, the pointer returned above might be `null` sometimes...
-		if (pixels != nullptr)
+		const bool pipelined = inputs->getParInt("Pipeline") != 0;
+		const size_t depth = static_cast<size_t>(std::max(1, inputs->getParInt("Pipelinedepth")));
+		const bool latestWins = inputs->getParInt("Latestwins") != 0;
+		if (pipelined)
 		{
-			// This is specific to the `inception` network and will need to be determined automatically 
-			// in the future.
-			const int32 expected_dims = 299;
+			if (!pipeline.isRunning() || pipeline.depth() != depth || pipeline.latestWins() != latestWins)
+			{
+				startPipeline(depth, latestWins);
+			}
+
+			// A delayed download returns last frame's pixels without stalling, so the readback of the
+			// next frame is always in flight while the worker threads process the previous ones.
+			OP_TOPInputDownloadOptions options;
+			options.verticalFlip = true;
+			options.downloadType = OP_TOPInputDownloadType::Delayed;
 
-			std::vector<Tensor> inputs;
+			// A delayed download comes back in the format that was requested a frame earlier, which
+			// only differs from this one for a single frame after the model or input changes.
+			const PixelFormat format = downloadFormat(topInput);
+			options.cpuMemPixelType = toCpuMemPixelType(format);
+			setInfoChannel("download_bytes_per_pixel", static_cast<float>(bytesPerPixel(format)));
 
-			if (!convertPixelsToTensor(&inputs, pixels, outputFormat->width, outputFormat->height, 4, expected_dims, expected_dims).ok()) 
+			const auto readbackStart = PipelineClock::now();
+			const void* pixels = inputs->getTOPDataInCPUMemory(topInput, &options);
+			if (pixels != nullptr && format == pipelineFormat)
 			{
-				error = "Failed to convert pixels to tensor - check input and output dimensions.";
+				const bool submitted = pipeline.submit(pixels, topInput->width, topInput->height, format, lastReadbackRequest, readbackStart);
+
+				// Gray copies of the submitted frames wait here until their results come back.
+				if (flowPropagation)
+				{
+					downscaleToGray(pixels, topInput->width, topInput->height, format, inputs->getParInt("Flowresolution"), &flowFrame);
+					if (submitted)
+					{
+						flowHistory.push_back({ pipeline.lastSubmitted(), flowFrame });
+						if (flowHistory.size() > 4 * depth + 4)
+						{
+							flowHistory.pop_front();
+						}
+					}
+				}
 			}
+			pipelineFormat = format;
+			lastReadbackRequest = readbackStart;
 
-			// Run the session and collect output tensors.
 			std::vector<Tensor> outputs;
-			string input_layer = "Mul";
-			string output_layer = "softmax";
-			if (!session->Run({{input_layer, inputs[0]}}, {output_layer}, {}, &outputs).ok()) 
+			uint64_t index = 0;
+			if (pipeline.takeLatest(&outputs, &index))
 			{
-				error = "Failed to run model on provided input.";
+				handleOutputs(outputs);
+
+				// The frame that these outputs were computed on becomes the key frame.
+				while (!flowHistory.empty() && flowHistory.front().first < index)
+				{
+					flowHistory.pop_front();
+				}
+				flowKeyOutput = Tensor();
+				if (!flowHistory.empty() && flowHistory.front().first == index)
+				{
+					flowKeyFrame = std::move(flowHistory.front().second);
+					flowKeyOutput = outputs[0];
+					flowHistory.pop_front();
+				}
+			}
+
+			// Results arrive a few frames late, so even fresh ones are warped onto the latest frame.
+			if (flowPropagation)
+			{
+				propagateOutput(inputs);
 			}
+			updatePipelineChannels();
+			warnIgnoredModes(inputs, "Pipeline", {});
+			return;
+		}
+		pipeline.stop();
+
+		// Keep the node within its frame budget by only running the model on every Nth cook, holding
+		// the previous result in between.
+		const bool governed = inputs->getParInt("Governor") != 0;
+		governor.configure(inputs->getParDouble("Framebudget"), inputs->getParInt("Maxdecimation"));
+		if (!governed)
+		{
+			governor.reset();
+		}
 
-			auto tensor = outputs[0];
-			auto number_of_dimensions = tensor.dims();
-			std::cout << "Output tensor has " << number_of_dimensions << " dimensions\n";
-			for (size_t i = 0; i < number_of_dimensions; i++)
+		if (governed && !governor.shouldRun())
+		{
+			if (flowPropagation)
 			{
-				std::cout << "	dimension " << i << ": " << tensor.dim_size(i) << "\n";
+				OP_TOPInputDownloadOptions options;
+				options.verticalFlip = true;
+				options.downloadType = OP_TOPInputDownloadType::Instant;
+
+				const PixelFormat format = downloadFormat(topInput);
+				options.cpuMemPixelType = toCpuMemPixelType(format);
+
+				const void* pixels = inputs->getTOPDataInCPUMemory(topInput, &options);
+				if (pixels != nullptr)
+				{
+					downscaleToGray(pixels, topInput->width, topInput->height, format, inputs->getParInt("Flowresolution"), &flowFrame);
+					propagateOutput(inputs);
+				}
 			}
-			if (number_of_dimensions > 3)
+			governor.record(millisecondsSince(cookStart), false, 0.0);
+			setInfoChannel("decimation", static_cast<float>(governor.decimation()));
+			return;
+		}
+
+		// Only the standard path below sets a new key frame for flow propagation.
+		flowKeyOutput = Tensor();
+
+		// High-resolution inputs can be classified tile by tile, at their own resolution.
+		if (inputs->getParInt("Tiled") != 0)
+		{
+			warnIgnoredModes(inputs, "Tiled", { "Governor", "Tiled" });
+			const auto inferenceStart = PipelineClock::now();
+			runTiled(inputs, topInput);
+			governor.record(millisecondsSince(cookStart), true, millisecondsSince(inferenceStart));
+			setInfoChannel("decimation", static_cast<float>(governor.decimation()));
+			return;
+		}
+
+		// Boxes can come from a detector, and be classified in the same cook. With keyframes, the
+		// detector only runs on keyframes, and its boxes are tracked in between.
+		if (inputs->getParInt("Detect") != 0 && detectorModel.session)
+		{
+			warnIgnoredModes(inputs, "Detect Boxes", { "Governor", "Detect", "Keyframes" });
+			const int topK = std::max(1, inputs->getParInt("Topk"));
+			const double runMs = inputs->getParInt("Keyframes") != 0 ?
+				trackBoxes(inputs, context, topInput, std::vector<Box>(), true, topK) :
+				runDetection(inputs, topInput, topK);
+			governor.record(millisecondsSince(cookStart), runMs >= 0.0, std::max(runMs, 0.0));
+			setInfoChannel("decimation", static_cast<float>(governor.decimation()));
+			return;
+		}
+
+		// All connected inputs (and all slices of texture arrays, and all boxes) go through the model
+		// together, as one batch. A pyramid and test-time augmentation are fixed sets of boxes (with
+		// augmentation, mirrored as well) whose scores are combined.
+		const bool augment = inputs->getParInt("Augment") != 0;
+		const bool pyramid = !augment && inputs->getParInt("Pyramid") != 0;
+		std::vector<Box> boxes;
+		Aggregation aggregation = Aggregation::None;
+		if (augment)
+		{
+			boxes = fiveCropBoxes(static_cast<float>(inputs->getParDouble("Augmentcrop")));
+			aggregation = Aggregation::Mean;
+		}
+		else if (pyramid)
+		{
+			boxes = pyramidBoxes(inputs->getParInt("Pyramidlevels"));
+			aggregation = inputs->getParInt("Pyramidaggregate") == 0 ? Aggregation::Max : Aggregation::Mean;
+		}
+		else
+		{
+			boxes = readBoxes(inputs->getParCHOP("Boxes"));
+		}
+
+		// Boxes can be tracked between keyframes instead of being classified every frame.
+		if (inputs->getParInt("Keyframes") != 0 && !augment && !pyramid && !boxes.empty())
+		{
+			warnIgnoredModes(inputs, "Track Between Keyframes", { "Governor", "Keyframes", "Batchinputs" });
+			const double runMs = trackBoxes(inputs, context, topInput, boxes, false, std::max(1, inputs->getParInt("Topk")));
+			governor.record(millisecondsSince(cookStart), runMs >= 0.0, std::max(runMs, 0.0));
+			setInfoChannel("decimation", static_cast<float>(governor.decimation()));
+			return;
+		}
+
+		if (inputs->getParInt("Batchinputs") != 0 || isLayeredTexture(topInput) || !boxes.empty())
+		{
+			// Augmentation replaces the pyramid's boxes.
+			if (augment)
 			{
-				
-				// TODO: how do we interpret this?
+				warnIgnoredModes(inputs, "Test-Time Augmentation", { "Governor", "Augment", "Batchinputs" });
 			}
-			
-			// Upload the output tensor's data store to a OpenGL texture.
-			/*auto tensor = outputs[0].flat<float>();
-			auto length = outputs[0].NumElements();
-			std::cout << "Uploading " << length << " elements\n";
-			context->beginGLCommands();
+			else
 			{
-				glTextureSubImage2D(texture, 0, 0, 0, length, 1, GL_RED, GL_UNSIGNED_BYTE, pixels);
+				warnIgnoredModes(inputs, "Batched inference", { "Governor", "Pyramid", "Batchinputs" });
+			}
+			const bool mirror = augment && inputs->getParInt("Augmentflip") != 0;
+			const auto inferenceStart = PipelineClock::now();
+			runBatch(inputs, context, boxes, mirror, aggregation, std::max(1, inputs->getParInt("Topk")));
+			governor.record(millisecondsSince(cookStart), true, millisecondsSince(inferenceStart));
+			setInfoChannel("decimation", static_cast<float>(governor.decimation()));
+			return;
+		}
+
+		// A small model screens every frame, and the full model only runs when it isn't sure.
+		if (cascadeModel.session)
+		{
+			warnIgnoredModes(inputs, "Cascade", { "Governor", "Cascade" });
+			const double runMs = runCascade(inputs, topInput);
+			governor.record(millisecondsSince(cookStart), runMs >= 0.0, std::max(runMs, 0.0));
+			setInfoChannel("decimation", static_cast<float>(governor.decimation()));
+			return;
+		}
 
-				glViewport(0, 0, outputFormat->width, outputFormat->height);
-				glClearColor(0.0, 0.0, 0.0, 0.0);
-				glClear(GL_COLOR_BUFFER_BIT);
+		// Models with dynamic input dimensions can run at (close to) the input's own size. Sizes are
+		// quantized to a few buckets, so that each shape is only ever set up once.
+		buckets.configure(inputs->getParString("Buckets"));
+		const bool bucketed = inputs->getParInt("Shapebuckets") != 0 && !buckets.empty();
 
-				glBindTextureUnit(0, texture);
+		// For fully convolutional models, the input resolution can also be traded for speed.
+		ladder.configure(inputs->getParString("Resolutionladder"));
+		const bool adaptive = !bucketed && inputs->getParInt("Adaptiveresolution") != 0 && !ladder.empty();
+
+		if (bucketed)
+		{
+			warnIgnoredModes(inputs, "Shape Buckets", { "Governor", "Shapebuckets" });
+		}
+		else
+		{
+			warnIgnoredModes(inputs, "Inference", { "Governor", "Adaptiveresolution" });
+		}
 
-				glUseProgram(program);
-				glBindVertexArray(vao);
-				glDrawArrays(GL_TRIANGLES, 0, 6);
+		ShapeBuckets::Size size(expectedDims, expectedDims);
+		Letterbox region;
+		if (bucketed)
+		{
+			size = buckets.select(topInput->width, topInput->height);
+			region = ShapeBuckets::fit(topInput->width, topInput->height, size);
+			warmInputShapes(buckets.sizes(), size);
+		}
+		else
+		{
+			if (adaptive)
+			{
+				std::vector<ShapeBuckets::Size> rungs;
+				for (int dims : ladder.rungs())
+				{
+					rungs.push_back({ dims, dims });
+				}
+				size = { ladder.current(), ladder.current() };
+				warmInputShapes(rungs, size);
+			}
+			else
+			{
+				// Neither mode is on, so none of their sizes are configured any more.
+				warmInputShapes({}, size);
 			}
-			context->endGLCommands();*/
+			region.width = size.first;
+			region.height = size.second;
+		}
+		InputTensorRing& ring = (bucketed || adaptive) ? shapeTensors[size] : inputTensors;
 
-			// Grab the index of the class with the highest score.
-			Eigen::Map<Eigen::VectorXf> pred(outputs[0].flat<float>().data(), outputs[0].NumElements());
-			int maxIndex; 
-			float maxValue = pred.maxCoeff(&maxIndex);
-			
-			std::cout << "Class with highest probability: " << classNames[maxIndex] << ", " << maxValue << "\n";
+		const auto inferenceStart = PipelineClock::now();
+		const double runMs = runSynchronous(inputs, topInput, size, region, ring);
+		governor.record(millisecondsSince(cookStart), true, millisecondsSince(inferenceStart));
+		setInfoChannel("decimation", static_cast<float>(governor.decimation()));
+
+		if (adaptive && runMs >= 0.0)
+		{
+			ladder.record(runMs, inputs->getParDouble("Framebudget"));
+		}
+
+		if (bucketed)
+		{
+			// Lets the network downstream map results back onto the input image.
+			setInfoChannel("bucket_width", static_cast<float>(size.first));
+			setInfoChannel("bucket_height", static_cast<float>(size.second));
+			setInfoChannel("letterbox_x", static_cast<float>(region.x));
+			setInfoChannel("letterbox_y", static_cast<float>(region.y));
+			setInfoChannel("letterbox_width", static_cast<float>(region.width));
+			setInfoChannel("letterbox_height", static_cast<float>(region.height));
+		}
+		else
+		{
+			setInfoChannel("input_resolution", static_cast<float>(size.first));
 		}
 	}
 }
 
-int32_t TensorFlowTOP::getNumInfoCHOPChans()
+void TensorFlowTOP::warnIgnoredModes(OP_Inputs* inputs, const char* path, std::initializer_list<const char*> applied)
 {
-	return 0;
+	std::string ignored;
+	for (const ModeToggle& toggle : modeToggles)
+	{
+		if (inputs->getParInt(toggle.name) != 0 && std::find_if(applied.begin(), applied.end(), [&toggle](const char* name) { return std::strcmp(name, toggle.name) == 0; }) == applied.end())
+		{
+			ignored += (ignored.empty() ? "" : ", ") + std::string(toggle.label);
+		}
+	}
+	warningMessage = ignored.empty() ? "" : std::string(path) + " ignores " + ignored + ".";
 }
 
-void TensorFlowTOP::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan)
+void TensorFlowTOP::warmInputShapes(const std::vector<ShapeBuckets::Size>& sizes, const ShapeBuckets::Size& current)
 {
-}
-
-bool TensorFlowTOP::getInfoDATSize(OP_InfoDATSize* infoSize)
+	// Sizes that were taken out of the buckets or the ladder (or belong to the mode that was turned
+	// off) give their tensors back.
+	const auto configured = [&sizes](const ShapeBuckets::Size& size) { return std::find(sizes.begin(), sizes.end(), size) != sizes.end(); };
+	for (auto it = shapeTensors.begin(); it != shapeTensors.end();)
+	{
+		it = configured(it->first) ? std::next(it) : shapeTensors.erase(it);
+	}
+	for (auto it = warmedShapes.begin(); it != warmedShapes.end();)
+	{
+		it = configured(*it) ? std::next(it) : warmedShapes.erase(it);
+	}
+	if (sizes.empty())
+	{
+		return;
+	}
+
+	// The first run at a new input shape allocates buffers and sets up kernels for it, which shows up
+	// as a spike. This cook runs `current` anyway; of the others, one is run per cook, so that the
+	// spikes are spread out rather than all landing on the cook on which the sizes changed, and
+	// switching between them later doesn't cause one.
+	warmedShapes.insert(current);
+	for (const auto& size : sizes)
+	{
+		if (!warmedShapes.insert(size).second)
+		{
+			continue;
+		}
+
+		InputTensorRing& ring = shapeTensors[size];
+		ring.reserve(modelInput.shape(size.second, size.first), 3, modelInput.type);
+
+		Tensor& input = ring.next();
+		if (modelInput.type == tensorflow::DT_UINT8)
+		{
+			input.flat<uint8_t>().setZero();
+		}
+		else
+		{
+			input.flat<float>().setZero();
+		}
+
+		std::vector<Tensor> outputs;
+		for (int i = 0; i < 2; ++i)
+		{
+			if (!session->Run({ { inputLayer, input } }, { outputLayer }, {}, &outputs).ok())
+			{
+				error = "Failed to run model at one of the bucket or ladder sizes - does it accept variable input sizes?";
+			}
+		}
+		return;
+	}
+}
+
+double TensorFlowTOP::runSynchronous(OP_Inputs* inputs,
+									 const OP_TOPInput* topInput,
+									 const ShapeBuckets::Size& size,
+									 const Letterbox& region,
+									 InputTensorRing& ring)
 {
-	return true;
+	// Tensors are interpretted top-down, so we need to flip the pixels here.
+	OP_TOPInputDownloadOptions options;
+	options.verticalFlip = true;
+	options.downloadType = OP_TOPInputDownloadType::Instant;
+
+	// Float pixels preserve HDR and 16-bit inputs, 8-bit pixels are a quarter of the size.
+	const PixelFormat format = downloadFormat(topInput);
+	options.cpuMemPixelType = toCpuMemPixelType(format);
+	setInfoChannel("download_bytes_per_pixel", static_cast<float>(bytesPerPixel(format)));
+
+	// Read pixels from GPU -> CPU.
+	const void* pixels = inputs->getTOPDataInCPUMemory(topInput, &options);
+
+	// Per the TouchDesigner documentation, the pointer returned above might be `null` sometimes...
+	if (pixels == nullptr)
+	{
+		return -1.0;
+	}
+
+	// The input tensors persist across frames and are only reallocated if the model's input shape changes.
+	ring.reserve(modelInput.shape(size.second, size.first), 3, modelInput.type);
+	Tensor& input = ring.next();
+
+	const auto convertStart = PipelineClock::now();
+	if (!letterboxPixelsToTensor(&input, region, pixels, topInput->width, topInput->height, format).ok()) 
+	{
+		error = "Failed to convert pixels to tensor - check input and output dimensions.";
+		return -1.0;
+	}
+	setInfoChannel("convert_ms", static_cast<float>(millisecondsSince(convertStart)));
+
+	// Run the session and collect output tensors.
+	const auto runStart = PipelineClock::now();
+	std::vector<Tensor> outputs;
+	if (!session->Run({{inputLayer, input}}, {outputLayer}, {}, &outputs).ok()) 
+	{
+		error = "Failed to run model on provided input.";
+		return -1.0;
+	}
+	const double runMs = millisecondsSince(runStart);
+
+	handleOutputs(outputs);
+
+	// Flow propagation needs the output to cover the whole frame, as it does without a letterbox.
+	if (flowPropagation && region.x == 0 && region.y == 0 && region.width == size.first && region.height == size.second)
+	{
+		downscaleToGray(pixels, topInput->width, topInput->height, format, inputs->getParInt("Flowresolution"), &flowKeyFrame);
+		flowKeyOutput = outputs[0];
+	}
+	return runMs;
 }
 
-void TensorFlowTOP::getInfoDATEntries(int32_t index, int32_t nEntries, OP_InfoDATEntries* entries)
+double TensorFlowTOP::runCascade(OP_Inputs* inputs, const OP_TOPInput* topInput)
 {
+	const int cascadeDims = std::max(1, inputs->getParInt("Cascadesize"));
+	cascade.configure(static_cast<float>(inputs->getParDouble("Cascademargin")));
+
+	OP_TOPInputDownloadOptions options;
+	options.verticalFlip = true;
+	options.downloadType = OP_TOPInputDownloadType::Instant;
+
+	const PixelFormat format = downloadFormat(topInput);
+	options.cpuMemPixelType = toCpuMemPixelType(format);
+
+	const void* pixels = inputs->getTOPDataInCPUMemory(topInput, &options);
+	if (pixels == nullptr)
+	{
+		return -1.0;
+	}
+
+	const InputFormat& cascadeInput = cascadeModel.input;
+	cascadeModel.tensors.reserve(cascadeInput.shape(cascadeDims, cascadeDims), 3, cascadeInput.type);
+	Tensor& smallInput = cascadeModel.tensors.next();
+	Letterbox region;
+	region.width = cascadeDims;
+	region.height = cascadeDims;
+	if (!cascadeModel.converter.convert(pixels, topInput->width, topInput->height, format, region, &smallInput).ok())
+	{
+		error = "Failed to convert pixels to the cascade's input - check its input size.";
+		return -1.0;
+	}
+
+	const auto smallStart = PipelineClock::now();
+	std::vector<Tensor> smallOutputs;
+	if (!cascadeModel.session->Run({ { cascadeModel.inputLayer, smallInput } }, { inputs->getParString("Cascadeoutput") }, {}, &smallOutputs).ok())
+	{
+		error = "Failed to run the cascade's model - check its input and output layer names.";
+		return -1.0;
+	}
+	const double smallMs = millisecondsSince(smallStart);
+
+	const Tensor& scores = smallOutputs[0];
+	if (scores.dtype() != tensorflow::DT_FLOAT || scores.NumElements() < 1)
+	{
+		error = "The cascade's model has to output float class scores.";
+		return -1.0;
+	}
+	const float margin = ModelCascade::margin(scores.flat<float>().data(), static_cast<size_t>(scores.NumElements()));
+	const bool escalate = cascade.shouldEscalate(margin);
+
+	double fullMs = 0.0;
+	if (escalate)
+	{
+		// When both models take the same input, the full model runs on the tensor that is already filled.
+		const bool sameInput = cascadeDims == expectedDims && cascadeInput.type == modelInput.type &&
+			cascadeInput.layout == modelInput.layout && cascadeInput.channels == modelInput.channels;
+		Tensor* fullInput = &smallInput;
+		if (!sameInput)
+		{
+			inputTensors.reserve(modelInput.shape(expectedDims, expectedDims), 3, modelInput.type);
+			fullInput = &inputTensors.next();
+			if (!convertPixelsToTensor(fullInput, pixels, topInput->width, topInput->height, format).ok())
+			{
+				error = "Failed to convert pixels to tensor - check input and output dimensions.";
+				return -1.0;
+			}
+		}
+
+		const auto fullStart = PipelineClock::now();
+		std::vector<Tensor> fullOutputs;
+		if (!session->Run({ { inputLayer, *fullInput } }, { outputLayer }, {}, &fullOutputs).ok())
+		{
+			error = "Failed to run model on provided input.";
+			return -1.0;
+		}
+		fullMs = millisecondsSince(fullStart);
+		handleOutputs(fullOutputs);
+		setInfoChannel("cascade_shared_input", sameInput ? 1.0f : 0.0f);
+	}
+	else
+	{
+		// The small model's classes needn't line up with the full model's labels.
+		handleOutputs(smallOutputs, false);
+	}
+
+	cascade.record(smallMs, escalate, fullMs);
+	setInfoChannel("cascade_margin", margin);
+	setInfoChannel("cascade_escalated", escalate ? 1.0f : 0.0f);
+	setInfoChannel("cascade_escalation_rate", static_cast<float>(cascade.escalationRate()));
+	setInfoChannel("cascade_small_ms", static_cast<float>(smallMs));
+	setInfoChannel("cascade_full_ms", static_cast<float>(cascade.averageFullMs()));
+	setInfoChannel("cascade_saved_ms", static_cast<float>(cascade.averageSavedMs()));
+	return smallMs + fullMs;
 }
 
-void TensorFlowTOP::setupParameters(OP_ParameterManager* manager)
+double TensorFlowTOP::runDetection(OP_Inputs* inputs, const OP_TOPInput* topInput, int topK, std::vector<Box>* detectedBoxes, BatchImage* downloaded)
 {
-	// A filepath parameter for loading custom models.
+	const int detectorDims = std::max(1, inputs->getParInt("Detectorsize"));
+	const float threshold = static_cast<float>(inputs->getParDouble("Detectthreshold"));
+	const float overlap = static_cast<float>(inputs->getParDouble("Detectoverlap"));
+	const size_t maxCount = static_cast<size_t>(std::max(1, inputs->getParInt("Detectmax")));
+	const auto encoding = static_cast<BoxEncoding>(inputs->getParInt("Detectordecoding"));
+	const auto suppression = static_cast<Suppression>(inputs->getParInt("Detectnms"));
+
+	// Both stages read from this one download.
+	OP_TOPInputDownloadOptions options;
+	options.verticalFlip = true;
+	options.downloadType = OP_TOPInputDownloadType::Instant;
+
+	const PixelFormat format = downloadFormat(topInput);
+	options.cpuMemPixelType = toCpuMemPixelType(format);
+
+	const void* pixels = inputs->getTOPDataInCPUMemory(topInput, &options);
+	if (pixels == nullptr)
 	{
-		OP_StringParameter sp;
-		sp.defaultValue = "models/inception.pb";
-		sp.name = "Modelpath";
-		sp.label = "Model Path";
+		return -1.0;
+	}
+	const BatchImage image = { pixels, topInput->width, topInput->height, format };
 
-		OP_ParAppendResult res = manager->appendFile(sp);
-		assert(res == OP_ParAppendResult::Success);
+	// The detector sees the whole image, at its own input size.
+	const auto detectStart = PipelineClock::now();
+	const InputFormat& detectorInput = detectorModel.input;
+	detectorModel.tensors.reserve(detectorInput.shape(detectorDims, detectorDims), 3, detectorInput.type);
+	Tensor& input = detectorModel.tensors.next();
+	Letterbox region;
+	region.width = detectorDims;
+	region.height = detectorDims;
+	if (!detectorModel.converter.convert(pixels, topInput->width, topInput->height, format, region, &input).ok())
+	{
+		error = "Failed to convert pixels to the detector's input - check its input size.";
+		return -1.0;
+	}
+
+	// A YOLO region layer holds the boxes and their scores together.
+	std::vector<string> fetches = { inputs->getParString("Detectorboxes") };
+	if (encoding != BoxEncoding::Yolo)
+	{
+		fetches.push_back(inputs->getParString("Detectorscores"));
+	}
+	const std::string classesLayer = inputs->getParString("Detectorclasses");
+	if (encoding == BoxEncoding::Decoded && !classesLayer.empty())
+	{
+		fetches.push_back(classesLayer);
+	}
+
+	std::vector<Tensor> outputs;
+	if (!detectorModel.session->Run({ { detectorModel.inputLayer, input } }, fetches, {}, &outputs).ok())
+	{
+		error = "Failed to run the detector - check its input and output layer names.";
+		return -1.0;
+	}
+	const double detectMs = millisecondsSince(detectStart);
+
+	// Only the boxes that pass the threshold are decoded.
+	const auto decodeStart = PipelineClock::now();
+	Status status;
+	if (encoding == BoxEncoding::Ssd)
+	{
+		const std::string grids = inputs->getParString("Ssdgrids");
+		if (grids != detectorAnchorGrids)
+		{
+			ssdAnchors(readNumbers(grids), 0.2f, 0.95f, &detectorAnchors);
+			detectorAnchorGrids = grids;
+		}
+		status = decodeSsd(outputs[0], outputs[1], detectorAnchors, threshold, &boxCandidates);
+	}
+	else if (encoding == BoxEncoding::Yolo)
+	{
+		status = decodeYolo(outputs[0], readNumbers(inputs->getParString("Yoloanchors")), threshold, &boxCandidates);
+	}
+	else
+	{
+		status = readDetections(outputs[0], outputs[1], outputs.size() > 2 ? &outputs[2] : nullptr, threshold, &boxCandidates);
+	}
+	if (!status.ok())
+	{
+		errorMessage = status.error_message();
+		error = errorMessage.c_str();
+		return -1.0;
+	}
+	const double decodeMs = millisecondsSince(decodeStart);
+
+	const auto suppressStart = PipelineClock::now();
+	std::vector<Detection> detections;
+	suppressOverlaps(boxCandidates, suppression, overlap, threshold, maxCount, &detections);
+	const double suppressMs = millisecondsSince(suppressStart);
+
+	std::vector<Box> boxes;
+	std::vector<float> scores;
+	for (const Detection& detection : detections)
+	{
+		boxes.push_back(detection.box);
+		scores.push_back(detection.score);
+	}
+	setBoxChannels(boxes, scores, "score");
+	if (detectedBoxes != nullptr)
+	{
+		*detectedBoxes = boxes;
+	}
+	if (downloaded != nullptr)
+	{
+		*downloaded = image;
+	}
+	for (size_t i = 0; i < detections.size(); ++i)
+	{
+		setInfoChannel("box" + std::to_string(i) + "_class", static_cast<float>(detections[i].classIndex));
+	}
+	setInfoChannel("candidates", static_cast<float>(boxCandidates.size()));
+	setInfoChannel("detections", static_cast<float>(detections.size()));
+	setInfoChannel("detect_ms", static_cast<float>(detectMs));
+	setInfoChannel("decode_ms", static_cast<float>(decodeMs));
+	setInfoChannel("nms_ms", static_cast<float>(suppressMs));
+
+	// The Info DAT has a row per box as well: x, y, w, h, score and class.
+	infoEntries.erase(std::remove_if(infoEntries.begin(), infoEntries.end(), [](const std::pair<std::string, std::string>& entry)
+	{
+		return entry.first.compare(0, 3, "box") == 0 && entry.first.size() > 3 && std::isdigit(static_cast<unsigned char>(entry.first[3]));
+	}), infoEntries.end());
+	for (size_t i = 0; i < detections.size(); ++i)
+	{
+		const Detection& detection = detections[i];
+		setInfoEntry("box" + std::to_string(i), tensorflow::strings::Printf("%.4f %.4f %.4f %.4f %.4f %d", detection.box.x, detection.box.y,
+			detection.box.width, detection.box.height, detection.score, detection.classIndex));
+	}
+
+	// The boxes are cropped from the same download and classified in a single run, so each box's
+	// classes (`input0_class1`, ...) line up with its channels above.
+	double classifyMs = 0.0;
+	if (boxes.empty())
+	{
+		removeInfoChannels("input");
+		batchChannels = 0;
 	}
+	else
+	{
+		const auto classifyStart = PipelineClock::now();
+		if (classifyBatch({ image }, boxes, false, Aggregation::None, topK) < 0.0)
+		{
+			return -1.0;
+		}
+		classifyMs = millisecondsSince(classifyStart);
+	}
+	setInfoChannel("classify_ms", static_cast<float>(classifyMs));
+	return detectMs + decodeMs + suppressMs + classifyMs;
 }
 
-void TensorFlowTOP::pulsePressed(const char* name)
+void TensorFlowTOP::propagateOutput(OP_Inputs* inputs)
+{
+	// Only `[1, height, width, channels]` float outputs can be warped, and only between frames of the same size.
+	const Tensor& key = flowKeyOutput;
+	if (key.dtype() != tensorflow::DT_FLOAT || key.dims() != 4 || key.dim_size(0) != 1 ||
+		flowFrame.pixels.empty() || flowFrame.width != flowKeyFrame.width || flowFrame.height != flowKeyFrame.height)
+	{
+		return;
+	}
+
+	// The flow is estimated straight from this frame back to the key frame, so errors don't add up
+	// from one frame to the next. A new tensor every time, since the last one may still be drawn.
+	const auto flowStart = PipelineClock::now();
+	denseFlow.estimate(flowFrame, flowKeyFrame, inputs->getParInt("Flowlevels"));
+	Tensor warped(tensorflow::DT_FLOAT, key.shape());
+	warpTensor(key, denseFlow, &warped);
+	setInfoChannel("flow_ms", static_cast<float>(millisecondsSince(flowStart)));
+
+	latestOutputs = { warped };
+	outputPending = true;
+}
+
+double TensorFlowTOP::runBatch(OP_Inputs* inputs, TOP_Context* context, const std::vector<Box>& boxes, bool mirror, Aggregation aggregation, int topK, BatchImage* firstImage)
+{
+	// Downloads have to happen on the cook thread, but the conversions are independent.
+	std::vector<BatchImage> batch;
+	std::vector<std::pair<const OP_TOPInput*, size_t>> layeredInputs;
+	for (int i = 0; i < inputs->getNumInputs(); ++i)
+	{
+		const OP_TOPInput* topInput = inputs->getInputTOP(i);
+		if (topInput == nullptr)
+		{
+			return -1.0;
+		}
+
+		const PixelFormat format = downloadFormat(topInput);
+#ifndef TENSORFLOW_TOP_CPU_OUTPUT
+		// Every slice of a texture array (or 3D texture) is an image of the batch, in slice order.
+		// They are read back below, once all of TouchDesigner's own downloads are done.
+		if (isLayeredTexture(topInput))
+		{
+			layeredInputs.push_back({ topInput, batch.size() });
+			batch.resize(batch.size() + topInput->depth, { nullptr, topInput->width, topInput->height, format });
+			continue;
+		}
+#endif
+
+		OP_TOPInputDownloadOptions options;
+		options.verticalFlip = true;
+		options.downloadType = OP_TOPInputDownloadType::Instant;
+		options.cpuMemPixelType = toCpuMemPixelType(format);
+
+		// A missing input would shift every later input's results onto the wrong channels.
+		const void* pixels = inputs->getTOPDataInCPUMemory(topInput, &options);
+		if (pixels == nullptr)
+		{
+			return -1.0;
+		}
+		batch.push_back({ pixels, topInput->width, topInput->height, format });
+	}
+
+#ifndef TENSORFLOW_TOP_CPU_OUTPUT
+	if (!layeredInputs.empty())
+	{
+		context->beginGLCommands();
+		size_t buffer = 0;
+		for (const auto& layered : layeredInputs)
+		{
+			downloadSlices(layered.first, &batch[layered.second], &buffer);
+		}
+		context->endGLCommands();
+	}
+#endif
+
+	if (firstImage != nullptr && !batch.empty())
+	{
+		*firstImage = batch[0];
+	}
+	return classifyBatch(batch, boxes, mirror, aggregation, topK);
+}
+
+double TensorFlowTOP::classifyBatch(const std::vector<BatchImage>& batch, const std::vector<Box>& boxes, bool mirror, Aggregation aggregation, int topK)
+{
+	// With boxes, every box of every image is cropped straight out of the downloaded pixels and
+	// becomes an image of the batch, so small subjects keep their resolution. Mirrored crops follow
+	// the unmirrored ones. Every image has the same number of crops.
+	const std::vector<Letterbox> noCrops(1);
+	std::vector<BatchItem> items;
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		const std::vector<Letterbox> crops = boxes.empty() ? noCrops : cropBoxes(boxes, batch[i].width, batch[i].height);
+		for (int pass = 0; pass < (mirror ? 2 : 1); ++pass)
+		{
+			for (Letterbox crop : crops)
+			{
+				if (crop.width == 0)
+				{
+					crop.width = batch[i].width;
+					crop.height = batch[i].height;
+				}
+				items.push_back({ i, crop, pass == 1 });
+			}
+		}
+	}
+
+	const int count = static_cast<int>(items.size());
+	if (count == 0)
+	{
+		return -1.0;
+	}
+
+	batchTensors.reserve(modelInput.shape(expectedDims, expectedDims, count), 3, modelInput.type);
+	Tensor& input = batchTensors.next();
+
+	// Every image is written into its own slice of the batch tensor. The cost estimate is high
+	// enough that each image gets a thread of its own.
+	Letterbox region;
+	region.width = expectedDims;
+	region.height = expectedDims;
+	std::vector<Status> converted(count);
+	const auto convertStart = PipelineClock::now();
+	preprocessThreads()->ParallelFor(count, static_cast<tensorflow::int64>(expectedDims) * expectedDims * 100, [&](tensorflow::int64 begin, tensorflow::int64 end)
+	{
+		for (tensorflow::int64 i = begin; i < end; ++i)
+		{
+			const BatchImage& image = batch[items[i].image];
+			converted[i] = converter.convert(image.pixels, image.width, image.height, image.format, items[i].crop, region, &input, static_cast<int>(i), items[i].mirror);
+		}
+	});
+	setInfoChannel("convert_ms", static_cast<float>(millisecondsSince(convertStart)));
+
+	for (const auto& status : converted)
+	{
+		if (!status.ok())
+		{
+			error = "Failed to convert pixels to tensor - check input and output dimensions.";
+			return -1.0;
+		}
+	}
+
+	// With an aggregation, the scores of all of an image's crops are combined into one result. That
+	// happens in the same run when possible, so only the combined scores are fetched.
+	const int images = static_cast<int>(batch.size());
+	const bool combineInGraph = aggregation != Aggregation::None && cropAggregationInGraph;
+	std::vector<std::pair<string, Tensor>> feeds = { { inputLayer, input } };
+	string fetch = outputLayer;
+	if (combineInGraph)
+	{
+		Tensor shape(tensorflow::DT_INT32, tensorflow::TensorShape({ 3 }));
+		auto dims = shape.vec<int32>();
+		dims(0) = images;
+		dims(1) = count / images;
+		dims(2) = -1;
+		feeds.push_back({ cropShapeNode, shape });
+		fetch = aggregation == Aggregation::Max ? cropMaxNode : cropMeanNode;
+	}
+
+	const auto runStart = PipelineClock::now();
+	std::vector<Tensor> outputs;
+	if (!session->Run(feeds, { fetch }, {}, &outputs).ok())
+	{
+		error = "Failed to run the batch - does the model accept a variable batch size?";
+		return -1.0;
+	}
+	const double runMs = millisecondsSince(runStart);
+
+	latestOutputs = outputs;
+	outputPending = true;
+
+	const int fetchedCount = combineInGraph ? images : count;
+	const Tensor& scores = outputs[0];
+	if (scores.dtype() != tensorflow::DT_FLOAT || scores.dims() < 1 || scores.dim_size(0) != fetchedCount)
+	{
+		error = "Batched inputs expect a [batch, classes] float output.";
+		return -1.0;
+	}
+
+	const int classes = static_cast<int>(scores.NumElements() / fetchedCount);
+	const float* results = scores.flat<float>().data();
+	int resultCount = fetchedCount;
+	std::vector<float> combined;
+	if (aggregation != Aggregation::None && !combineInGraph)
+	{
+		resultCount = images;
+		combined.assign(static_cast<size_t>(resultCount) * classes, aggregation == Aggregation::Max ? -std::numeric_limits<float>::infinity() : 0.0f);
+		for (int i = 0; i < count; ++i)
+		{
+			const float* itemScores = results + (static_cast<size_t>(i) * classes);
+			float* imageScores = combined.data() + (items[i].image * classes);
+			for (int c = 0; c < classes; ++c)
+			{
+				imageScores[c] = aggregation == Aggregation::Max ? std::max(imageScores[c], itemScores[c]) : imageScores[c] + itemScores[c];
+			}
+		}
+		if (aggregation == Aggregation::Mean)
+		{
+			const float inverse = static_cast<float>(resultCount) / count;
+			for (float& score : combined)
+			{
+				score *= inverse;
+			}
+		}
+		results = combined.data();
+	}
+
+	// Each result's best classes get a group of channels (`input0_class1`, `input0_score1`, ...). The
+	// groups of inputs that were disconnected are removed.
+	topK = std::min(topK, classes);
+	if (resultCount * topK != batchChannels)
+	{
+		removeInfoChannels("input");
+		batchChannels = resultCount * topK;
+	}
+
+	std::vector<int> order(classes);
+	for (int i = 0; i < resultCount; ++i)
+	{
+		const float* imageScores = results + (static_cast<size_t>(i) * classes);
+		for (int c = 0; c < classes; ++c)
+		{
+			order[c] = c;
+		}
+		std::partial_sort(order.begin(), order.begin() + topK, order.end(), [imageScores](int a, int b)
+		{
+			return imageScores[a] > imageScores[b];
+		});
+
+		const std::string prefix = "input" + std::to_string(i) + "_";
+		for (int k = 0; k < topK; ++k)
+		{
+			setInfoChannel(prefix + "class" + std::to_string(k + 1), static_cast<float>(order[k]));
+			setInfoChannel(prefix + "score" + std::to_string(k + 1), imageScores[order[k]]);
+		}
+	}
+	setInfoChannel("batch_size", static_cast<float>(count));
+	setInfoChannel("batch_run_ms", static_cast<float>(runMs));
+
+	if (benchmarkPending)
+	{
+		benchmarkPending = false;
+		benchmarkBatch(input);
+	}
+	return runMs;
+}
+
+double TensorFlowTOP::trackBoxes(OP_Inputs* inputs, TOP_Context* context, const OP_TOPInput* topInput, const std::vector<Box>& boxes, bool detect, int topK)
 {
+	const int interval = std::max(1, inputs->getParInt("Keyframeinterval"));
+	const float minConfidence = static_cast<float>(inputs->getParDouble("Trackconfidence"));
+	const int trackWidth = std::max(32, inputs->getParInt("Trackresolution"));
+	const int radius = std::max(1, inputs->getParInt("Tracksearch"));
+
+	// The model runs every `interval` frames, when the tracker lost confidence on the previous frame,
+	// and when the boxes change: when the CHOP moves them, or when they start coming from the other
+	// source. With the detector, every keyframe finds the boxes anew. Results are held in between.
+	double runMs = -1.0;
+	const bool sourceChanged = detect != trackingDetections || (!detect && boxes != keyframeBoxes);
+	const bool keyframe = sourceChanged || framesSinceKeyframe + 1 >= interval || trackConfidence < minConfidence;
+	if (keyframe)
+	{
+		BatchImage first = {};
+		std::vector<Box> seeds = boxes;
+		runMs = detect ?
+			runDetection(inputs, topInput, topK, &seeds, &first) :
+			runBatch(inputs, context, boxes, false, Aggregation::None, topK, &first);
+		if (runMs < 0.0 || first.pixels == nullptr)
+		{
+			return runMs;
+		}
+
+		const auto trackStart = PipelineClock::now();
+		downscaleToGray(first.pixels, first.width, first.height, first.format, trackWidth, &trackFrame);
+		tracker.reset(seeds, trackFrame);
+		keyframeBoxes = boxes;
+		trackingDetections = detect;
+		trackConfidence = 1.0f;
+		framesSinceKeyframe = 0;
+		setInfoChannel("track_ms", static_cast<float>(millisecondsSince(trackStart)));
+	}
+	else
+	{
+		// Only the gray copy of the readback is needed, so the download is the only full-size pass.
+		OP_TOPInputDownloadOptions options;
+		options.verticalFlip = true;
+		options.downloadType = OP_TOPInputDownloadType::Instant;
+
+		const PixelFormat format = downloadFormat(topInput);
+		options.cpuMemPixelType = toCpuMemPixelType(format);
+
+		const void* pixels = inputs->getTOPDataInCPUMemory(topInput, &options);
+		if (pixels == nullptr)
+		{
+			return -1.0;
+		}
+
+		const auto trackStart = PipelineClock::now();
+		downscaleToGray(pixels, topInput->width, topInput->height, format, trackWidth, &trackFrame);
+		trackConfidence = tracker.update(trackFrame, radius);
+		++framesSinceKeyframe;
+		setInfoChannel("track_ms", static_cast<float>(millisecondsSince(trackStart)));
+	}
+
+	// Every box's position is updated every frame.
+	setBoxChannels(tracker.boxes(), tracker.confidences(), "confidence");
+	setInfoChannel("keyframe", keyframe ? 1.0f : 0.0f);
+	setInfoChannel("frames_since_keyframe", static_cast<float>(framesSinceKeyframe));
+	setInfoChannel("track_confidence", trackConfidence);
+	return runMs;
 }
 
-//const char* TensorFlowTOP::getErrorString()
-//{
-//	return error;
-//}
\ No newline at end of file
+double TensorFlowTOP::runTiled(OP_Inputs* inputs, const OP_TOPInput* topInput)
+{
+	const int tileSize = std::max(16, inputs->getParInt("Tilesize"));
+	const float overlap = static_cast<float>(std::min(std::max(inputs->getParDouble("Tileoverlap"), 0.0), 0.9));
+	const int maxBatch = std::max(1, inputs->getParInt("Tilebatch"));
+	const bool changeDriven = inputs->getParInt("Tilechanges") != 0;
+	const float changeThreshold = static_cast<float>(inputs->getParDouble("Tilethreshold"));
+
+	OP_TOPInputDownloadOptions options;
+	options.verticalFlip = true;
+	options.downloadType = OP_TOPInputDownloadType::Instant;
+
+	const PixelFormat format = downloadFormat(topInput);
+	options.cpuMemPixelType = toCpuMemPixelType(format);
+
+	const void* pixels = inputs->getTOPDataInCPUMemory(topInput, &options);
+	if (pixels == nullptr)
+	{
+		return -1.0;
+	}
+
+	// A new layout (or pixel format) invalidates all of the cached results.
+	if (tileGrid.layout(topInput->width, topInput->height, tileSize, overlap) || format != tileFormat)
+	{
+		tileScores.assign(tileGrid.tiles().size(), std::vector<float>());
+		tileFingerprints.assign(tileGrid.tiles().size(), TileFingerprint());
+		tileFormat = format;
+	}
+	const std::vector<Letterbox>& tiles = tileGrid.tiles();
+	const int count = static_cast<int>(tiles.size());
+
+	// With change-driven evaluation, only tiles whose content moved away from the fingerprint they
+	// were last classified at are run again. The others keep their cached scores.
+	const auto tilesStart = PipelineClock::now();
+	std::vector<int> pending;
+	std::vector<TileFingerprint> fingerprints;
+	if (changeDriven)
+	{
+		fingerprints.resize(count);
+		preprocessThreads()->ParallelFor(count, static_cast<tensorflow::int64>(tileSize) * tileSize, [&](tensorflow::int64 begin, tensorflow::int64 end)
+		{
+			for (tensorflow::int64 i = begin; i < end; ++i)
+			{
+				fingerprintTile(pixels, topInput->width, format, tiles[i], &fingerprints[i]);
+			}
+		});
+
+		for (int i = 0; i < count; ++i)
+		{
+			if (tileScores[i].empty() || fingerprintDistance(fingerprints[i], tileFingerprints[i]) > changeThreshold)
+			{
+				pending.push_back(i);
+			}
+		}
+	}
+	else
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			pending.push_back(i);
+		}
+	}
+	setInfoChannel("tiles_evaluated", static_cast<float>(pending.size()));
+
+	if (pending.empty())
+	{
+		return 0.0;
+	}
+
+	// Tiles are split into as few runs as the maximum batch allows. The batch size only depends on
+	// the layout, so that the model only ever sees one batch shape, however many tiles changed. The
+	// last run is padded by repeating its last tile.
+	const int layoutRuns = (count + maxBatch - 1) / maxBatch;
+	const int batchSize = (count + layoutRuns - 1) / layoutRuns;
+	const int runs = (static_cast<int>(pending.size()) + batchSize - 1) / batchSize;
+	// The ring holds enough batches for every tile, so that it isn't reallocated as the number of
+	// changed tiles varies. Only as many as this frame needs are filled.
+	tileTensors.reserve(modelInput.shape(expectedDims, expectedDims, batchSize), layoutRuns, modelInput.type);
+	std::vector<Tensor*> batches;
+	for (int run = 0; run < runs; ++run)
+	{
+		batches.push_back(&tileTensors.next());
+	}
+
+	Letterbox region;
+	region.width = expectedDims;
+	region.height = expectedDims;
+	std::vector<Status> converted(runs * batchSize);
+	preprocessThreads()->ParallelFor(runs * batchSize, static_cast<tensorflow::int64>(expectedDims) * expectedDims * 100, [&](tensorflow::int64 begin, tensorflow::int64 end)
+	{
+		for (tensorflow::int64 slot = begin; slot < end; ++slot)
+		{
+			const Letterbox& tile = tiles[pending[std::min(static_cast<size_t>(slot), pending.size() - 1)]];
+			converted[slot] = converter.convert(pixels, topInput->width, topInput->height, format, tile, region, batches[slot / batchSize], static_cast<int>(slot % batchSize));
+		}
+	});
+
+	for (const auto& status : converted)
+	{
+		if (!status.ok())
+		{
+			error = "Failed to convert pixels to tensor - check input and output dimensions.";
+			return -1.0;
+		}
+	}
+
+	const auto runStart = PipelineClock::now();
+	size_t classes = 0;
+	for (int run = 0; run < runs; ++run)
+	{
+		std::vector<Tensor> outputs;
+		if (!session->Run({ { inputLayer, *batches[run] } }, { outputLayer }, {}, &outputs).ok())
+		{
+			error = "Failed to run a batch of tiles - does the model accept a variable batch size?";
+			return -1.0;
+		}
+
+		const Tensor& scores = outputs[0];
+		if (scores.dtype() != tensorflow::DT_FLOAT || scores.dims() < 1 || scores.dim_size(0) != batchSize)
+		{
+			error = "Tiled inference expects a [batch, classes] float output.";
+			return -1.0;
+		}
+
+		classes = static_cast<size_t>(scores.NumElements() / batchSize);
+		const float* data = scores.flat<float>().data();
+		for (int i = 0; i < batchSize && run * batchSize + i < static_cast<int>(pending.size()); ++i)
+		{
+			tileScores[pending[run * batchSize + i]].assign(data + i * classes, data + (i + 1) * classes);
+		}
+	}
+	const double runMs = millisecondsSince(runStart);
+	const double tilesMs = millisecondsSince(tilesStart);
+
+	// Only now that they have been classified, the tiles are compared against their new content.
+	if (changeDriven)
+	{
+		for (int i : pending)
+		{
+			tileFingerprints[i] = fingerprints[i];
+		}
+	}
+
+	// The merged scores are the output, so `Image` mode draws them as a heatmap.
+	Tensor heatmap(tensorflow::DT_FLOAT, tensorflow::TensorShape({ 1, tileGrid.rows(), tileGrid.columns(), static_cast<tensorflow::int64>(classes) }));
+	tileGrid.merge(tileScores, classes, heatmap.flat<float>().data());
+	latestOutputs = { heatmap };
+	outputPending = true;
+
+	setInfoChannel("tiles", static_cast<float>(count));
+	setInfoChannel("tile_runs", static_cast<float>(runs));
+	setInfoChannel("tiles_per_second", static_cast<float>(pending.size() * 1000.0 / tilesMs));
+	setInfoChannel("heatmap_width", static_cast<float>(tileGrid.columns()));
+	setInfoChannel("heatmap_height", static_cast<float>(tileGrid.rows()));
+	return runMs;
+}
+
+tensorflow::thread::ThreadPool* TensorFlowTOP::preprocessThreads()
+{
+	if (!preprocessPool)
+	{
+		preprocessPool.reset(new tensorflow::thread::ThreadPool(tensorflow::Env::Default(), "preprocess", std::max(1, tensorflow::port::NumSchedulableCPUs() / 2)));
+	}
+	return preprocessPool.get();
+}
+
+#ifndef TENSORFLOW_TOP_CPU_OUTPUT
+void TensorFlowTOP::downloadSlices(const OP_TOPInput* topInput, BatchImage* images, size_t* buffer)
+{
+	// `getTOPDataInCPUMemory()` only returns the first slice, so the slices are read straight from the
+	// texture, in the pixel format that the conversion expects.
+	const size_t rowBytes = static_cast<size_t>(images[0].width) * bytesPerPixel(images[0].format);
+	const size_t bytes = rowBytes * images[0].height;
+	GLenum format = GL_BGRA;
+	GLenum type = GL_UNSIGNED_BYTE;
+	switch (images[0].format)
+	{
+	case PixelFormat::RGBA32F:
+		format = GL_RGBA;
+		type = GL_FLOAT;
+		break;
+	case PixelFormat::R8:
+		format = GL_RED;
+		break;
+	case PixelFormat::R32F:
+		format = GL_RED;
+		type = GL_FLOAT;
+		break;
+	default:
+		break;
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for (uint32_t slice = 0; slice < topInput->depth; ++slice)
+	{
+		if (*buffer == sliceBuffers.size())
+		{
+			sliceBuffers.emplace_back();
+		}
+		std::vector<uint8_t>& pixels = sliceBuffers[(*buffer)++];
+		pixels.resize(bytes);
+
+		glGetTextureSubImage(topInput->textureIndex, 0, 0, 0, slice, images[0].width, images[0].height, 1, format, type, static_cast<GLsizei>(bytes), pixels.data());
+
+		// GL returns the bottom row first, and tensors are read top-down.
+		for (int top = 0, bottom = images[0].height - 1; top < bottom; ++top, --bottom)
+		{
+			std::swap_ranges(pixels.begin() + (top * rowBytes), pixels.begin() + ((top + 1) * rowBytes), pixels.begin() + (bottom * rowBytes));
+		}
+		images[slice].pixels = pixels.data();
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+}
+#endif
+
+void TensorFlowTOP::benchmarkBatch(const Tensor& batch)
+{
+	// Runs the same images once as a batch and once one at a time, to show what batching buys on
+	// this machine and model.
+	const int count = static_cast<int>(batch.dim_size(0));
+	const size_t bytes = batch.TotalBytes() / count;
+
+	tensorflow::TensorShape shape = batch.shape();
+	shape.set_dim(0, 1);
+	std::vector<Tensor> images;
+	for (int i = 0; i < count; ++i)
+	{
+		images.emplace_back(AlignedAllocator::get(), batch.dtype(), shape);
+		std::memcpy(const_cast<char*>(images.back().tensor_data().data()), batch.tensor_data().data() + (i * bytes), bytes);
+	}
+
+	const int iterations = 10;
+	std::vector<Tensor> outputs;
+
+	// Runs each of `inputs` `iterations` times after an untimed first run (which sets up their shape),
+	// and returns the average time of one pass over them.
+	auto timeRuns = [&](const std::vector<Tensor>& inputs, double* averageMs) -> Status
+	{
+		TF_RETURN_IF_ERROR(session->Run({ { inputLayer, inputs[0] } }, { outputLayer }, {}, &outputs));
+		const auto start = PipelineClock::now();
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			for (const auto& input : inputs)
+			{
+				TF_RETURN_IF_ERROR(session->Run({ { inputLayer, input } }, { outputLayer }, {}, &outputs));
+			}
+		}
+		*averageMs = millisecondsSince(start) / iterations;
+		return Status::OK();
+	};
+
+	// Timings are only published once every run has succeeded, since a failed run returns early and
+	// would look like a fast one.
+	double separateMs;
+	double batchedMs;
+	bool succeeded = timeRuns(images, &separateMs).ok() && timeRuns({ batch }, &batchedMs).ok();
+
+	// How the cost of a run grows with the batch size. Slices from the start of the batch keep its alignment.
+	std::vector<std::pair<int, double>> sliceMs;
+	for (int size = 2; succeeded && size < count; size *= 2)
+	{
+		double ms;
+		succeeded = timeRuns({ batch.Slice(0, size) }, &ms).ok();
+		sliceMs.push_back({ size, ms });
+	}
+
+	if (!succeeded)
+	{
+		error = "Batch benchmark failed - check that the model accepts a variable batch size.";
+		return;
+	}
+
+	for (const auto& slice : sliceMs)
+	{
+		setInfoEntry("batched_ms_" + std::to_string(slice.first), std::to_string(slice.second));
+	}
+	setInfoEntry("batched_ms_1", std::to_string(separateMs / count));
+	setInfoEntry("batched_ms_" + std::to_string(count), std::to_string(batchedMs));
+
+	setInfoEntry("batch_size", std::to_string(count));
+	setInfoEntry("separate_ms", std::to_string(separateMs));
+	setInfoEntry("batched_ms", std::to_string(batchedMs));
+	setInfoEntry("separate_images_per_second", std::to_string(count * 1000.0 / separateMs));
+	setInfoEntry("batched_images_per_second", std::to_string(count * 1000.0 / batchedMs));
+	setInfoEntry("batch_speedup", std::to_string(separateMs / batchedMs));
+	setInfoEntry("batch_latency_vs_single", std::to_string(batchedMs * count / separateMs));
+}
+
+void TensorFlowTOP::benchmarkDetections(Suppression suppression, float overlap)
+{
+	// Decodes and suppresses synthetic SSD outputs with 1k, 10k and 50k anchors: 90 classes, one
+	// anchor in a hundred scoring above the threshold, and the candidates clustered ten to an object
+	// like a detector's. Every size is timed with at most 100 kept boxes, and with no limit.
+	const int iterations = 5;
+	const float threshold = 0.5f;
+	const int classes = 91;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+	for (int count : { 1000, 10000, 50000 })
+	{
+		Anchors anchors;
+		Tensor encodings(tensorflow::DT_FLOAT, tensorflow::TensorShape({ 1, count, 4 }));
+		Tensor logits(tensorflow::DT_FLOAT, tensorflow::TensorShape({ 1, count, classes }));
+		float* codes = encodings.flat<float>().data();
+		float* classLogits = logits.flat<float>().data();
+		for (int i = 0; i < count; ++i)
+		{
+			if (i % 10 == 0)
+			{
+				const float size = 0.05f + 0.2f * unit(random);
+				anchors.y.push_back(unit(random));
+				anchors.x.push_back(unit(random));
+				anchors.height.push_back(size);
+				anchors.width.push_back(size);
+			}
+			else
+			{
+				anchors.y.push_back(anchors.y.back());
+				anchors.x.push_back(anchors.x.back());
+				anchors.height.push_back(anchors.height.back());
+				anchors.width.push_back(anchors.width.back());
+			}
+			for (int c = 0; c < 4; ++c)
+			{
+				codes[i * 4 + c] = jitter(random);
+			}
+
+			// A logit of 0 is a score of 0.5, so about one anchor in a hundred passes.
+			for (int c = 0; c < classes; ++c)
+			{
+				classLogits[static_cast<size_t>(i) * classes + c] = -4.0f * unit(random) - 0.01f;
+			}
+			if (unit(random) < 0.01f)
+			{
+				classLogits[static_cast<size_t>(i) * classes + 1 + i % (classes - 1)] = 3.0f * unit(random);
+			}
+		}
+
+		decodeSsd(encodings, logits, anchors, threshold, &boxCandidates);
+		const auto decodeStart = PipelineClock::now();
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			decodeSsd(encodings, logits, anchors, threshold, &boxCandidates);
+		}
+		const double decodeMs = millisecondsSince(decodeStart) / iterations;
+
+		// The suppression itself is timed on all of the anchors, as if none were thresholded away.
+		BoxCandidates all;
+		for (int i = 0; i < count; ++i)
+		{
+			all.add(anchors.y[i] - anchors.height[i] * 0.5f, anchors.x[i] - anchors.width[i] * 0.5f,
+					anchors.y[i] + anchors.height[i] * 0.5f + 0.01f * jitter(random), anchors.x[i] + anchors.width[i] * 0.5f + 0.01f * jitter(random), unit(random), 0);
+		}
+
+		// Soft-NMS drops boxes once they score below the threshold. The first run isn't timed.
+		std::vector<Detection> kept;
+		suppressOverlaps(all, suppression, overlap, threshold, 100, &kept);
+		const auto limitedStart = PipelineClock::now();
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			suppressOverlaps(all, suppression, overlap, threshold, 100, &kept);
+		}
+		const double limitedMs = millisecondsSince(limitedStart) / iterations;
+
+		const auto unlimitedStart = PipelineClock::now();
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			suppressOverlaps(all, suppression, overlap, threshold, all.size(), &kept);
+		}
+		const double unlimitedMs = millisecondsSince(unlimitedStart) / iterations;
+
+		const std::string prefix = "detections_" + std::to_string(count) + "_";
+		setInfoEntry(prefix + "candidates", std::to_string(boxCandidates.size()));
+		setInfoEntry(prefix + "decode_ms", std::to_string(decodeMs));
+		setInfoEntry(prefix + "nms_100_ms", std::to_string(limitedMs));
+		setInfoEntry(prefix + "nms_all_ms", std::to_string(unlimitedMs));
+		setInfoEntry(prefix + "nms_all_kept", std::to_string(kept.size()));
+	}
+	setInfoEntry("detections_nms", suppression == Suppression::Linear ? "soft (linear)" : "greedy");
+}
+
+void TensorFlowTOP::handleOutputs(const std::vector<Tensor>& outputs, bool labelled)
+{
+	// Held until the next inference completes.
+	latestOutputs = outputs;
+	outputPending = true;
+
+	// Image outputs are uploaded and drawn by `renderOutput()`.
+	if (imageOutput)
+	{
+		return;
+	}
+
+	// Only classifier-shaped outputs have a top class to report.
+	const Tensor& tensor = outputs[0];
+	if (tensor.dtype() != tensorflow::DT_FLOAT || tensor.NumElements() == 0)
+	{
+		return;
+	}
+
+	// Grab the index of the class with the highest score.
+	Eigen::Map<const Eigen::VectorXf> pred(tensor.flat<float>().data(), tensor.NumElements());
+	int maxIndex;
+	float maxValue = pred.maxCoeff(&maxIndex);
+	setInfoChannel("top_class", static_cast<float>(maxIndex));
+	setInfoChannel("top_score", maxValue);
+
+	// Only the full model's classes are labelled, and only as far as there are labels.
+	const int labelCount = static_cast<int>(sizeof(classNames) / sizeof(classNames[0]));
+	if (labelled && maxIndex < labelCount)
+	{
+		setInfoEntry("top_label", classNames[maxIndex]);
+	}
+	else
+	{
+		setInfoEntry("top_label", std::to_string(maxIndex));
+	}
+}
+
+void TensorFlowTOP::renderOutput(const TOP_OutputFormatSpecs* outputFormat, OP_Inputs* inputs, TOP_Context* context)
+{
+	// Parameters have to be read before any GL commands are issued.
+	const int colormap = inputs->getParInt("Colormap");
+	const bool halfPrecision = inputs->getParInt("Outputprecision") == 1;
+	const float gain = static_cast<float>(inputs->getParDouble("Outputgain"));
+	const float offset = static_cast<float>(inputs->getParDouble("Outputoffset"));
+
+	context->beginGLCommands();
+	{
+		if (outputPending && !latestOutputs.empty())
+		{
+			outputPending = false;
+			if (!tensorTexture.upload(latestOutputs[0], halfPrecision, textures))
+			{
+				error = "Image output expects a [1, height, width, channels] float tensor.";
+			}
+		}
+
+		if (tensorTexture.texture() != 0)
+		{
+			glViewport(0, 0, outputFormat->width, outputFormat->height);
+
+			glBindTextureUnit(0, tensorTexture.texture());
+
+			glUseProgram(outputProgram);
+			glProgramUniform1i(outputProgram, 0, colormap);
+			glProgramUniform1f(outputProgram, 1, gain);
+			glProgramUniform1f(outputProgram, 2, offset);
+			glProgramUniform1i(outputProgram, 3, tensorTexture.channels());
+
+			glBindVertexArray(vao);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		}
+	}
+	context->endGLCommands();
+}
+
+#ifdef TENSORFLOW_TOP_CPU_OUTPUT
+void TensorFlowTOP::writeCpuOutput(const TOP_OutputFormatSpecs* outputFormat, OP_Inputs* inputs)
+{
+	// The previous frame stays on screen until there's a new result to show.
+	if (!outputPending || latestOutputs.empty())
+	{
+		return;
+	}
+
+	// The renderer holds its own reference to the tensor, since it runs after `execute()` returns.
+	const Tensor output = latestOutputs[0];
+	CpuFrameWriter::Renderer render;
+	if (imageOutput)
+	{
+		if (output.dtype() != tensorflow::DT_FLOAT || output.dims() != 4 || output.dim_size(0) != 1)
+		{
+			error = "Image output expects a [1, height, width, channels] float tensor.";
+			outputPending = false;
+			return;
+		}
+
+		ImageStyle style;
+		style.colormap = inputs->getParInt("Colormap");
+		style.gain = static_cast<float>(inputs->getParDouble("Outputgain"));
+		style.offset = static_cast<float>(inputs->getParDouble("Outputoffset"));
+
+		render = [output, style](uint8_t* pixels, int width, int height)
+		{
+			drawTensorImage(output, style, pixels, width, height);
+		};
+	}
+	else
+	{
+		render = [output](uint8_t* pixels, int width, int height)
+		{
+			drawScoreBars(output.flat<float>().data(), static_cast<size_t>(output.NumElements()), 10, pixels, width, height);
+		};
+	}
+
+	if (cpuWriter.start(outputFormat, render))
+	{
+		outputPending = false;
+	}
+}
+#endif
+
+void TensorFlowTOP::startPipeline(size_t depth, bool latestWins)
+{
+	// The preprocessing stage writes into the input tensor ring from its own thread, so the ring needs
+	// one tensor for every frame that can be queued for (or running) inference, plus the one being written.
+	inputTensors.reserve(modelInput.shape(expectedDims, expectedDims), depth + 2, modelInput.type);
+
+	auto preprocess = [this](Frame* frame) -> Status
+	{
+		frame->input = inputTensors.next();
+		return convertPixelsToTensor(&frame->input, frame->pixels.data(), frame->width, frame->height, frame->format);
+	};
+
+	auto inference = [this](Frame* frame) -> Status
+	{
+		return session->Run({ { inputLayer, frame->input } }, { outputLayer }, {}, &frame->outputs);
+	};
+
+	pipeline.start(depth, latestWins, preprocess, inference);
+	lastStatsUpdate = PipelineClock::now();
+
+	// The first delayed download after a (re)start returns pixels that were requested before the
+	// pipeline existed, possibly long ago, so there's no request time to measure its latency from.
+	lastReadbackRequest = PipelineClock::time_point();
+}
+
+void TensorFlowTOP::updatePipelineChannels()
+{
+	// Averaging over about a second keeps the channels readable.
+	const auto now = PipelineClock::now();
+	if (now - lastStatsUpdate < std::chrono::seconds(1))
+	{
+		return;
+	}
+	lastStatsUpdate = now;
+
+	const PipelineStats stats = pipeline.stats();
+	setInfoChannel("pipeline_fps", static_cast<float>(stats.fps));
+	setInfoChannel("readback_occupancy", static_cast<float>(stats.readbackOccupancy));
+	setInfoChannel("preprocess_occupancy", static_cast<float>(stats.preprocessOccupancy));
+	setInfoChannel("inference_occupancy", static_cast<float>(stats.inferenceOccupancy));
+	setInfoChannel("latency_ms", static_cast<float>(stats.latencyMs));
+	setInfoChannel("dropped_frames", static_cast<float>(stats.droppedFrames));
+	setInfoChannel("stale_frames", static_cast<float>(stats.staleFrames));
+}
+
+void TensorFlowTOP::setInfoChannel(const std::string& name, float value)
+{
+	for (auto& channel : infoChannels)
+	{
+		if (channel.first == name)
+		{
+			channel.second = value;
+			return;
+		}
+	}
+	infoChannels.push_back({ name, value });
+}
+
+void TensorFlowTOP::setInfoEntry(const std::string& name, const std::string& value)
+{
+	for (auto& entry : infoEntries)
+	{
+		if (entry.first == name)
+		{
+			entry.second = value;
+			return;
+		}
+	}
+	infoEntries.push_back({ name, value });
+}
+
+void TensorFlowTOP::removeInfoChannels(const std::string& prefix)
+{
+	// Removes the numbered groups of channels (`box0_x`, `box1_x`, ...) that start with the prefix.
+	const size_t length = prefix.size();
+	infoChannels.erase(std::remove_if(infoChannels.begin(), infoChannels.end(), [&prefix, length](const std::pair<std::string, float>& channel)
+	{
+		return channel.first.compare(0, length, prefix) == 0 && channel.first.size() > length && std::isdigit(static_cast<unsigned char>(channel.first[length]));
+	}), infoChannels.end());
+}
+
+void TensorFlowTOP::setBoxChannels(const std::vector<Box>& boxes, const std::vector<float>& scores, const std::string& scoreName)
+{
+	// Every box gets a group of channels (`box0_x`, `box0_y`, `box0_w`, `box0_h` and its score). The
+	// groups of boxes that went away are removed.
+	if (boxes.size() != boxChannels)
+	{
+		removeInfoChannels("box");
+		boxChannels = boxes.size();
+	}
+	for (size_t i = 0; i < boxes.size(); ++i)
+	{
+		const std::string prefix = "box" + std::to_string(i) + "_";
+		setInfoChannel(prefix + "x", boxes[i].x);
+		setInfoChannel(prefix + "y", boxes[i].y);
+		setInfoChannel(prefix + "w", boxes[i].width);
+		setInfoChannel(prefix + "h", boxes[i].height);
+		setInfoChannel(prefix + scoreName, scores[i]);
+	}
+}
+
+int32_t TensorFlowTOP::getNumInfoCHOPChans()
+{
+	return static_cast<int32_t>(infoChannels.size());
+}
+
+void TensorFlowTOP::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan)
+{
+	// The names are owned by `infoChannels`, which outlives this call.
+	chan->name = infoChannels[index].first.c_str();
+	chan->value = infoChannels[index].second;
+}
+
+bool TensorFlowTOP::getInfoDATSize(OP_InfoDATSize* infoSize)
+{
+	infoSize->rows = static_cast<int32_t>(infoEntries.size());
+	infoSize->cols = 2;
+	infoSize->byColumn = false;
+	return true;
+}
+
+void TensorFlowTOP::getInfoDATEntries(int32_t index, int32_t nEntries, OP_InfoDATEntries* entries)
+{
+	// The strings are owned by `infoEntries`, which outlives this call.
+	entries->values[0] = const_cast<char*>(infoEntries[index].first.c_str());
+	entries->values[1] = const_cast<char*>(infoEntries[index].second.c_str());
+}
+
+void TensorFlowTOP::setupParameters(OP_ParameterManager* manager)
+{
+	// A filepath parameter for loading custom models.
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "models/inception.pb";
+		sp.name = "Modelpath";
+		sp.label = "Model Path";
+
+		OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Rewrites the graph to run eight-bit quantized kernels on the CPU (applied when the model is loaded).
+	{
+		OP_NumericParameter np;
+		np.name = "Quantize";
+		np.label = "Quantize";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// A folder of sample images, used to calibrate the quantized graph and to evaluate it.
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "samples";
+		sp.name = "Calibrationfolder";
+		sp.label = "Calibration Folder";
+
+		OP_ParAppendResult res = manager->appendFolder(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Runs a small, fast model first, and the model above only when the small one isn't sure.
+	{
+		OP_NumericParameter np;
+		np.name = "Cascade";
+		np.label = "Cascade";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "models/mobilenet.pb";
+		sp.name = "Cascademodel";
+		sp.label = "Cascade Model Path";
+
+		OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The small model's input and output layers, and its input size.
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "input";
+		sp.name = "Cascadeinput";
+		sp.label = "Cascade Input Layer";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "MobilenetV1/Predictions/Reshape_1";
+		sp.name = "Cascadeoutput";
+		sp.label = "Cascade Output Layer";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+		np.name = "Cascadesize";
+		np.label = "Cascade Input Size";
+		np.defaultValues[0] = 224;
+		np.minSliders[0] = 32;
+		np.maxSliders[0] = 512;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The full model runs when the small model's two best scores are closer than this.
+	{
+		OP_NumericParameter np;
+		np.name = "Cascademargin";
+		np.label = "Cascade Margin";
+		np.defaultValues[0] = 0.2;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1.0;
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 1.0;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The order of the color channels that the model was trained on.
+	{
+		OP_StringParameter sp;
+		sp.name = "Channelorder";
+		sp.label = "Channel Order";
+		sp.defaultValue = "RGB";
+
+		const char* names[] = { "RGB", "BGR" };
+		const char* labels[] = { "RGB", "BGR" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 2, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// How pixel values are mapped to float inputs: (value - 128) / 128, value / 255, or 0-255 as is.
+	{
+		OP_StringParameter sp;
+		sp.name = "Normalization";
+		sp.label = "Normalization";
+		sp.defaultValue = "Centered";
+
+		const char* names[] = { "Centered", "Unit", "Raw" };
+		const char* labels[] = { "Centered (-1 to 1)", "Unit (0 to 1)", "Raw (0 to 255)" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Overlaps readback, preprocessing and inference across frames, trading latency for throughput.
+	{
+		OP_NumericParameter np;
+		np.name = "Pipeline";
+		np.label = "Pipeline";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The number of frames that can be queued between pipeline stages.
+	{
+		OP_NumericParameter np;
+		np.name = "Pipelinedepth";
+		np.label = "Pipeline Depth";
+		np.defaultValues[0] = 1;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 4;
+		np.minValues[0] = 1;
+		np.maxValues[0] = 8;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// When the pipeline falls behind, replace the oldest queued frame instead of dropping the newest one.
+	{
+		OP_NumericParameter np;
+		np.name = "Latestwins";
+		np.label = "Latest Frame Wins";
+		np.defaultValues[0] = 1.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Runs the model less often when the node exceeds its frame budget.
+	{
+		OP_NumericParameter np;
+		np.name = "Governor";
+		np.label = "Frame Budget Governor";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The target time per cook in milliseconds (16.6 ms is 60 fps).
+	{
+		OP_NumericParameter np;
+		np.name = "Framebudget";
+		np.label = "Frame Budget (ms)";
+		np.defaultValues[0] = 16.6;
+		np.minSliders[0] = 1.0;
+		np.maxSliders[0] = 100.0;
+		np.minValues[0] = 1.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The governor never skips more than this many frames between inferences.
+	{
+		OP_NumericParameter np;
+		np.name = "Maxdecimation";
+		np.label = "Max Decimation";
+		np.defaultValues[0] = 8;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 30;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Picks the input resolution from the ladder below based on inference time (fully convolutional models only).
+	{
+		OP_NumericParameter np;
+		np.name = "Adaptiveresolution";
+		np.label = "Adaptive Resolution";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The input resolutions to choose from, e.g. "224 299 384".
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "224 299 384";
+		sp.name = "Resolutionladder";
+		sp.label = "Resolution Ladder";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Feeds models with dynamic input dimensions at whichever of the buckets below fits the input best.
+	{
+		OP_NumericParameter np;
+		np.name = "Shapebuckets";
+		np.label = "Shape Buckets";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The input sizes to choose from, e.g. "320x180 640x360 1280x720".
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "320x180 640x360 1280x720";
+		sp.name = "Buckets";
+		sp.label = "Buckets";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Whether the model classifies its input or produces an image (e.g. style transfer or segmentation).
+	{
+		OP_StringParameter sp;
+		sp.name = "Outputmode";
+		sp.label = "Output Mode";
+		sp.defaultValue = "Classify";
+
+		const char* names[] = { "Classify", "Image" };
+		const char* labels[] = { "Classify", "Image" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 2, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// How image outputs are mapped to colors: channels as RGBA, the first channel through a heat ramp,
+	// or class indices through a palette (outputs with more than four channels are reduced to the
+	// index of their highest-scoring channel).
+	{
+		OP_StringParameter sp;
+		sp.name = "Colormap";
+		sp.label = "Colormap";
+		sp.defaultValue = "Channels";
+
+		const char* names[] = { "Channels", "Heat", "Classes" };
+		const char* labels[] = { "Channels", "Heat", "Classes" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Half-float textures halve the upload bandwidth.
+	{
+		OP_StringParameter sp;
+		sp.name = "Outputprecision";
+		sp.label = "Output Precision";
+		sp.defaultValue = "Float32";
+
+		const char* names[] = { "Float32", "Float16" };
+		const char* labels[] = { "32-bit Float", "16-bit Float" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 2, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Image outputs are drawn as `value * gain + offset`, e.g. a gain of 1/255 for models that output 0-255.
+	{
+		OP_NumericParameter np;
+		np.name = "Outputgain";
+		np.label = "Output Gain";
+		np.defaultValues[0] = 1.0;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 2.0;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+		np.name = "Outputoffset";
+		np.label = "Output Offset";
+		np.defaultValues[0] = 0.0;
+		np.minSliders[0] = -1.0;
+		np.maxSliders[0] = 1.0;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Warps image outputs along the input's optical flow on frames that don't run the model.
+	{
+		OP_NumericParameter np;
+		np.name = "Flowpropagation";
+		np.label = "Propagate With Flow";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The width of the gray copies that the flow is estimated on.
+	{
+		OP_NumericParameter np;
+		np.name = "Flowresolution";
+		np.label = "Flow Resolution";
+		np.defaultValues[0] = 320;
+		np.minSliders[0] = 80;
+		np.maxSliders[0] = 640;
+		np.minValues[0] = 32;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Pyramid levels of the flow estimate: every level doubles the motion that can be followed.
+	{
+		OP_NumericParameter np;
+		np.name = "Flowlevels";
+		np.label = "Flow Levels";
+		np.defaultValues[0] = 3;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 5;
+		np.minValues[0] = 1;
+		np.maxValues[0] = 5;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Images to compare the float and quantized graphs on. If this is the calibration folder, its
+	// images are split between the two.
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "samples";
+		sp.name = "Evaluationfolder";
+		sp.label = "Evaluation Folder";
+
+		OP_ParAppendResult res = manager->appendFolder(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Compares the float and quantized graphs on the evaluation images (results go to the Info DAT).
+	{
+		OP_NumericParameter np;
+		np.name = "Evaluate";
+		np.label = "Evaluate Quantization";
+
+		OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Runs every connected input through the model at once (the model needs a variable batch size).
+	{
+		OP_NumericParameter np;
+		np.name = "Batchinputs";
+		np.label = "Batch Inputs";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// A CHOP with one sample per region of interest, and channels x, y, w and h (normalized). Each
+	// region is cropped and classified on its own, in one batch.
+	{
+		OP_StringParameter sp;
+		sp.name = "Boxes";
+		sp.label = "Boxes CHOP";
+
+		OP_ParAppendResult res = manager->appendCHOP(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Finds the boxes with a detection model instead, which are then classified by the model above.
+	{
+		OP_NumericParameter np;
+		np.name = "Detect";
+		np.label = "Detect Boxes";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "models/ssd_mobilenet.pb";
+		sp.name = "Detectormodel";
+		sp.label = "Detector Model Path";
+
+		OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The detector's layers, named as in TensorFlow's object detection models. The classes are
+	// optional, when the scores have one column per class.
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "image_tensor";
+		sp.name = "Detectorinput";
+		sp.label = "Detector Input Layer";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "detection_boxes";
+		sp.name = "Detectorboxes";
+		sp.label = "Detector Boxes Layer";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "detection_scores";
+		sp.name = "Detectorscores";
+		sp.label = "Detector Scores Layer";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "detection_classes";
+		sp.name = "Detectorclasses";
+		sp.label = "Detector Classes Layer";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Whether the detector's boxes are decoded already, or still have to be decoded from SSD anchors
+	// (the boxes and scores layers are the raw box encodings and class predictions) or from a YOLO
+	// region layer (the boxes layer).
+	{
+		OP_StringParameter sp;
+		sp.name = "Detectordecoding";
+		sp.label = "Detector Decoding";
+		sp.defaultValue = "Decoded";
+
+		const char* names[] = { "Decoded", "Ssd", "Yolo" };
+		const char* labels[] = { "Decoded", "SSD Anchors", "YOLO Region" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The cells across each of the SSD's feature maps, from the finest.
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "19 10 5 3 2 1";
+		sp.name = "Ssdgrids";
+		sp.label = "SSD Grids";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The width and height of each YOLO anchor, in grid cells (the defaults are Tiny YOLO VOC's).
+	{
+		OP_StringParameter sp;
+		sp.defaultValue = "1.08,1.19, 3.42,4.41, 6.63,11.38, 9.42,5.11, 16.62,10.52";
+		sp.name = "Yoloanchors";
+		sp.label = "YOLO Anchors";
+
+		OP_ParAppendResult res = manager->appendString(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+		np.name = "Detectorsize";
+		np.label = "Detector Input Size";
+		np.defaultValues[0] = 300;
+		np.minSliders[0] = 32;
+		np.maxSliders[0] = 1024;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Boxes scoring below the threshold are dropped, and of boxes that overlap by more than the
+	// overlap (intersection over union), only the best is kept.
+	{
+		OP_NumericParameter np;
+		np.name = "Detectthreshold";
+		np.label = "Detection Threshold";
+		np.defaultValues[0] = 0.5;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1.0;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+		np.name = "Detectoverlap";
+		np.label = "Detection Overlap";
+		np.defaultValues[0] = 0.5;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1.0;
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 1.0;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Overlapping boxes are either dropped, or scored down by their overlap (soft-NMS).
+	{
+		OP_StringParameter sp;
+		sp.name = "Detectnms";
+		sp.label = "Suppression";
+		sp.defaultValue = "Greedy";
+
+		const char* names[] = { "Greedy", "Soft" };
+		const char* labels[] = { "Greedy", "Soft-NMS (Linear)" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 2, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+		np.name = "Detectmax";
+		np.label = "Max Detections";
+		np.defaultValues[0] = 10;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 100;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The number of best classes reported per input.
+	{
+		OP_NumericParameter np;
+		np.name = "Topk";
+		np.label = "Top K";
+		np.defaultValues[0] = 3;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 10;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Splits the input into overlapping model-sized tiles and classifies each of them.
+	{
+		OP_NumericParameter np;
+		np.name = "Tiled";
+		np.label = "Tiled";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The size of a tile in input pixels (each tile is resized to the model's input size).
+	{
+		OP_NumericParameter np;
+		np.name = "Tilesize";
+		np.label = "Tile Size";
+		np.defaultValues[0] = 299;
+		np.minSliders[0] = 64;
+		np.maxSliders[0] = 1024;
+		np.minValues[0] = 16;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Only runs tiles whose content changed since they were last classified (for mostly static scenes).
+	{
+		OP_NumericParameter np;
+		np.name = "Tilechanges";
+		np.label = "Only Changed Tiles";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// How far (0-1) any part of a tile has to change before the tile is classified again.
+	{
+		OP_NumericParameter np;
+		np.name = "Tilethreshold";
+		np.label = "Tile Change Threshold";
+		np.defaultValues[0] = 0.02;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 0.2;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The fraction of a tile that overlaps with its neighbors.
+	{
+		OP_NumericParameter np;
+		np.name = "Tileoverlap";
+		np.label = "Tile Overlap";
+		np.defaultValues[0] = 0.25;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 0.9;
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 0.9;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The most tiles that go through the model in one run.
+	{
+		OP_NumericParameter np;
+		np.name = "Tilebatch";
+		np.label = "Max Tile Batch";
+		np.defaultValues[0] = 16;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 64;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Classifies a pyramid of center and corner crops of the input in one batch, and combines the scores.
+	{
+		OP_NumericParameter np;
+		np.name = "Pyramid";
+		np.label = "Pyramid";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The number of pyramid levels: the whole frame, then center and corner crops at half the size per level.
+	{
+		OP_NumericParameter np;
+		np.name = "Pyramidlevels";
+		np.label = "Pyramid Levels";
+		np.defaultValues[0] = 2;
+		np.minSliders[0] = 2;
+		np.maxSliders[0] = 4;
+		np.minValues[0] = 2;
+		np.maxValues[0] = 4;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// How the scores of the pyramid's crops are combined.
+	{
+		OP_StringParameter sp;
+		sp.name = "Pyramidaggregate";
+		sp.label = "Pyramid Aggregate";
+		sp.defaultValue = "Max";
+
+		const char* names[] = { "Max", "Mean" };
+		const char* labels[] = { "Max", "Mean" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 2, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Test-time augmentation: classifies the center and corner crops of the input (and their mirrored
+	// copies) in one batch, and averages the scores.
+	{
+		OP_NumericParameter np;
+		np.name = "Augment";
+		np.label = "Test-Time Augmentation";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The size of the augmentation crops, relative to the input (224 of 256 pixels is the usual choice).
+	{
+		OP_NumericParameter np;
+		np.name = "Augmentcrop";
+		np.label = "Augment Crop Size";
+		np.defaultValues[0] = 0.875;
+		np.minSliders[0] = 0.5;
+		np.maxSliders[0] = 1.0;
+		np.minValues[0] = 0.1;
+		np.maxValues[0] = 1.0;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter np;
+		np.name = "Augmentflip";
+		np.label = "Augment Flip";
+		np.defaultValues[0] = 1.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Runs the model on keyframes only, and tracks the boxes of the Boxes CHOP in between.
+	{
+		OP_NumericParameter np;
+		np.name = "Keyframes";
+		np.label = "Track Between Keyframes";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The longest run of frames without a keyframe.
+	{
+		OP_NumericParameter np;
+		np.name = "Keyframeinterval";
+		np.label = "Keyframe Interval";
+		np.defaultValues[0] = 10;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 60;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// A keyframe follows any frame on which a box matched its patch worse than this (0-1).
+	{
+		OP_NumericParameter np;
+		np.name = "Trackconfidence";
+		np.label = "Track Confidence";
+		np.defaultValues[0] = 0.6;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1.0;
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 1.0;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The width of the gray copy that boxes are tracked in.
+	{
+		OP_NumericParameter np;
+		np.name = "Trackresolution";
+		np.label = "Track Resolution";
+		np.defaultValues[0] = 320;
+		np.minSliders[0] = 80;
+		np.maxSliders[0] = 640;
+		np.minValues[0] = 32;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// How far (in pixels of the gray copy) a box can move from one frame to the next.
+	{
+		OP_NumericParameter np;
+		np.name = "Tracksearch";
+		np.label = "Track Search Radius";
+		np.defaultValues[0] = 8;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 32;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Times the current batch against running its images one at a time, into the Info DAT.
+	{
+		OP_NumericParameter np;
+		np.name = "Benchmark";
+		np.label = "Benchmark Batching";
+
+		OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Times box decoding and suppression on 1k, 10k and 50k synthetic boxes, into the Info DAT.
+	{
+		OP_NumericParameter np;
+		np.name = "Benchmarkdetections";
+		np.label = "Benchmark Detections";
+
+		OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+}
+
+void TensorFlowTOP::pulsePressed(const char* name)
+{
+	if (std::string(name) == "Evaluate")
+	{
+		evaluatePending = true;
+	}
+	else if (std::string(name) == "Benchmark")
+	{
+		benchmarkPending = true;
+	}
+	else if (std::string(name) == "Benchmarkdetections")
+	{
+		detectionBenchmarkPending = true;
+	}
+}
+
+const char* TensorFlowTOP::getWarningString()
+{
+	return warningMessage.empty() ? nullptr : warningMessage.c_str();
+}
+
+const char* TensorFlowTOP::getErrorString()
+{
+	return error;
+}
\ No newline at end of file
@@ -10,13 +10,44 @@
 
 #include "TOP_CPlusPlusBase.h"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <initializer_list>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <utility>
 
+#include "Boxes.h"
+#include "BoxTracker.h"
+#include "CpuOutput.h"
+#include "DenseFlow.h"
+#include "Detections.h"
+#include "FrameGovernor.h"
+#include "FramePipeline.h"
+#include "GlResourcePool.h"
+#include "GrayImage.h"
+#include "InputTensorRing.h"
+#include "ModelCascade.h"
 #include "Names.h"
+#include "PixelConversion.h"
+#include "ProgramCache.h"
+#include "Quantization.h"
+#include "ResolutionLadder.h"
 #include "Shaders.h"
+#include "ShapeBuckets.h"
+#include "TensorTexture.h"
+#include "TileFingerprint.h"
+#include "TileGrid.h"
 
 #include "tensorflow/cc/ops/const_op.h"
 #include "tensorflow/cc/ops/image_ops.h"
@@ -31,6 +62,7 @@
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/public/session.h"
@@ -57,34 +89,220 @@ public:
 	virtual void getInfoDATEntries(int32_t index, int32_t nEntries, OP_InfoDATEntries *entries) override;
 	virtual void setupParameters(OP_ParameterManager *manager) override;
 	virtual void pulsePressed(const char *name) override;
-	//virtual const char* getErrorString() override;
+	virtual const char* getWarningString() override;
+	virtual const char* getErrorString() override;
 
 private:
 
-	Status convertPixelsToTensor(std::vector<Tensor>* out_tensors,
-								 uint8_t* pixels,
+	Status convertPixelsToTensor(Tensor* out_tensor,
+								 const void* pixels,
 								 int pixels_width,
 								 int pixels_height,
-								 int pixels_channels,
-								 const int expected_height,
-								 const int expected_width,
-								 const int expected_channels = 3,
-								 const float expected_mean = 128,
-								 const float expected_standard_dev = 128);
-
-	GLuint createGlslProgram(const std::string& vertSrc, const std::string& fragSrc);
-	void loadModel(const std::string& path);
-	void allocateFbo();
-	void allocateTextures();
+								 PixelFormat pixels_format);
+
+	Status letterboxPixelsToTensor(Tensor* out_tensor,
+								   const Letterbox& region,
+								   const void* pixels,
+								   int pixels_width,
+								   int pixels_height,
+								   PixelFormat pixels_format);
+
+	// The layout to download the input TOP in, given its texture format and the model's input.
+	PixelFormat downloadFormat(const OP_TOPInput* topInput) const;
+
+	void cookModel(OP_Inputs* inputs, TOP_Context* context);
+	void renderOutput(const TOP_OutputFormatSpecs* outputFormat, OP_Inputs* inputs, TOP_Context* context);
+#ifdef TENSORFLOW_TOP_CPU_OUTPUT
+	void writeCpuOutput(const TOP_OutputFormatSpecs* outputFormat, OP_Inputs* inputs);
+#endif
+	// A second model that runs next to the main one, with its own session and input (but the main
+	// model's channel order and normalization).
+	struct AuxiliaryModel
+	{
+		std::unique_ptr<tensorflow::Session> session;
+		std::string path;
+		std::string inputLayer;
+		InputFormat input;
+		PixelConverter converter;
+		InputTensorRing tensors;
+
+		// Why the model failed to load, if it did.
+		std::string loadError;
+	};
+
+	void loadModel(const std::string& path, bool quantize, const std::string& calibrationFolder, const std::string& evaluationFolder);
+	void loadAuxiliaryModel(const std::string& path, const std::string& inputLayer, const std::string& description, AuxiliaryModel* model);
+	void evaluateQuantization(const std::string& calibrationFolder, const std::string& evaluationFolder);
+	double runSynchronous(OP_Inputs* inputs,
+						  const OP_TOPInput* topInput,
+						  const ShapeBuckets::Size& size,
+						  const Letterbox& region,
+						  InputTensorRing& ring);
+	// An image of a batch, as downloaded.
+	struct BatchImage
+	{
+		const void* pixels;
+		int width;
+		int height;
+		PixelFormat format;
+	};
+
+	// A crop of an image of the batch, optionally mirrored.
+	struct BatchItem
+	{
+		size_t image;
+		Letterbox crop;
+		bool mirror;
+	};
+
+	// How the results of several crops of one image are combined.
+	enum class Aggregation
+	{
+		None,
+		Max,
+		Mean
+	};
+
+	// Runs all inputs (and their crops) as one batch. `firstImage` receives the first downloaded image.
+	double runBatch(OP_Inputs* inputs,
+					TOP_Context* context,
+					const std::vector<Box>& boxes,
+					bool mirror,
+					Aggregation aggregation,
+					int topK,
+					BatchImage* firstImage = nullptr);
+	double classifyBatch(const std::vector<BatchImage>& batch, const std::vector<Box>& boxes, bool mirror, Aggregation aggregation, int topK);
+	// Tracks boxes between keyframes. On keyframes, the boxes are classified (`boxes`, from the CHOP)
+	// or found by the detector and then classified (`detect`).
+	double trackBoxes(OP_Inputs* inputs, TOP_Context* context, const OP_TOPInput* topInput, const std::vector<Box>& boxes, bool detect, int topK);
+#ifndef TENSORFLOW_TOP_CPU_OUTPUT
+	void downloadSlices(const OP_TOPInput* topInput, BatchImage* images, size_t* buffer);
+#endif
+	void benchmarkBatch(const Tensor& batch);
+	void benchmarkDetections(Suppression suppression, float overlap);
+	double runTiled(OP_Inputs* inputs, const OP_TOPInput* topInput);
+	double runCascade(OP_Inputs* inputs, const OP_TOPInput* topInput);
+	// Detects boxes and classifies them. The boxes and the download they were found in can be returned.
+	double runDetection(OP_Inputs* inputs, const OP_TOPInput* topInput, int topK, std::vector<Box>* detectedBoxes = nullptr, BatchImage* downloaded = nullptr);
+	tensorflow::thread::ThreadPool* preprocessThreads();
+	void warmInputShapes(const std::vector<ShapeBuckets::Size>& sizes, const ShapeBuckets::Size& current);
+	// Warns about the mode toggles that are on but not `applied` on this cook's path through the model.
+	void warnIgnoredModes(OP_Inputs* inputs, const char* path, std::initializer_list<const char*> applied);
+	void handleOutputs(const std::vector<Tensor>& outputs, bool labelled = true);
+	void propagateOutput(OP_Inputs* inputs);
+	void startPipeline(size_t depth, bool latestWins);
+	void updatePipelineChannels();
+	void setInfoChannel(const std::string& name, float value);
+	void setInfoEntry(const std::string& name, const std::string& value);
+	void removeInfoChannels(const std::string& prefix);
+	void setBoxChannels(const std::vector<Box>& boxes, const std::vector<float>& scores, const std::string& scoreName);
+	void allocateTextures(GLsizei width, GLsizei height);
 
 	std::unique_ptr<tensorflow::Session> session;
+	InputTensorRing inputTensors;
+
+	// Cascade: a small model, which screens frames for the main model.
+	AuxiliaryModel cascadeModel;
+	ModelCascade cascade;
+
+	// Detection: a detector, whose boxes are cropped from the same readback and classified by the
+	// main model.
+	AuxiliaryModel detectorModel;
+	BoxCandidates boxCandidates;
+	Anchors detectorAnchors;
+	std::string detectorAnchorGrids;
+
+	// One `[N, height, width, channels]` tensor for all inputs, filled in parallel by the pool.
+	InputTensorRing batchTensors;
+	std::unique_ptr<tensorflow::thread::ThreadPool> preprocessPool;
+	std::vector<std::vector<uint8_t>> sliceBuffers;
+
+	// Tiled inference: the layout, one batch tensor per run, and the latest scores of every tile
+	// along with the fingerprint of the content they were computed from.
+	TileGrid tileGrid;
+	InputTensorRing tileTensors;
+	std::vector<std::vector<float>> tileScores;
+	std::vector<TileFingerprint> tileFingerprints;
+	PixelFormat tileFormat;
+
+	// Keyframes: boxes are classified by the model on keyframes and tracked in a gray copy of the
+	// input in between. `keyframeBoxes` are the CHOP's boxes as of the last keyframe, and
+	// `trackingDetections` tells whether the tracked boxes came from the detector instead.
+	BoxTracker tracker;
+	GrayImage trackFrame;
+	std::vector<Box> keyframeBoxes;
+	bool trackingDetections;
+	size_t boxChannels;
+	int framesSinceKeyframe;
+	float trackConfidence;
+	int batchChannels;
+	bool benchmarkPending;
+
+	// Flow propagation: the latest dense output is warped from the frame it was computed on (the key
+	// frame) onto later frames. Gray copies of pipelined frames wait for their results in `flowHistory`.
+	DenseFlow denseFlow;
+	GrayImage flowFrame;
+	GrayImage flowKeyFrame;
+	Tensor flowKeyOutput;
+	std::deque<std::pair<uint64_t, GrayImage>> flowHistory;
+	bool flowPropagation;
+
+	// Declared after the session, so that the worker threads are stopped before it is destroyed.
+	FramePipeline pipeline;
+	PipelineClock::time_point lastReadbackRequest;
+	PixelFormat pipelineFormat;
+	PipelineClock::time_point lastStatsUpdate;
+
+	FrameGovernor governor;
+	ResolutionLadder ladder;
+	ShapeBuckets buckets;
+
+	// Input tensors for each of the configured ladder or bucket sizes, and the ones that have been run once.
+	std::map<ShapeBuckets::Size, InputTensorRing> shapeTensors;
+	std::set<ShapeBuckets::Size> warmedShapes;
+	std::vector<Tensor> latestOutputs;
+	std::string modelPath;
+	std::string inputLayer;
+	std::string outputLayer;
+	int32 expectedDims;
+
+	// The model's input, read from its placeholder, and the kernels that convert pixels into it.
+	InputFormat modelInput;
+	PixelConverter converter;
+	bool modelQuantized;
+	std::string modelCalibrationFolder;
+	std::string modelEvaluationFolder;
+
+	// True if the loaded graph was extended with the nodes that combine the scores of several crops.
+	bool cropAggregationInGraph;
+	bool evaluatePending;
+	bool detectionBenchmarkPending;
+	std::vector<std::pair<std::string, std::string>> infoEntries;
+	std::vector<std::pair<std::string, float>> infoChannels;
 	GLuint program;
+	GLuint outputProgram;
 	GLuint vao;
+	GlResourcePool textures;
+	TensorTexture tensorTexture;
+	bool imageOutput;
+	bool outputPending;
+#ifdef TENSORFLOW_TOP_CPU_OUTPUT
+	CpuFrameWriter cpuWriter;
+#endif
 	GLuint fbo;
 	GLuint inputTexture;
 	GLuint outputTexture;
 	size_t inputWidth;
 	size_t inputHeight;
+	// The error shown on the node, which only lasts for the cook that set it, and the one from the
+	// last attempt to load the main model, which lasts until the next.
 	const char* error;
+	const char* modelError;
+
+	// Error messages that are put together at runtime, which `error` points into.
+	std::string errorMessage;
+
+	// The node's warning: the modes that are on but don't apply together with the one that runs.
+	std::string warningMessage;
 	bool runGraph;
 };
@@ -0,0 +1,193 @@
+#include "TensorTexture.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	// Texture formats for one to four channels.
+	const GLenum floatFormats[] = { GL_R32F, GL_RG32F, GL_RGBA32F, GL_RGBA32F };
+	const GLenum halfFormats[] = { GL_R16F, GL_RG16F, GL_RGBA16F, GL_RGBA16F };
+	const GLenum pixelFormats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+
+	// Writes the index of the highest-scoring channel of each pixel.
+	template <typename T>
+	void writeArgmax(const float* scores, size_t pixelCount, int channels, T* out)
+	{
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			const float* pixel = scores + i * channels;
+			int best = 0;
+			for (int c = 1; c < channels; ++c)
+			{
+				if (pixel[c] > pixel[best])
+				{
+					best = c;
+				}
+			}
+			out[i] = T(static_cast<float>(best));
+		}
+	}
+}
+
+TensorTexture::TensorTexture() :
+	bufferBytes(0),
+	nextBuffer(0),
+	currentTexture(0),
+	textureWidth(0),
+	textureHeight(0),
+	textureFormat(0),
+	textureChannels(0)
+{
+	for (int i = 0; i < bufferCount; ++i)
+	{
+		buffers[i] = 0;
+		mapped[i] = nullptr;
+		fences[i] = nullptr;
+	}
+}
+
+TensorTexture::~TensorTexture()
+{
+	// There might not be a current GL context at this point, so the owner has to call `release()`.
+	assert(currentTexture == 0 && bufferBytes == 0);
+}
+
+bool TensorTexture::upload(const tensorflow::Tensor& tensor, bool halfPrecision, GlResourcePool& pool)
+{
+	if (tensor.dtype() != tensorflow::DT_FLOAT || tensor.dims() != 4 || tensor.dim_size(0) != 1 || tensor.dim_size(3) < 1)
+	{
+		return false;
+	}
+
+	const GLsizei height = static_cast<GLsizei>(tensor.dim_size(1));
+	const GLsizei width = static_cast<GLsizei>(tensor.dim_size(2));
+	const int channels = static_cast<int>(tensor.dim_size(3));
+	const int uploadChannels = channels > 4 ? 1 : channels;
+	const GLenum internalFormat = (halfPrecision ? halfFormats : floatFormats)[uploadChannels - 1];
+
+	if (width != textureWidth || height != textureHeight || internalFormat != textureFormat)
+	{
+		pool.releaseTexture(currentTexture);
+		currentTexture = pool.acquireTexture(width, height, internalFormat);
+
+		// The output pass upscales with the texture unit's bilinear filtering.
+		glTextureParameteri(currentTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(currentTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		textureWidth = width;
+		textureHeight = height;
+		textureFormat = internalFormat;
+	}
+	textureChannels = uploadChannels;
+
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	const size_t componentBytes = halfPrecision ? sizeof(Eigen::half) : sizeof(float);
+	reserveBuffers(pixelCount * uploadChannels * componentBytes);
+
+	// Wait until the GPU is done with the previous upload from this buffer. With three buffers, that
+	// upload was issued two frames ago, so this almost never blocks.
+	const int index = nextBuffer;
+	nextBuffer = (nextBuffer + 1) % bufferCount;
+	if (fences[index])
+	{
+		glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fences[index]);
+		fences[index] = nullptr;
+	}
+
+	const float* source = tensor.flat<float>().data();
+	if (channels > 4)
+	{
+		if (halfPrecision)
+		{
+			writeArgmax(source, pixelCount, channels, static_cast<Eigen::half*>(mapped[index]));
+		}
+		else
+		{
+			writeArgmax(source, pixelCount, channels, static_cast<float*>(mapped[index]));
+		}
+	}
+	else if (halfPrecision)
+	{
+		Eigen::half* destination = static_cast<Eigen::half*>(mapped[index]);
+		const size_t count = pixelCount * channels;
+		for (size_t i = 0; i < count; ++i)
+		{
+			destination[i] = Eigen::half(source[i]);
+		}
+	}
+	else
+	{
+		std::memcpy(mapped[index], source, pixelCount * channels * sizeof(float));
+	}
+
+	// Rows of three-channel or half-float pixels aren't necessarily 4-byte aligned.
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[index]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(currentTexture, 0, 0, 0, width, height, pixelFormats[uploadChannels - 1], halfPrecision ? GL_HALF_FLOAT : GL_FLOAT, nullptr);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	return true;
+}
+
+void TensorTexture::release(GlResourcePool& pool)
+{
+	deleteBuffers();
+
+	pool.releaseTexture(currentTexture);
+	currentTexture = 0;
+	textureWidth = 0;
+	textureHeight = 0;
+	textureFormat = 0;
+	textureChannels = 0;
+}
+
+void TensorTexture::reserveBuffers(size_t bytes)
+{
+	if (bytes <= bufferBytes)
+	{
+		return;
+	}
+	deleteBuffers();
+
+	// Coherent, so writes through the mapping are visible to the GPU without an explicit flush.
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(bufferCount, buffers);
+	for (int i = 0; i < bufferCount; ++i)
+	{
+		glNamedBufferStorage(buffers[i], bytes, nullptr, flags);
+		mapped[i] = glMapNamedBufferRange(buffers[i], 0, bytes, flags);
+	}
+	bufferBytes = bytes;
+}
+
+void TensorTexture::deleteBuffers()
+{
+	if (bufferBytes == 0)
+	{
+		return;
+	}
+
+	for (int i = 0; i < bufferCount; ++i)
+	{
+		if (fences[i])
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = nullptr;
+		}
+		glUnmapNamedBuffer(buffers[i]);
+		mapped[i] = nullptr;
+	}
+	glDeleteBuffers(bufferCount, buffers);
+
+	for (int i = 0; i < bufferCount; ++i)
+	{
+		buffers[i] = 0;
+	}
+	bufferBytes = 0;
+	nextBuffer = 0;
+}
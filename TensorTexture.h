@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+#include "CPlusPlus_Common.h"
+#include "GlResourcePool.h"
+
+#include "tensorflow/core/framework/tensor.h"
+
+// Streams a `[1, height, width, channels]` float tensor (e.g. the output of a style transfer or
+// segmentation model) into a float texture. Uploads go through a ring of persistently mapped pixel
+// buffers: the tensor's data is copied straight into mapped memory (no staging copy, no conversion
+// for 32-bit textures) and the GPU pulls it into the texture asynchronously. A fence per buffer
+// makes sure that a buffer is only rewritten once the GPU has finished reading from it.
+//
+// Tensors with one, two or four channels map onto R, RG and RGBA textures, and three channels onto
+// an RGBA texture with an opaque alpha. Tensors with more channels (per-class scores) are reduced to
+// the index of their highest-scoring channel.
+//
+// All methods must be called while the owner's GL context is current.
+class TensorTexture
+{
+public:
+	TensorTexture();
+	~TensorTexture();
+
+	// Returns false if the tensor doesn't have the expected shape and type.
+	bool upload(const tensorflow::Tensor& tensor, bool halfPrecision, GlResourcePool& pool);
+
+	// Deletes the pixel buffers and hands the texture back to the pool.
+	void release(GlResourcePool& pool);
+
+	GLuint texture() const
+	{
+		return currentTexture;
+	}
+
+	// The number of channels in the texture (after reducing per-class scores).
+	int channels() const
+	{
+		return textureChannels;
+	}
+
+private:
+	static const int bufferCount = 3;
+
+	void reserveBuffers(size_t bytes);
+	void deleteBuffers();
+
+	GLuint buffers[bufferCount];
+	void* mapped[bufferCount];
+	GLsync fences[bufferCount];
+	size_t bufferBytes;
+	int nextBuffer;
+
+	GLuint currentTexture;
+	GLsizei textureWidth;
+	GLsizei textureHeight;
+	GLenum textureFormat;
+	int textureChannels;
+};
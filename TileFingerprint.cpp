@@ -0,0 +1,114 @@
+#include "TileFingerprint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TILE_FINGERPRINT_SSE2
+#endif
+
+namespace
+{
+	// Sums `count` bytes, 16 at a time. With `skipAlpha`, the bytes are BGRA pixels and every fourth
+	// one is left out.
+	uint64_t sumBytes(const uint8_t* data, size_t count, bool skipAlpha)
+	{
+		uint64_t sum = 0;
+		size_t i = 0;
+#ifdef TILE_FINGERPRINT_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i keep = _mm_set1_epi32(skipAlpha ? 0x00FFFFFF : -1);
+		__m128i sums = zero;
+		for (; i + 16 <= count; i += 16)
+		{
+			// Absolute differences against zero, summed into two 64-bit lanes.
+			const __m128i bytes = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), keep);
+			sums = _mm_add_epi64(sums, _mm_sad_epu8(bytes, zero));
+		}
+		uint64_t lanes[2];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+		sum = lanes[0] + lanes[1];
+#endif
+		for (; i < count; ++i)
+		{
+			if (!skipAlpha || i % 4 != 3)
+			{
+				sum += data[i];
+			}
+		}
+		return sum;
+	}
+
+	// Sums `count` floats, 4 at a time. With `skipAlpha`, the floats are RGBA pixels and every fourth
+	// one is left out.
+	double sumFloats(const float* data, size_t count, bool skipAlpha)
+	{
+		double sum = 0.0;
+		size_t i = 0;
+#ifdef TILE_FINGERPRINT_SSE2
+		const __m128 keep = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, skipAlpha ? 0 : -1));
+		__m128 sums = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			sums = _mm_add_ps(sums, _mm_and_ps(_mm_loadu_ps(data + i), keep));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, sums);
+		sum = static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#endif
+		for (; i < count; ++i)
+		{
+			if (!skipAlpha || i % 4 != 3)
+			{
+				sum += data[i];
+			}
+		}
+		return sum;
+	}
+}
+
+void fingerprintTile(const void* pixels, int pixelsWidth, PixelFormat format, const Letterbox& tile, TileFingerprint* fingerprint)
+{
+	const bool floatPixels = format == PixelFormat::RGBA32F || format == PixelFormat::R32F;
+	const size_t components = bytesPerPixel(format) / (floatPixels ? sizeof(float) : 1);
+	const size_t rowComponents = static_cast<size_t>(pixelsWidth) * components;
+	const bool skipAlpha = components == 4;
+	const size_t colors = skipAlpha ? 3 : components;
+
+	for (int cellY = 0; cellY < 4; ++cellY)
+	{
+		const int top = tile.y + (tile.height * cellY) / 4;
+		const int bottom = tile.y + (tile.height * (cellY + 1)) / 4;
+		for (int cellX = 0; cellX < 4; ++cellX)
+		{
+			const int left = tile.x + (tile.width * cellX) / 4;
+			const int right = tile.x + (tile.width * (cellX + 1)) / 4;
+			const size_t count = static_cast<size_t>(right - left) * components;
+
+			// Each cell is a run of contiguous components per row.
+			double sum = 0.0;
+			for (int y = top; y < bottom; ++y)
+			{
+				const size_t offset = y * rowComponents + left * components;
+				sum += floatPixels ?
+					sumFloats(static_cast<const float*>(pixels) + offset, count, skipAlpha) :
+					sumBytes(static_cast<const uint8_t*>(pixels) + offset, count, skipAlpha) / 255.0;
+			}
+
+			const size_t total = static_cast<size_t>(right - left) * colors * (bottom - top);
+			(*fingerprint)[cellY * 4 + cellX] = total > 0 ? static_cast<float>(sum / total) : 0.0f;
+		}
+	}
+}
+
+float fingerprintDistance(const TileFingerprint& a, const TileFingerprint& b)
+{
+	float distance = 0.0f;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		distance = std::max(distance, std::fabs(a[i] - b[i]));
+	}
+	return distance;
+}
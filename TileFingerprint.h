@@ -0,0 +1,20 @@
+#pragma once
+
+#include <array>
+
+#include "PixelConversion.h"
+#include "ShapeBuckets.h"
+
+// A coarse summary of a tile's content: the average color value (0-1) of each cell of a 4x4 grid over
+// the tile. Comparing the fingerprints of a tile in two frames tells whether its content has changed
+// enough to be worth classifying again, at a fraction of the cost of converting it. Alpha is left out,
+// since models never see it: counting it would only dilute changes in color, by a quarter for the
+// mostly opaque inputs that a TOP downloads.
+using TileFingerprint = std::array<float, 16>;
+
+// Computes the fingerprint of the `tile` rectangle of downloaded pixels. The sums are vectorized (SSE2).
+void fingerprintTile(const void* pixels, int pixelsWidth, PixelFormat format, const Letterbox& tile, TileFingerprint* fingerprint);
+
+// The largest difference between any two corresponding cells, so that motion in a small part of a
+// tile isn't averaged away.
+float fingerprintDistance(const TileFingerprint& a, const TileFingerprint& b);
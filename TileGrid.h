@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "ShapeBuckets.h"
+
+// Splits a large image into overlapping, model-sized tiles, so that a high-resolution input can be
+// classified at its own resolution instead of being squeezed into a single model input. The results
+// of the tiles are merged into a coarse grid of cells, one cell per tile stride: every cell averages
+// the scores of all of the tiles that cover it.
+class TileGrid
+{
+public:
+	TileGrid() :
+		imageWidth(0),
+		imageHeight(0),
+		tileSize(0),
+		stride(0),
+		cellColumns(0),
+		cellRows(0)
+	{
+	}
+
+	// Lays out tiles of `size` pixels that overlap by the given fraction, returning true if the layout
+	// changed. The last row and column of tiles end at the edge of the image, and images smaller than
+	// a tile get a single (clipped) one.
+	bool layout(int width, int height, int size, float overlap)
+	{
+		const int newStride = std::max(1, static_cast<int>(size * (1.0f - overlap)));
+		if (width == imageWidth && height == imageHeight && size == tileSize && newStride == stride)
+		{
+			return false;
+		}
+		imageWidth = width;
+		imageHeight = height;
+		tileSize = size;
+		stride = newStride;
+
+		tileRects.clear();
+		for (int y : positions(height))
+		{
+			for (int x : positions(width))
+			{
+				Letterbox tile;
+				tile.x = x;
+				tile.y = y;
+				tile.width = std::min(tileSize, width);
+				tile.height = std::min(tileSize, height);
+				tileRects.push_back(tile);
+			}
+		}
+
+		cellColumns = (width + stride - 1) / stride;
+		cellRows = (height + stride - 1) / stride;
+		return true;
+	}
+
+	// Tiles in row-major order, in pixels of an image that is stored top-down.
+	const std::vector<Letterbox>& tiles() const
+	{
+		return tileRects;
+	}
+
+	int columns() const
+	{
+		return cellColumns;
+	}
+
+	int rows() const
+	{
+		return cellRows;
+	}
+
+	// Averages `classes` scores per tile into a `[rows, columns, classes]` grid of cells.
+	void merge(const std::vector<std::vector<float>>& tileScores, size_t classes, float* cells) const
+	{
+		const size_t cellCount = static_cast<size_t>(cellColumns) * cellRows;
+		std::fill(cells, cells + cellCount * classes, 0.0f);
+		std::vector<int> coverage(cellCount, 0);
+
+		for (size_t i = 0; i < tileRects.size() && i < tileScores.size(); ++i)
+		{
+			if (tileScores[i].size() != classes)
+			{
+				continue;
+			}
+
+			const Letterbox& tile = tileRects[i];
+			const int endColumn = std::min(cellColumns, (tile.x + tile.width + stride - 1) / stride);
+			const int endRow = std::min(cellRows, (tile.y + tile.height + stride - 1) / stride);
+			for (int row = tile.y / stride; row < endRow; ++row)
+			{
+				for (int column = tile.x / stride; column < endColumn; ++column)
+				{
+					const size_t cell = static_cast<size_t>(row) * cellColumns + column;
+					float* scores = cells + cell * classes;
+					for (size_t c = 0; c < classes; ++c)
+					{
+						scores[c] += tileScores[i][c];
+					}
+					++coverage[cell];
+				}
+			}
+		}
+
+		for (size_t cell = 0; cell < cellCount; ++cell)
+		{
+			if (coverage[cell] > 1)
+			{
+				float* scores = cells + cell * classes;
+				const float inverse = 1.0f / coverage[cell];
+				for (size_t c = 0; c < classes; ++c)
+				{
+					scores[c] *= inverse;
+				}
+			}
+		}
+	}
+
+private:
+	std::vector<int> positions(int length) const
+	{
+		std::vector<int> result;
+		if (length <= tileSize)
+		{
+			result.push_back(0);
+			return result;
+		}
+
+		for (int position = 0; ; position += stride)
+		{
+			if (position + tileSize >= length)
+			{
+				result.push_back(length - tileSize);
+				return result;
+			}
+			result.push_back(position);
+		}
+	}
+
+	std::vector<Letterbox> tileRects;
+	int imageWidth;
+	int imageHeight;
+	int tileSize;
+	int stride;
+	int cellColumns;
+	int cellRows;
+};
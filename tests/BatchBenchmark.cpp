@@ -0,0 +1,172 @@
+// Times a model at increasing batch sizes, to show how the cost of a run grows with the number of
+// images in it: for batched inputs, pyramids (1 + 5 x (levels - 1) crops) and test-time augmentation
+// (5 or 10 crops). Each batch is filled the way the TOP fills it, by converting a synthetic 1080p
+// frame into every slot.
+//
+//   batch_benchmark <model.pb> [input layer] [output layer] [input size] [largest batch]
+//
+// The defaults match the TOP's (Inception v3's `Mul` and `softmax` at 299x299, up to 32 images).
+
+#include "PixelConversion.h"
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/public/session.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// The placeholder's type and channel count, as the TOP reads them. Planar (NCHW) inputs have a
+	// small second dimension next to a large (or unknown) last one.
+	InputFormat readInputFormat(const tensorflow::GraphDef& graph, const std::string& inputName)
+	{
+		InputFormat format;
+		for (const auto& node : graph.node())
+		{
+			if (node.name() != inputName)
+			{
+				continue;
+			}
+
+			const auto& attributes = node.attr();
+			auto type = attributes.find("dtype");
+			if (type != attributes.end() && (type->second.type() == tensorflow::DT_FLOAT || type->second.type() == tensorflow::DT_UINT8))
+			{
+				format.type = type->second.type();
+			}
+
+			const auto shape = attributes.find("shape");
+			if (shape != attributes.end() && shape->second.shape().dim_size() == 4)
+			{
+				const auto second = shape->second.shape().dim(1).size();
+				const auto last = shape->second.shape().dim(3).size();
+				if (second >= 1 && second <= 4 && (last < 1 || last > 4))
+				{
+					format.layout = TensorLayout::NCHW;
+					format.channels = static_cast<int>(second);
+				}
+				else if (last >= 1 && last <= 4)
+				{
+					format.channels = static_cast<int>(last);
+				}
+			}
+			break;
+		}
+		return format;
+	}
+
+	// Runs `input` `iterations` times after an untimed first run (which sets up its shape), and
+	// returns the average time of one run.
+	tensorflow::Status timeRuns(tensorflow::Session* session, const std::string& inputLayer, const std::string& outputLayer,
+								const tensorflow::Tensor& input, int iterations, double* averageMs)
+	{
+		std::vector<tensorflow::Tensor> outputs;
+		TF_RETURN_IF_ERROR(session->Run({ { inputLayer, input } }, { outputLayer }, {}, &outputs));
+		const auto start = Clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			TF_RETURN_IF_ERROR(session->Run({ { inputLayer, input } }, { outputLayer }, {}, &outputs));
+		}
+		*averageMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+		return tensorflow::Status::OK();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::printf("Usage: %s <model.pb> [input layer] [output layer] [input size] [largest batch]\n", argv[0]);
+		return 1;
+	}
+	const std::string modelPath = argv[1];
+	const std::string inputLayer = argc > 2 ? argv[2] : "Mul";
+	const std::string outputLayer = argc > 3 ? argv[3] : "softmax";
+	const int size = argc > 4 ? std::atoi(argv[4]) : 299;
+	const int largestBatch = argc > 5 ? std::atoi(argv[5]) : 32;
+
+	tensorflow::GraphDef graph;
+	tensorflow::Status status = ReadBinaryProto(tensorflow::Env::Default(), modelPath, &graph);
+	if (!status.ok())
+	{
+		std::printf("Failed to read %s: %s\n", modelPath.c_str(), status.error_message().c_str());
+		return 1;
+	}
+
+	tensorflow::SessionOptions options;
+	options.config.mutable_gpu_options()->set_allow_growth(true);
+	std::unique_ptr<tensorflow::Session> session(tensorflow::NewSession(options));
+	status = session->Create(graph);
+	if (!status.ok())
+	{
+		std::printf("Failed to create a session: %s\n", status.error_message().c_str());
+		return 1;
+	}
+
+	const InputFormat input = readInputFormat(graph, inputLayer);
+	PixelConverter converter;
+	if (!converter.select(input))
+	{
+		std::printf("The model's input type or channel count isn't supported\n");
+		return 1;
+	}
+
+	// A gradient, so that the model sees something other than a flat image.
+	const int frameWidth = 1920;
+	const int frameHeight = 1080;
+	std::vector<uint8_t> frame(static_cast<size_t>(frameWidth) * frameHeight * 4);
+	for (size_t i = 0; i < frame.size(); ++i)
+	{
+		frame[i] = static_cast<uint8_t>((i / 4) % frameWidth * 255 / frameWidth + i % 4 * 40);
+	}
+	Letterbox region;
+	region.width = size;
+	region.height = size;
+
+	// Batched inputs take any size; pyramids take 6, 11 and 16 crops, test-time augmentation 5 or 10.
+	const int batchSizes[] = { 1, 2, 4, 5, 6, 8, 10, 11, 16, 32, 64 };
+	const int iterations = 10;
+	double singleMs = 0.0;
+	std::printf("batch  run ms  ms/image  images/s  vs 1 image  speedup\n");
+	for (int batch : batchSizes)
+	{
+		if (batch > largestBatch)
+		{
+			break;
+		}
+
+		tensorflow::Tensor tensor(input.type, input.shape(size, size, batch));
+		const PixelFormat format = input.channels == 1 ? PixelFormat::R8 : PixelFormat::BGRA8;
+		for (int slot = 0; status.ok() && slot < batch; ++slot)
+		{
+			status = converter.convert(frame.data(), frameWidth, frameHeight, format, region, &tensor, slot);
+		}
+
+		double ms;
+		status = !status.ok() ? status : timeRuns(session.get(), inputLayer, outputLayer, tensor, iterations, &ms);
+		if (!status.ok())
+		{
+			std::printf("A run with a batch of %d failed (does the model take a variable batch size?): %s\n", batch, status.error_message().c_str());
+			return 1;
+		}
+		if (batch == 1)
+		{
+			singleMs = ms;
+		}
+
+		// `vs 1 image` is how many single-image runs the batch costs; `speedup` is what batching saves
+		// over running its images one at a time.
+		std::printf("%5d %7.2f %9.2f %9.1f %11.2f %8.2f\n", batch, ms, ms / batch, batch * 1000.0 / ms, ms / singleMs, batch * singleMs / ms);
+	}
+	return 0;
+}
@@ -0,0 +1,247 @@
+// Checks BoxTracker's vectorized (SSE2) matching against a plain per-pixel NCC search. Frames are
+// textured noise that moves a few pixels at a time, with boxes of every size up to the patch limit,
+// some of them against the edges. The frame widths aren't multiples of 8 or 16, so every row of a
+// patch starts at a different alignment. Patch widths are always whole multiples of 8 (`reset()`
+// rounds them), so `sumRow()` never has a scalar tail to fall back on.
+
+#include "BoxTracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	struct ReferencePatch
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+		std::vector<int> weights;
+		float norm;
+	};
+
+	// The same patches as `BoxTracker::reset()`: the middle of each box, at most 32 pixels across.
+	std::vector<ReferencePatch> referencePatches(const std::vector<Box>& boxes, const GrayImage& frame)
+	{
+		std::vector<ReferencePatch> patches;
+		for (const Letterbox& rect : cropBoxes(boxes, frame.width, frame.height))
+		{
+			ReferencePatch patch;
+			patch.width = std::min(std::max(std::min(rect.width, 32), 8), frame.width) / 8 * 8;
+			patch.height = std::min(std::max(std::min(rect.height, 32), 8), frame.height);
+			patch.x = std::min(std::max(rect.x + (rect.width - patch.width) / 2, 0), frame.width - patch.width);
+			patch.y = std::min(std::max(rect.y + (rect.height - patch.height) / 2, 0), frame.height - patch.height);
+
+			const int count = patch.width * patch.height;
+			int sum = 0;
+			for (int y = 0; y < patch.height; ++y)
+			{
+				for (int x = 0; x < patch.width; ++x)
+				{
+					sum += frame.row(patch.y + y)[patch.x + x];
+				}
+			}
+			const int mean = count > 0 ? (sum + count / 2) / count : 0;
+
+			double squares = 0.0;
+			for (int y = 0; y < patch.height; ++y)
+			{
+				for (int x = 0; x < patch.width; ++x)
+				{
+					const int weight = frame.row(patch.y + y)[patch.x + x] - mean;
+					patch.weights.push_back(weight);
+					squares += weight * weight;
+				}
+			}
+			patch.norm = static_cast<float>(std::sqrt(squares));
+			patches.push_back(patch);
+		}
+		return patches;
+	}
+
+	// Moves every patch to the offset within `radius` with the highest NCC, one pixel at a time, and
+	// returns each patch's NCC.
+	std::vector<float> referenceUpdate(std::vector<ReferencePatch>* patches, const GrayImage& frame, int radius)
+	{
+		std::vector<float> confidences;
+		for (ReferencePatch& patch : *patches)
+		{
+			if (patch.norm <= 0.0f)
+			{
+				confidences.push_back(0.0f);
+				continue;
+			}
+
+			const int count = patch.width * patch.height;
+			float best = -1.0f;
+			int bestX = patch.x;
+			int bestY = patch.y;
+			for (int y = std::max(patch.y - radius, 0); y <= std::min(patch.y + radius, frame.height - patch.height); ++y)
+			{
+				for (int x = std::max(patch.x - radius, 0); x <= std::min(patch.x + radius, frame.width - patch.width); ++x)
+				{
+					int64_t product = 0;
+					int64_t sum = 0;
+					int64_t squares = 0;
+					for (int row = 0; row < patch.height; ++row)
+					{
+						for (int column = 0; column < patch.width; ++column)
+						{
+							const int pixel = frame.row(y + row)[x + column];
+							product += pixel * patch.weights[row * patch.width + column];
+							sum += pixel;
+							squares += pixel * pixel;
+						}
+					}
+
+					const double variance = squares - static_cast<double>(sum) * sum / count;
+					const float correlation = variance > 0.0 ? static_cast<float>(product / (std::sqrt(variance) * patch.norm)) : 0.0f;
+					if (correlation > best)
+					{
+						best = correlation;
+						bestX = x;
+						bestY = y;
+					}
+				}
+			}
+			patch.x = bestX;
+			patch.y = bestY;
+			confidences.push_back(std::min(std::max(best, 0.0f), 1.0f));
+		}
+		return confidences;
+	}
+
+	// Noise blurred over 3x3 pixels, so that a match a pixel off still correlates, sampled at an offset.
+	GrayImage makeFrame(const std::vector<int>& texture, int textureWidth, int width, int height, int offsetX, int offsetY, std::mt19937* random)
+	{
+		std::uniform_int_distribution<int> noise(-3, 3);
+		GrayImage frame;
+		frame.width = width;
+		frame.height = height;
+		frame.pixels.resize(static_cast<size_t>(width) * height);
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				const int value = texture[(y + offsetY) * textureWidth + x + offsetX] + noise(*random);
+				frame.pixels[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+			}
+		}
+		return frame;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(5);
+	const int margin = 16;
+	const int radius = 4;
+	int updates = 0;
+	for (int width : { 8, 13, 37, 61, 90, 127 })
+	{
+		for (int height : { 9, 29, 50 })
+		{
+			const int textureWidth = width + 2 * margin;
+			const int textureHeight = height + 2 * margin;
+			std::uniform_int_distribution<int> byte(0, 255);
+			std::vector<int> noise(static_cast<size_t>(textureWidth) * textureHeight);
+			for (int& value : noise)
+			{
+				value = byte(random);
+			}
+			std::vector<int> texture(noise.size(), 0);
+			for (int y = 1; y + 1 < textureHeight; ++y)
+			{
+				for (int x = 1; x + 1 < textureWidth; ++x)
+				{
+					int sum = 0;
+					for (int dy = -1; dy <= 1; ++dy)
+					{
+						for (int dx = -1; dx <= 1; ++dx)
+						{
+							sum += noise[(y + dy) * textureWidth + x + dx];
+						}
+					}
+					texture[y * textureWidth + x] = sum / 9;
+				}
+			}
+
+			// Small and large boxes, and boxes against each edge.
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			std::vector<Box> boxes;
+			for (int i = 0; i < 8; ++i)
+			{
+				Box box;
+				box.width = 0.05f + 0.6f * unit(random);
+				box.height = 0.05f + 0.6f * unit(random);
+				box.x = i == 0 ? 0.0f : i == 1 ? 1.0f - box.width : unit(random) * (1.0f - box.width);
+				box.y = i == 2 ? 0.0f : i == 3 ? 1.0f - box.height : unit(random) * (1.0f - box.height);
+				boxes.push_back(box);
+			}
+
+			int offsetX = margin;
+			int offsetY = margin;
+			const GrayImage keyframe = makeFrame(texture, textureWidth, width, height, offsetX, offsetY, &random);
+			BoxTracker tracker;
+			tracker.reset(boxes, keyframe);
+			std::vector<ReferencePatch> patches = referencePatches(boxes, keyframe);
+			std::vector<Box> expectedBoxes = boxes;
+
+			std::uniform_int_distribution<int> step(-3, 3);
+			for (int frameIndex = 0; frameIndex < 6; ++frameIndex)
+			{
+				offsetX = std::min(std::max(offsetX + step(random), 0), 2 * margin);
+				offsetY = std::min(std::max(offsetY + step(random), 0), 2 * margin);
+				const GrayImage frame = makeFrame(texture, textureWidth, width, height, offsetX, offsetY, &random);
+
+				std::vector<int> previousX;
+				std::vector<int> previousY;
+				for (const ReferencePatch& patch : patches)
+				{
+					previousX.push_back(patch.x);
+					previousY.push_back(patch.y);
+				}
+				const float lowest = tracker.update(frame, radius);
+				const std::vector<float> expected = referenceUpdate(&patches, frame, radius);
+
+				float expectedLowest = 1.0f;
+				for (size_t i = 0; i < patches.size(); ++i)
+				{
+					expectedBoxes[i].x += static_cast<float>(patches[i].x - previousX[i]) / frame.width;
+					expectedBoxes[i].y -= static_cast<float>(patches[i].y - previousY[i]) / frame.height;
+					expectedLowest = std::min(expectedLowest, expected[i]);
+
+					if (tracker.boxes()[i] != expectedBoxes[i] || tracker.confidences()[i] != expected[i])
+					{
+						std::printf("FAILED: %dx%d frame %d, box %zu: expected %.5f,%.5f with NCC %.6f, got %.5f,%.5f with NCC %.6f\n",
+									width, height, frameIndex, i, expectedBoxes[i].x, expectedBoxes[i].y, expected[i],
+									tracker.boxes()[i].x, tracker.boxes()[i].y, tracker.confidences()[i]);
+						++failures;
+					}
+				}
+				if (lowest != expectedLowest)
+				{
+					std::printf("FAILED: %dx%d frame %d: expected a lowest NCC of %.6f, got %.6f\n", width, height, frameIndex, expectedLowest, lowest);
+					++failures;
+				}
+				++updates;
+			}
+		}
+	}
+	std::printf("%d updates compared with the reference\n", updates);
+
+	if (failures > 0)
+	{
+		std::printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,272 @@
+// Checks DenseFlow's vectorized (SSE2) passes against a plain per-pixel version of the same pyramidal
+// Lucas-Kanade estimate, in which every window is summed directly. Image sizes (and so the rows and
+// buffers that the passes run over, on every level) aren't multiples of 4, so the scalar tails of the
+// row loops run too. The sums are accumulated in a different order, so the flows agree to within a
+// small tolerance rather than exactly.
+
+#include "DenseFlow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	const int windowRadius = 4;
+	const int iterations = 2;
+
+	struct Image
+	{
+		int width;
+		int height;
+		std::vector<float> values;
+
+		float at(int x, int y) const
+		{
+			return values[static_cast<size_t>(y) * width + x];
+		}
+	};
+
+	float sample(const Image& image, float x, float y)
+	{
+		x = std::min(std::max(x, 0.0f), static_cast<float>(image.width - 1));
+		y = std::min(std::max(y, 0.0f), static_cast<float>(image.height - 1));
+		const int left = static_cast<int>(x);
+		const int top = static_cast<int>(y);
+		const int right = std::min(left + 1, image.width - 1);
+		const int bottom = std::min(top + 1, image.height - 1);
+		const float upper = image.at(left, top) + (image.at(right, top) - image.at(left, top)) * (x - left);
+		const float lower = image.at(left, bottom) + (image.at(right, bottom) - image.at(left, bottom)) * (x - left);
+		return upper + (lower - upper) * (y - top);
+	}
+
+	Image halve(const Image& image)
+	{
+		Image half;
+		half.width = image.width / 2;
+		half.height = image.height / 2;
+		for (int y = 0; y < half.height; ++y)
+		{
+			for (int x = 0; x < half.width; ++x)
+			{
+				const int right = std::min(2 * x + 1, image.width - 1);
+				const int bottom = std::min(2 * y + 1, image.height - 1);
+				half.values.push_back((image.at(2 * x, 2 * y) + image.at(right, 2 * y) + image.at(2 * x, bottom) + image.at(right, bottom)) * 0.25f);
+			}
+		}
+		return half;
+	}
+
+	// The sum over the window around every value, clipped to the image.
+	std::vector<float> windowSums(const std::vector<float>& values, int width, int height)
+	{
+		std::vector<float> sums(values.size());
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				double sum = 0.0;
+				for (int wy = std::max(y - windowRadius, 0); wy <= std::min(y + windowRadius, height - 1); ++wy)
+				{
+					for (int wx = std::max(x - windowRadius, 0); wx <= std::min(x + windowRadius, width - 1); ++wx)
+					{
+						sum += values[static_cast<size_t>(wy) * width + wx];
+					}
+				}
+				sums[static_cast<size_t>(y) * width + x] = static_cast<float>(sum);
+			}
+		}
+		return sums;
+	}
+
+	void refine(const Image& from, const Image& to, std::vector<float>* flowX, std::vector<float>* flowY)
+	{
+		const int width = from.width;
+		const int height = from.height;
+		const size_t count = from.values.size();
+
+		// Central differences, one-sided at the edges.
+		std::vector<float> gradientX(count);
+		std::vector<float> gradientY(count);
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				const size_t i = static_cast<size_t>(y) * width + x;
+				if (width == 1)
+				{
+					gradientX[i] = 0.0f;
+				}
+				else if (x == 0 || x == width - 1)
+				{
+					gradientX[i] = x == 0 ? from.at(1, y) - from.at(0, y) : from.at(x, y) - from.at(x - 1, y);
+				}
+				else
+				{
+					gradientX[i] = (from.at(x + 1, y) - from.at(x - 1, y)) * 0.5f;
+				}
+				const float scale = (y > 0 && y < height - 1) ? 0.5f : 1.0f;
+				gradientY[i] = (from.at(x, std::min(y + 1, height - 1)) - from.at(x, std::max(y - 1, 0))) * scale;
+			}
+		}
+
+		std::vector<float> xx(count);
+		std::vector<float> xy(count);
+		std::vector<float> yy(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			xx[i] = gradientX[i] * gradientX[i];
+			xy[i] = gradientX[i] * gradientY[i];
+			yy[i] = gradientY[i] * gradientY[i];
+		}
+		xx = windowSums(xx, width, height);
+		xy = windowSums(xy, width, height);
+		yy = windowSums(yy, width, height);
+
+		const int window = 2 * windowRadius + 1;
+		const float regularization = static_cast<float>(window * window);
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			std::vector<float> errorX(count);
+			std::vector<float> errorY(count);
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					const size_t i = static_cast<size_t>(y) * width + x;
+					const float difference = from.values[i] - sample(to, x + (*flowX)[i], y + (*flowY)[i]);
+					errorX[i] = difference * gradientX[i];
+					errorY[i] = difference * gradientY[i];
+				}
+			}
+			errorX = windowSums(errorX, width, height);
+			errorY = windowSums(errorY, width, height);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const float a = xx[i] + regularization;
+				const float b = xy[i];
+				const float c = yy[i] + regularization;
+				const float inverse = 1.0f / (a * c - b * b);
+				(*flowX)[i] += (c * errorX[i] - b * errorY[i]) * inverse;
+				(*flowY)[i] += (a * errorY[i] - b * errorX[i]) * inverse;
+			}
+		}
+	}
+
+	void referenceFlow(const GrayImage& from, const GrayImage& to, int levels, std::vector<float>* flowX, std::vector<float>* flowY)
+	{
+		std::vector<Image> fromLevels(1);
+		std::vector<Image> toLevels(1);
+		fromLevels[0].width = toLevels[0].width = from.width;
+		fromLevels[0].height = toLevels[0].height = from.height;
+		fromLevels[0].values.assign(from.pixels.begin(), from.pixels.end());
+		toLevels[0].values.assign(to.pixels.begin(), to.pixels.end());
+		while (static_cast<int>(fromLevels.size()) < levels && fromLevels.back().width >= 4 * windowRadius && fromLevels.back().height >= 4 * windowRadius)
+		{
+			fromLevels.push_back(halve(fromLevels.back()));
+			toLevels.push_back(halve(toLevels.back()));
+		}
+
+		flowX->assign(fromLevels.back().values.size(), 0.0f);
+		flowY->assign(flowX->size(), 0.0f);
+		for (size_t level = fromLevels.size(); level-- > 0;)
+		{
+			const Image& image = fromLevels[level];
+			if (level + 1 < fromLevels.size())
+			{
+				const Image& coarser = fromLevels[level + 1];
+				std::vector<float> upX;
+				std::vector<float> upY;
+				for (int y = 0; y < image.height; ++y)
+				{
+					for (int x = 0; x < image.width; ++x)
+					{
+						const size_t coarse = static_cast<size_t>(std::min(y / 2, coarser.height - 1)) * coarser.width + std::min(x / 2, coarser.width - 1);
+						upX.push_back((*flowX)[coarse] * 2.0f);
+						upY.push_back((*flowY)[coarse] * 2.0f);
+					}
+				}
+				flowX->swap(upX);
+				flowY->swap(upY);
+			}
+			refine(image, toLevels[level], flowX, flowY);
+		}
+	}
+
+	// Smooth texture, so that the flow is well defined, moved by a fraction of a pixel.
+	GrayImage makeImage(int width, int height, float shiftX, float shiftY)
+	{
+		GrayImage image;
+		image.width = width;
+		image.height = height;
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				const float u = x - shiftX;
+				const float v = y - shiftY;
+				const float value = 128.0f + 50.0f * std::sin(u * 0.31f) * std::cos(v * 0.23f) + 40.0f * std::sin((u + v) * 0.17f + 1.0f);
+				image.pixels.push_back(static_cast<uint8_t>(std::min(std::max(value, 0.0f), 255.0f)));
+			}
+		}
+		return image;
+	}
+}
+
+int main()
+{
+	DenseFlow flow;
+	int estimates = 0;
+	for (int width : { 5, 17, 23, 31, 45, 67, 130 })
+	{
+		for (int height : { 7, 19, 38, 51 })
+		{
+			for (int levels : { 1, 2, 3 })
+			{
+				const GrayImage from = makeImage(width, height, 0.0f, 0.0f);
+				const GrayImage to = makeImage(width, height, 1.5f, -0.75f);
+
+				// The same object is reused, as the TOP does, so buffers from a larger size are around.
+				flow.estimate(from, to, levels);
+				std::vector<float> expectedX;
+				std::vector<float> expectedY;
+				referenceFlow(from, to, levels, &expectedX, &expectedY);
+
+				if (flow.width() != width || flow.height() != height || flow.dx().size() != expectedX.size())
+				{
+					std::printf("FAILED: %dx%d, %d levels: the flow is %dx%d\n", width, height, levels, flow.width(), flow.height());
+					++failures;
+					continue;
+				}
+
+				float largest = 0.0f;
+				for (size_t i = 0; i < expectedX.size(); ++i)
+				{
+					largest = std::max(largest, std::fabs(flow.dx()[i] - expectedX[i]));
+					largest = std::max(largest, std::fabs(flow.dy()[i] - expectedY[i]));
+				}
+				if (!(largest <= 1e-3f))
+				{
+					std::printf("FAILED: %dx%d, %d levels: the flow differs by up to %f pixels\n", width, height, levels, largest);
+					++failures;
+				}
+				++estimates;
+			}
+		}
+	}
+	std::printf("%d estimates compared with the reference\n", estimates);
+
+	if (failures > 0)
+	{
+		std::printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,116 @@
+// Times decoding and suppression on synthetic SSD outputs with 1k, 10k and 50k anchors, like the
+// TOP's `Benchmark Detections`: 90 classes, one anchor in a hundred scoring above the threshold, and
+// the candidates clustered ten to an object. Suppression is timed on all of the anchors, as if none
+// were thresholded away, with at most 100 kept boxes and with no limit, for both methods.
+
+#include "Detections.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	double millisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+int main()
+{
+	const int iterations = 5;
+	const float threshold = 0.5f;
+	const float overlap = 0.5f;
+	const int classes = 91;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+	std::printf("anchors  candidates  decode ms  method  nms 100 ms  nms all ms  kept\n");
+	for (int count : { 1000, 10000, 50000 })
+	{
+		Anchors anchors;
+		tensorflow::Tensor encodings(tensorflow::DT_FLOAT, tensorflow::TensorShape({ 1, count, 4 }));
+		tensorflow::Tensor logits(tensorflow::DT_FLOAT, tensorflow::TensorShape({ 1, count, classes }));
+		float* codes = encodings.flat<float>().data();
+		float* classLogits = logits.flat<float>().data();
+		for (int i = 0; i < count; ++i)
+		{
+			if (i % 10 == 0)
+			{
+				const float size = 0.05f + 0.2f * unit(random);
+				anchors.y.push_back(unit(random));
+				anchors.x.push_back(unit(random));
+				anchors.height.push_back(size);
+				anchors.width.push_back(size);
+			}
+			else
+			{
+				anchors.y.push_back(anchors.y.back());
+				anchors.x.push_back(anchors.x.back());
+				anchors.height.push_back(anchors.height.back());
+				anchors.width.push_back(anchors.width.back());
+			}
+			for (int c = 0; c < 4; ++c)
+			{
+				codes[i * 4 + c] = jitter(random);
+			}
+
+			// A logit of 0 is a score of 0.5, so about one anchor in a hundred passes.
+			for (int c = 0; c < classes; ++c)
+			{
+				classLogits[static_cast<size_t>(i) * classes + c] = -4.0f * unit(random) - 0.01f;
+			}
+			if (unit(random) < 0.01f)
+			{
+				classLogits[static_cast<size_t>(i) * classes + 1 + i % (classes - 1)] = 3.0f * unit(random);
+			}
+		}
+
+		// The first run of everything isn't timed.
+		BoxCandidates candidates;
+		decodeSsd(encodings, logits, anchors, threshold, &candidates);
+		const auto decodeStart = Clock::now();
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			decodeSsd(encodings, logits, anchors, threshold, &candidates);
+		}
+		const double decodeMs = millisecondsSince(decodeStart) / iterations;
+
+		BoxCandidates all;
+		for (int i = 0; i < count; ++i)
+		{
+			all.add(anchors.y[i] - anchors.height[i] * 0.5f, anchors.x[i] - anchors.width[i] * 0.5f,
+					anchors.y[i] + anchors.height[i] * 0.5f + 0.01f * jitter(random), anchors.x[i] + anchors.width[i] * 0.5f + 0.01f * jitter(random), unit(random), 0);
+		}
+
+		for (Suppression suppression : { Suppression::Greedy, Suppression::Linear })
+		{
+			// Soft-NMS drops boxes once they score below the threshold.
+			std::vector<Detection> kept;
+			suppressOverlaps(all, suppression, overlap, threshold, 100, &kept);
+			const auto limitedStart = Clock::now();
+			for (int iteration = 0; iteration < iterations; ++iteration)
+			{
+				suppressOverlaps(all, suppression, overlap, threshold, 100, &kept);
+			}
+			const double limitedMs = millisecondsSince(limitedStart) / iterations;
+
+			const auto unlimitedStart = Clock::now();
+			for (int iteration = 0; iteration < iterations; ++iteration)
+			{
+				suppressOverlaps(all, suppression, overlap, threshold, all.size(), &kept);
+			}
+			const double unlimitedMs = millisecondsSince(unlimitedStart) / iterations;
+
+			std::printf("%7d %11zu %10.3f  %-6s %11.3f %11.3f %5zu\n", count, candidates.size(), decodeMs,
+						suppression == Suppression::Linear ? "soft" : "greedy", limitedMs, unlimitedMs, kept.size());
+		}
+	}
+	return 0;
+}
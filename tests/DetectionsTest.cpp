@@ -0,0 +1,204 @@
+// Checks the vectorized (SSE2) suppression against a naive O(n^2) one, for greedy NMS and soft-NMS.
+// Candidates are padded to whole vectors of four, and every pass over them starts at the vector
+// that holds the next undecided box, so the counts cover every padding (0 to 3 empty lanes) with
+// boxes that overlap in clusters, as a detector's do. Scores are also drawn from a few values, so
+// that ties have to be broken in candidate order by both.
+
+#include "Detections.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool condition, const char* what, const char* method, size_t count, size_t maxCount, float overlap, size_t expected, size_t actual)
+	{
+		if (!condition)
+		{
+			std::printf("FAILED: %s (%s, %zu candidates, at most %zu kept, overlap %.2f: expected %zu, got %zu)\n",
+						what, method, count, maxCount, overlap, expected, actual);
+			++failures;
+		}
+	}
+
+	float iou(const BoxCandidates& candidates, size_t a, size_t b)
+	{
+		const float width = std::min(candidates.right[a], candidates.right[b]) - std::max(candidates.left[a], candidates.left[b]);
+		const float height = std::min(candidates.bottom[a], candidates.bottom[b]) - std::max(candidates.top[a], candidates.top[b]);
+		const float shared = std::max(width, 0.0f) * std::max(height, 0.0f);
+		const float areaA = (candidates.bottom[a] - candidates.top[a]) * (candidates.right[a] - candidates.left[a]);
+		const float areaB = (candidates.bottom[b] - candidates.top[b]) * (candidates.right[b] - candidates.left[b]);
+		return shared / (areaA + areaB - shared);
+	}
+
+	Detection toDetection(const BoxCandidates& candidates, size_t i, float score)
+	{
+		Detection detection;
+		detection.box.x = candidates.left[i];
+		detection.box.y = 1.0f - candidates.bottom[i];
+		detection.box.width = candidates.right[i] - candidates.left[i];
+		detection.box.height = candidates.bottom[i] - candidates.top[i];
+		detection.score = score;
+		detection.classIndex = candidates.classes[i];
+		return detection;
+	}
+
+	// Keeps the best box left (the first of equal ones) and drops every box that overlaps it.
+	void naiveGreedy(const BoxCandidates& candidates, float overlap, size_t maxCount, std::vector<Detection>* detections)
+	{
+		std::vector<bool> removed(candidates.size(), false);
+		while (detections->size() < maxCount)
+		{
+			size_t best = candidates.size();
+			for (size_t i = 0; i < candidates.size(); ++i)
+			{
+				if (!removed[i] && (best == candidates.size() || candidates.scores[i] > candidates.scores[best]))
+				{
+					best = i;
+				}
+			}
+			if (best == candidates.size())
+			{
+				break;
+			}
+
+			detections->push_back(toDetection(candidates, best, candidates.scores[best]));
+			removed[best] = true;
+			for (size_t i = 0; i < candidates.size(); ++i)
+			{
+				if (!removed[i] && iou(candidates, best, i) > overlap)
+				{
+					removed[i] = true;
+				}
+			}
+		}
+	}
+
+	// Keeps the best box left (the first of equal ones) while it scores at least `scoreThreshold`, and
+	// scales the scores of the boxes that overlap it by (1 - IoU).
+	void naiveLinear(const BoxCandidates& candidates, float overlap, float scoreThreshold, size_t maxCount, std::vector<Detection>* detections)
+	{
+		std::vector<float> scores = candidates.scores;
+		std::vector<bool> removed(candidates.size(), false);
+		while (detections->size() < maxCount)
+		{
+			size_t best = candidates.size();
+			for (size_t i = 0; i < candidates.size(); ++i)
+			{
+				if (!removed[i] && (best == candidates.size() || scores[i] > scores[best]))
+				{
+					best = i;
+				}
+			}
+			if (best == candidates.size() || !(scores[best] >= scoreThreshold))
+			{
+				break;
+			}
+
+			detections->push_back(toDetection(candidates, best, scores[best]));
+			removed[best] = true;
+			for (size_t i = 0; i < candidates.size(); ++i)
+			{
+				const float boxIou = iou(candidates, best, i);
+				if (!removed[i] && boxIou > overlap)
+				{
+					scores[i] *= 1.0f - boxIou;
+				}
+			}
+		}
+	}
+
+	// Boxes in clusters of up to eight around random objects, with scores from `scoreLevels` values
+	// (or continuous, for 0).
+	BoxCandidates makeCandidates(size_t count, int scoreLevels, std::mt19937* random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::uniform_real_distribution<float> jitter(-0.02f, 0.02f);
+		std::uniform_int_distribution<int> level(1, std::max(scoreLevels, 1));
+		BoxCandidates candidates;
+		float centerY = 0.0f;
+		float centerX = 0.0f;
+		float size = 0.0f;
+		while (candidates.size() < count)
+		{
+			if (candidates.size() % 8 == 0 || unit(*random) < 0.2f)
+			{
+				centerY = unit(*random);
+				centerX = unit(*random);
+				size = 0.05f + 0.2f * unit(*random);
+			}
+			const float height = size * (1.0f + 5.0f * jitter(*random));
+			const float width = size * (1.0f + 5.0f * jitter(*random));
+			const float y = centerY + jitter(*random);
+			const float x = centerX + jitter(*random);
+			const float score = scoreLevels > 0 ? level(*random) / static_cast<float>(scoreLevels) : unit(*random);
+			candidates.add(y - height * 0.5f, x - width * 0.5f, y + height * 0.5f, x + width * 0.5f, score, static_cast<int>(candidates.size() % 7));
+		}
+		return candidates;
+	}
+
+	size_t countMismatches(const std::vector<Detection>& expected, const std::vector<Detection>& actual)
+	{
+		size_t mismatches = 0;
+		for (size_t i = 0; i < std::min(expected.size(), actual.size()); ++i)
+		{
+			mismatches += expected[i].box != actual[i].box || expected[i].score != actual[i].score || expected[i].classIndex != actual[i].classIndex;
+		}
+		return mismatches;
+	}
+}
+
+int main()
+{
+	// Every padding (count % 4), around the boundaries of one and two vectors and at larger sizes.
+	const size_t counts[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 13, 14, 15, 16, 61, 62, 63, 64, 509, 510, 511, 512 };
+	const size_t unlimited = std::numeric_limits<size_t>::max();
+	const size_t maxCounts[] = { 1, 3, 10, unlimited };
+	const float overlaps[] = { 0.0f, 0.3f, 0.5f, 0.7f };
+	const float scoreThreshold = 0.05f;
+
+	std::mt19937 random(7);
+	size_t comparisons = 0;
+	for (size_t count : counts)
+	{
+		for (int scoreLevels : { 0, 4 })
+		{
+			const BoxCandidates candidates = makeCandidates(count, scoreLevels, &random);
+			for (float overlap : overlaps)
+			{
+				for (size_t maxCount : maxCounts)
+				{
+					std::vector<Detection> expected;
+					std::vector<Detection> actual;
+					naiveGreedy(candidates, overlap, maxCount, &expected);
+					suppressOverlaps(candidates, Suppression::Greedy, overlap, scoreThreshold, maxCount, &actual);
+					check(expected.size() == actual.size(), "greedy keeps as many boxes as the naive version", "greedy", count, maxCount, overlap, expected.size(), actual.size());
+					check(countMismatches(expected, actual) == 0, "greedy keeps the same boxes, in the same order", "greedy", count, maxCount, overlap, 0, countMismatches(expected, actual));
+
+					expected.clear();
+					naiveLinear(candidates, overlap, scoreThreshold, maxCount, &expected);
+					suppressOverlaps(candidates, Suppression::Linear, overlap, scoreThreshold, maxCount, &actual);
+					check(expected.size() == actual.size(), "soft-NMS keeps as many boxes as the naive version", "linear", count, maxCount, overlap, expected.size(), actual.size());
+					check(countMismatches(expected, actual) == 0, "soft-NMS keeps the same boxes and scores, in the same order", "linear", count, maxCount, overlap, 0, countMismatches(expected, actual));
+					comparisons += 2;
+				}
+			}
+		}
+	}
+	std::printf("%zu suppressions compared with the naive versions\n", comparisons);
+
+	if (failures > 0)
+	{
+		std::printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// Stands in for the system's GL headers when building tests that use GL objects without a context.
+// `CPlusPlus_Common.h` includes this on non-Windows platforms; the test defines the functions.
+
+#include <cstdint>
+
+typedef uint32_t GLenum;
+typedef uint32_t GLuint;
+typedef int32_t GLint;
+typedef int32_t GLsizei;
+
+#define GL_TEXTURE_2D 0x0DE1
+#define GL_TEXTURE_MAG_FILTER 0x2800
+#define GL_TEXTURE_MIN_FILTER 0x2801
+#define GL_TEXTURE_WRAP_S 0x2802
+#define GL_TEXTURE_WRAP_T 0x2803
+#define GL_NEAREST 0x2600
+#define GL_CLAMP_TO_EDGE 0x812F
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_R32F 0x822E
+#define GL_RG32F 0x8230
+#define GL_RGBA8 0x8058
+#define GL_RGBA32F 0x8814
+
+void glCreateTextures(GLenum target, GLsizei n, GLuint* textures);
+void glTextureParameteri(GLuint texture, GLenum name, GLint param);
+void glTextureStorage2D(GLuint texture, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+void glDeleteTextures(GLsizei n, const GLuint* textures);
+void glCreateFramebuffers(GLsizei n, GLuint* framebuffers);
+void glNamedFramebufferTexture(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level);
+void glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers);
@@ -0,0 +1,322 @@
+// Checks GlResourcePool against a fake GL that tracks every texture and framebuffer it hands out:
+// released textures are reused for the same key, the least recently released ones are deleted past
+// `maxIdleTextures`, and a long random run of acquires and releases never leaks or double-deletes an
+// object. Run with "leak", it destroys a pool without calling `clear()`, which has to assert.
+
+#include "GlResourcePool.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool condition, const char* what, uint64_t expected, uint64_t actual)
+	{
+		if (!condition)
+		{
+			std::printf("FAILED: %s (expected %llu, got %llu)\n", what, static_cast<unsigned long long>(expected), static_cast<unsigned long long>(actual));
+			++failures;
+		}
+	}
+
+	struct FakeTexture
+	{
+		GLsizei width = 0;
+		GLsizei height = 0;
+		GLenum format = 0;
+		int storageCalls = 0;
+	};
+
+	struct FakeGl
+	{
+		GLuint nextName = 1;
+		std::map<GLuint, FakeTexture> textures;
+		std::map<GLuint, GLuint> framebuffers;
+		uint64_t texturesCreated = 0;
+		uint64_t framebuffersCreated = 0;
+		uint64_t invalidDeletes = 0;
+		uint64_t invalidCalls = 0;
+	};
+
+	FakeGl gl;
+
+	using Key = std::tuple<GLsizei, GLsizei, GLenum>;
+
+	const Key keys[] = {
+		Key(1920, 1080, GL_RGBA8),
+		Key(1280, 720, GL_RGBA8),
+		Key(224, 224, GL_RGBA32F),
+		Key(1000, 1, GL_R32F),
+		Key(320, 180, GL_RG32F),
+		Key(320, 180, GL_R32F),
+	};
+
+	GLuint acquire(GlResourcePool* pool, const Key& key)
+	{
+		return pool->acquireTexture(std::get<0>(key), std::get<1>(key), std::get<2>(key));
+	}
+
+	bool matches(GLuint texture, const Key& key)
+	{
+		auto it = gl.textures.find(texture);
+		return it != gl.textures.end() && Key(it->second.width, it->second.height, it->second.format) == key;
+	}
+
+	void testReuse()
+	{
+		GlResourcePool pool(4);
+
+		const GLuint first = acquire(&pool, keys[0]);
+		const GLuint framebuffer = pool.framebufferFor(first);
+		check(pool.framebufferFor(first) == framebuffer, "a texture's framebuffer is created once", framebuffer, pool.framebufferFor(first));
+		pool.releaseTexture(first);
+
+		const uint64_t created = gl.texturesCreated;
+		const GLuint again = acquire(&pool, keys[0]);
+		check(again == first, "a released texture is reused for the same key", first, again);
+		check(gl.texturesCreated == created, "reusing a texture creates no GL objects", created, gl.texturesCreated);
+		check(pool.framebufferFor(again) == framebuffer, "a reused texture keeps its framebuffer", framebuffer, pool.framebufferFor(again));
+
+		// An idle texture with a different key isn't a match.
+		pool.releaseTexture(again);
+		const GLuint other = acquire(&pool, keys[1]);
+		check(other != first, "a different key gets a different texture", 1, other != first);
+		check(matches(other, keys[1]), "a new texture has the requested storage", 1, matches(other, keys[1]));
+		check(pool.textureCount() == 2, "both textures are kept", 2, pool.textureCount());
+
+		// Releasing 0 or a texture that the pool didn't create changes nothing.
+		pool.releaseTexture(0);
+		pool.releaseTexture(other + 1000);
+		check(pool.textureCount() == 2, "unknown textures are ignored", 2, pool.textureCount());
+
+		pool.releaseTexture(other);
+		pool.clear();
+		check(gl.textures.empty(), "clear() deletes every texture", 0, gl.textures.size());
+		check(gl.framebuffers.empty(), "clear() deletes every framebuffer", 0, gl.framebuffers.size());
+	}
+
+	void testEviction()
+	{
+		const size_t maxIdle = 3;
+		GlResourcePool pool(maxIdle);
+
+		std::vector<GLuint> acquired;
+		for (const Key& key : keys)
+		{
+			acquired.push_back(acquire(&pool, key));
+			pool.framebufferFor(acquired.back());
+		}
+		check(pool.textureCount() == 6, "textures in use are never evicted", 6, pool.textureCount());
+
+		// Released in order, so the first three are the least recently released.
+		for (GLuint texture : acquired)
+		{
+			pool.releaseTexture(texture);
+		}
+		check(pool.textureCount() == maxIdle, "idle textures are capped at maxIdle", maxIdle, pool.textureCount());
+		check(gl.textures.size() == maxIdle, "evicted textures are deleted", maxIdle, gl.textures.size());
+		check(gl.framebuffers.size() == maxIdle, "evicted textures' framebuffers are deleted", maxIdle, gl.framebuffers.size());
+		for (size_t i = 0; i < acquired.size(); ++i)
+		{
+			const bool alive = gl.textures.count(acquired[i]) > 0;
+			check(alive == (i >= acquired.size() - maxIdle), "the least recently released textures are evicted first", i >= acquired.size() - maxIdle, alive);
+		}
+
+		// The survivors are still reused.
+		const uint64_t created = gl.texturesCreated;
+		const GLuint reused = acquire(&pool, keys[5]);
+		check(reused == acquired[5], "a surviving idle texture is reused", acquired[5], reused);
+		check(gl.texturesCreated == created, "reusing a survivor creates no GL objects", created, gl.texturesCreated);
+		pool.releaseTexture(reused);
+
+		pool.clear();
+		check(gl.textures.empty() && gl.framebuffers.empty(), "clear() deletes everything", 0, gl.textures.size() + gl.framebuffers.size());
+	}
+
+	// Random acquires, releases and framebuffer lookups, with up to `maxInUse` textures held at a time
+	// (like a few inputs, outputs and flow passes), checking the pool against the fake GL after every step.
+	void testSoak(uint64_t steps)
+	{
+		const size_t maxIdle = 4;
+		const size_t maxInUse = 8;
+		GlResourcePool pool(maxIdle);
+		std::mt19937 random(1234);
+		std::uniform_int_distribution<int> pickKey(0, static_cast<int>(sizeof(keys) / sizeof(keys[0])) - 1);
+		std::uniform_int_distribution<int> pickAction(0, 9);
+
+		std::vector<GLuint> inUse;
+		uint64_t acquires = 0;
+		uint64_t reuses = 0;
+		uint64_t handedOutTwice = 0;
+		uint64_t wrongStorage = 0;
+		uint64_t missedReuses = 0;
+		uint64_t brokenInvariants = 0;
+		for (uint64_t step = 0; step < steps; ++step)
+		{
+			const int action = pickAction(random);
+			if (inUse.empty() || (action < 5 && inUse.size() < maxInUse))
+			{
+				// An idle texture (one that exists but isn't in use) with the same key has to be reused.
+				const Key& key = keys[pickKey(random)];
+				bool reusable = false;
+				for (const auto& texture : gl.textures)
+				{
+					reusable = reusable || (matches(texture.first, key) && std::find(inUse.begin(), inUse.end(), texture.first) == inUse.end());
+				}
+
+				const uint64_t created = gl.texturesCreated;
+				const GLuint texture = acquire(&pool, key);
+				++acquires;
+				reuses += gl.texturesCreated == created;
+				missedReuses += reusable != (gl.texturesCreated == created);
+				brokenInvariants += gl.texturesCreated > created + 1;
+				handedOutTwice += std::find(inUse.begin(), inUse.end(), texture) != inUse.end();
+				wrongStorage += !matches(texture, key);
+				inUse.push_back(texture);
+			}
+			else if (action < 9)
+			{
+				std::uniform_int_distribution<size_t> pickTexture(0, inUse.size() - 1);
+				const size_t index = pickTexture(random);
+				pool.releaseTexture(inUse[index]);
+				inUse[index] = inUse.back();
+				inUse.pop_back();
+			}
+			else
+			{
+				std::uniform_int_distribution<size_t> pickTexture(0, inUse.size() - 1);
+				const GLuint texture = inUse[pickTexture(random)];
+				const GLuint framebuffer = pool.framebufferFor(texture);
+				auto it = gl.framebuffers.find(framebuffer);
+				brokenInvariants += it == gl.framebuffers.end() || it->second != texture;
+			}
+
+			// Every texture is either in use or idle, and the idle ones never exceed the cap.
+			brokenInvariants += pool.textureCount() != gl.textures.size();
+			brokenInvariants += pool.framebufferCount() != gl.framebuffers.size();
+			brokenInvariants += pool.textureCount() < inUse.size() || pool.textureCount() - inUse.size() > maxIdle;
+		}
+
+		std::printf("Soak: %llu steps, %llu acquires, %llu reused, %llu textures created, %zu in use at the end\n",
+					static_cast<unsigned long long>(steps), static_cast<unsigned long long>(acquires), static_cast<unsigned long long>(reuses),
+					static_cast<unsigned long long>(gl.texturesCreated), inUse.size());
+		check(handedOutTwice == 0, "a texture in use is never handed out again", 0, handedOutTwice);
+		check(wrongStorage == 0, "acquired textures have the requested storage", 0, wrongStorage);
+		check(brokenInvariants == 0, "the pool matches the GL objects that exist", 0, brokenInvariants);
+		check(missedReuses == 0, "a texture is created only when no idle one matches", 0, missedReuses);
+
+		pool.clear();
+		check(gl.textures.empty() && gl.framebuffers.empty(), "clear() deletes everything, including textures in use", 0, gl.textures.size() + gl.framebuffers.size());
+	}
+}
+
+void glCreateTextures(GLenum target, GLsizei n, GLuint* textures)
+{
+	gl.invalidCalls += target != GL_TEXTURE_2D;
+	for (GLsizei i = 0; i < n; ++i)
+	{
+		textures[i] = gl.nextName++;
+		gl.textures[textures[i]] = FakeTexture();
+		++gl.texturesCreated;
+	}
+}
+
+void glTextureParameteri(GLuint texture, GLenum, GLint)
+{
+	gl.invalidCalls += gl.textures.count(texture) == 0;
+}
+
+void glTextureStorage2D(GLuint texture, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	auto it = gl.textures.find(texture);
+	if (it == gl.textures.end() || levels != 1)
+	{
+		++gl.invalidCalls;
+		return;
+	}
+
+	// Immutable storage can only be allocated once.
+	FakeTexture& fake = it->second;
+	gl.invalidCalls += fake.storageCalls++ > 0;
+	fake.width = width;
+	fake.height = height;
+	fake.format = internalFormat;
+}
+
+void glDeleteTextures(GLsizei n, const GLuint* textures)
+{
+	for (GLsizei i = 0; i < n; ++i)
+	{
+		gl.invalidDeletes += gl.textures.erase(textures[i]) == 0;
+	}
+}
+
+void glCreateFramebuffers(GLsizei n, GLuint* framebuffers)
+{
+	for (GLsizei i = 0; i < n; ++i)
+	{
+		framebuffers[i] = gl.nextName++;
+		gl.framebuffers[framebuffers[i]] = 0;
+		++gl.framebuffersCreated;
+	}
+}
+
+void glNamedFramebufferTexture(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level)
+{
+	auto it = gl.framebuffers.find(framebuffer);
+	if (it == gl.framebuffers.end() || attachment != GL_COLOR_ATTACHMENT0 || level != 0 || gl.textures.count(texture) == 0)
+	{
+		++gl.invalidCalls;
+		return;
+	}
+	it->second = texture;
+}
+
+void glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers)
+{
+	for (GLsizei i = 0; i < n; ++i)
+	{
+		gl.invalidDeletes += gl.framebuffers.erase(framebuffers[i]) == 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// The destructor has to catch the missing `clear()`. A failed assertion aborts, which passes.
+	if (argc > 1 && std::strcmp(argv[1], "leak") == 0)
+	{
+		std::signal(SIGABRT, [](int) { std::_Exit(0); });
+		{
+			GlResourcePool pool;
+			acquire(&pool, keys[0]);
+		}
+		std::printf("FAILED: the pool was destroyed with a live texture and didn't assert\n");
+		return 1;
+	}
+
+	const uint64_t steps = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+	testReuse();
+	testEviction();
+	testSoak(steps);
+
+	check(gl.invalidDeletes == 0, "no GL object is deleted twice", 0, gl.invalidDeletes);
+	check(gl.invalidCalls == 0, "every GL call names a live object", 0, gl.invalidCalls);
+
+	if (failures > 0)
+	{
+		std::printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,73 @@
+// Times the conversion of a 1080p frame into common model input sizes, for each downloaded pixel
+// format and tensor layout.
+
+#include "PixelConversion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	void measure(PixelFormat format, const char* formatName, TensorLayout layout, tensorflow::DataType type, int size)
+	{
+		const int width = 1920;
+		const int height = 1080;
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * bytesPerPixel(format));
+		for (size_t i = 0; i < pixels.size(); ++i)
+		{
+			pixels[i] = static_cast<uint8_t>(i * 7);
+		}
+		if (format == PixelFormat::RGBA32F || format == PixelFormat::R32F)
+		{
+			float* values = reinterpret_cast<float*>(pixels.data());
+			for (size_t i = 0; i < pixels.size() / sizeof(float); ++i)
+			{
+				values[i] = (i % 255) / 255.0f;
+			}
+		}
+
+		InputFormat input;
+		input.layout = layout;
+		input.type = type;
+		input.channels = format == PixelFormat::R8 || format == PixelFormat::R32F ? 1 : 3;
+		PixelConverter converter;
+		converter.select(input);
+
+		tensorflow::Tensor tensor(input.type, input.shape(size, size));
+		Letterbox region;
+		region.y = (size - size * height / width) / 2;
+		region.width = size;
+		region.height = size * height / width;
+
+		const int runs = 50;
+		double best = 1e9;
+		for (int i = 0; i < runs; ++i)
+		{
+			const auto start = Clock::now();
+			converter.convert(pixels.data(), width, height, format, region, &tensor);
+			best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+		std::printf("%-8s -> %4dx%-4d %s %-5s %7.3f ms\n", formatName, size, size,
+					layout == TensorLayout::NCHW ? "NCHW" : "NHWC", type == tensorflow::DT_UINT8 ? "uint8" : "float", best);
+	}
+}
+
+int main()
+{
+	for (int size : { 224, 512 })
+	{
+		for (TensorLayout layout : { TensorLayout::NHWC, TensorLayout::NCHW })
+		{
+			measure(PixelFormat::BGRA8, "BGRA8", layout, tensorflow::DT_FLOAT, size);
+			measure(PixelFormat::BGRA8, "BGRA8", layout, tensorflow::DT_UINT8, size);
+			measure(PixelFormat::RGBA32F, "RGBA32F", layout, tensorflow::DT_FLOAT, size);
+			measure(PixelFormat::R8, "R8", layout, tensorflow::DT_FLOAT, size);
+		}
+	}
+	return 0;
+}
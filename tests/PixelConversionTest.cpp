@@ -0,0 +1,278 @@
+// Checks every conversion kernel (pixel format x tensor layout x channel order x input type, for 1 to
+// 4 channels, with each normalization) against a plain scalar resize, with letterboxing, crops and
+// mirroring. The reference follows `ResizeBilinear` (`align_corners = false`) directly, one output
+// value at a time. Conversions write into every slot of a batch, and must leave the others alone.
+
+#include "PixelConversion.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	const PixelFormat formats[] = { PixelFormat::BGRA8, PixelFormat::RGBA32F, PixelFormat::R8, PixelFormat::R32F };
+	const char* formatNames[] = { "BGRA8", "RGBA32F", "R8", "R32F" };
+	const Normalization normalizations[] = { Normalization::Centered, Normalization::Unit, Normalization::Raw };
+	const char* normalizationNames[] = { "centered", "unit", "raw" };
+
+	struct Image
+	{
+		PixelFormat format;
+		int width;
+		int height;
+		std::vector<uint8_t> bytes;
+		std::vector<float> floats;
+
+		const void* data() const
+		{
+			return bytes.empty() ? static_cast<const void*>(floats.data()) : static_cast<const void*>(bytes.data());
+		}
+
+		int components() const
+		{
+			return format == PixelFormat::BGRA8 || format == PixelFormat::RGBA32F ? 4 : 1;
+		}
+
+		// Model channel `c` (RGB(A) order) of a pixel, on the 0-255 scale.
+		double value(int x, int y, int c) const
+		{
+			int component = components() == 1 ? 0 : c;
+			if (format == PixelFormat::BGRA8 && c < 3)
+			{
+				component = 2 - c;
+			}
+			const size_t index = (static_cast<size_t>(y) * width + x) * components() + component;
+			return bytes.empty() ? floats[index] * 255.0 : bytes[index];
+		}
+	};
+
+	Image makeImage(PixelFormat format, int width, int height, std::mt19937& random)
+	{
+		Image image;
+		image.format = format;
+		image.width = width;
+		image.height = height;
+		const size_t size = static_cast<size_t>(width) * height * image.components();
+		std::uniform_int_distribution<int> byte(0, 255);
+		for (size_t i = 0; i < size; ++i)
+		{
+			if (format == PixelFormat::BGRA8 || format == PixelFormat::R8)
+			{
+				image.bytes.push_back(static_cast<uint8_t>(byte(random)));
+			}
+			else
+			{
+				// Beyond 1, as HDR sources are.
+				image.floats.push_back(byte(random) / 200.0f);
+			}
+		}
+		return image;
+	}
+
+	// The value the model should see at (x, y) of the region, for channel `c` in the model's order.
+	double reference(const Image& image, const Letterbox& crop, bool mirror, const Letterbox& region, const InputFormat& input, int x, int y, int c)
+	{
+		const int rgb = input.order == ChannelOrder::BGR && input.channels >= 3 && c < 3 ? 2 - c : c;
+		const int sampleX = mirror ? region.width - 1 - x : x;
+
+		const double inY = y * (static_cast<double>(crop.height) / region.height);
+		const double inX = sampleX * (static_cast<double>(crop.width) / region.width);
+		const int top = static_cast<int>(std::floor(inY));
+		const int left = static_cast<int>(std::floor(inX));
+		const int bottom = std::min(top + 1, crop.height - 1);
+		const int right = std::min(left + 1, crop.width - 1);
+		const double yLerp = inY - top;
+		const double xLerp = inX - left;
+
+		auto at = [&](int px, int py) { return image.value(crop.x + px, crop.y + py, rgb); };
+		const double upper = at(left, top) + (at(right, top) - at(left, top)) * xLerp;
+		const double lower = at(left, bottom) + (at(right, bottom) - at(left, bottom)) * xLerp;
+		return upper + (lower - upper) * yLerp;
+	}
+
+	// How much a step of 1 on the 0-255 scale moves a float input.
+	double normalizationScale(const InputFormat& input)
+	{
+		switch (input.normalization)
+		{
+		case Normalization::Unit:
+			return 1.0 / 255.0;
+		case Normalization::Raw:
+			return 1.0;
+		default:
+			return 1.0 / 128.0;
+		}
+	}
+
+	double normalize(double value, const InputFormat& input)
+	{
+		if (input.type == tensorflow::DT_UINT8)
+		{
+			return std::min(std::max(std::floor(value + 0.5), 0.0), 255.0);
+		}
+		return value * normalizationScale(input) - (input.normalization == Normalization::Centered ? 1.0 : 0.0);
+	}
+
+	// Conversions write into one slot of a batch of this many.
+	const int batchSize = 3;
+
+	size_t tensorIndex(const InputFormat& input, int batch, int height, int width, int x, int y, int c)
+	{
+		const size_t image = static_cast<size_t>(batch) * height * width * input.channels;
+		return image + (input.layout == TensorLayout::NCHW ?
+			(static_cast<size_t>(c) * height + y) * width + x :
+			(static_cast<size_t>(y) * width + x) * input.channels + c);
+	}
+
+	double tensorValue(const tensorflow::Tensor& tensor, const InputFormat& input, size_t index)
+	{
+		return input.type == tensorflow::DT_UINT8 ? tensor.flat<uint8_t>().data()[index] : tensor.flat<float>().data()[index];
+	}
+
+	void check(const Image& image, const InputFormat& input, const Letterbox& crop, bool mirror, const Letterbox& region, int height, int width, int batch, const char* name)
+	{
+		PixelConverter converter;
+		if (!converter.select(input))
+		{
+			std::printf("FAILED: %s: no kernel\n", name);
+			++failures;
+			return;
+		}
+
+		// Every other slot has to keep what was there.
+		const size_t count = static_cast<size_t>(batchSize) * height * width * input.channels;
+		const uint8_t untouched = 7;
+		tensorflow::Tensor tensor(input.type, input.shape(height, width, batchSize));
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (input.type == tensorflow::DT_UINT8)
+			{
+				tensor.flat<uint8_t>().data()[i] = untouched;
+			}
+			else
+			{
+				tensor.flat<float>().data()[i] = untouched;
+			}
+		}
+
+		const tensorflow::Status status = converter.convert(image.data(), image.width, image.height, image.format, crop, region, &tensor, batch, mirror);
+		if (!status.ok())
+		{
+			std::printf("FAILED: %s: conversion failed\n", name);
+			++failures;
+			return;
+		}
+
+		// Values are rounded differently along the way, so 8-bit values may be off by one.
+		const double tolerance = input.type == tensorflow::DT_UINT8 ? 1.0 : 0.0128 * normalizationScale(input);
+		double worst = 0.0;
+		size_t overwritten = 0;
+		for (int slot = 0; slot < batchSize; ++slot)
+		{
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					const bool inside = x >= region.x && x < region.x + region.width && y >= region.y && y < region.y + region.height;
+					for (int c = 0; c < input.channels; ++c)
+					{
+						const double value = tensorValue(tensor, input, tensorIndex(input, slot, height, width, x, y, c));
+						if (slot != batch)
+						{
+							overwritten += value != untouched;
+							continue;
+						}
+						const double expected = normalize(inside ? reference(image, crop, mirror, region, input, x - region.x, y - region.y, c) : 128.0, input);
+						worst = std::max(worst, std::fabs(value - expected));
+					}
+				}
+			}
+		}
+		if (worst > tolerance)
+		{
+			std::printf("FAILED: %s, slot %d: off by %g\n", name, batch, worst);
+			++failures;
+		}
+		else if (overwritten > 0)
+		{
+			std::printf("FAILED: %s, slot %d: %zu value(s) of other slots were overwritten\n", name, batch, overwritten);
+			++failures;
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	int cases = 0;
+
+	for (int f = 0; f < 4; ++f)
+	{
+		const Image image = makeImage(formats[f], 37, 23, random);
+		for (TensorLayout layout : { TensorLayout::NHWC, TensorLayout::NCHW })
+		{
+			for (ChannelOrder order : { ChannelOrder::RGB, ChannelOrder::BGR })
+			{
+				for (tensorflow::DataType type : { tensorflow::DT_FLOAT, tensorflow::DT_UINT8 })
+				{
+					// 8-bit inputs ignore the normalization, which is checked too.
+					for (int n = 0; n < 3; ++n)
+					{
+						for (int channels = 1; channels <= 4; ++channels)
+						{
+							InputFormat input;
+							input.layout = layout;
+							input.order = order;
+							input.normalization = normalizations[n];
+							input.type = type;
+							input.channels = channels;
+
+							char name[128];
+							std::snprintf(name, sizeof(name), "%s -> %s %s %s %s, %d channel(s)", formatNames[f],
+										  layout == TensorLayout::NCHW ? "NCHW" : "NHWC", order == ChannelOrder::BGR ? "BGR" : "RGB",
+										  type == tensorflow::DT_UINT8 ? "uint8" : "float", normalizationNames[n], channels);
+
+							Letterbox whole;
+							whole.width = image.width;
+							whole.height = image.height;
+							Letterbox crop;
+							crop.x = 5;
+							crop.y = 3;
+							crop.width = 20;
+							crop.height = 17;
+
+							// Downscaled and letterboxed, upscaled from a crop, and mirrored.
+							Letterbox region;
+							region.x = 0;
+							region.y = 3;
+							region.width = 16;
+							region.height = 10;
+							check(image, input, whole, false, region, 16, 16, 0, name);
+
+							region.x = 2;
+							region.y = 1;
+							region.width = 41;
+							region.height = 29;
+							check(image, input, crop, false, region, 32, 48, 1, name);
+							check(image, input, crop, true, region, 32, 48, 2, name);
+							cases += 3;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (failures > 0)
+	{
+		std::printf("%d of %d case(s) failed\n", failures, cases);
+		return 1;
+	}
+	std::printf("All %d cases passed\n", cases);
+	return 0;
+}
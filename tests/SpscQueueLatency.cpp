@@ -0,0 +1,86 @@
+// Latency microbenchmark for SpscQueue: the producer stamps every item with the time it was pushed,
+// and a spinning consumer measures how long each one took to come out. Reports percentiles of that
+// latency and the throughput, for a queue that mostly sits empty (paced pushes, as frames arrive) and
+// for one that is kept full (pushes as fast as possible). Both sides yield while they wait, so the
+// numbers stay meaningful on machines with fewer cores than threads.
+
+#include "SpscQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	struct Item
+	{
+		Clock::time_point pushed;
+	};
+
+	void measure(const char* name, size_t capacity, size_t count, std::chrono::nanoseconds pacing)
+	{
+		std::vector<Item> items(count);
+		std::vector<double> latencies;
+		latencies.reserve(count);
+		SpscQueue<Item> queue(capacity, SpscQueue<Item>::Policy::RejectNewest);
+
+		std::thread consumer([&]()
+		{
+			Item* item = nullptr;
+			while (latencies.size() < count)
+			{
+				if (queue.pop(&item))
+				{
+					latencies.push_back(std::chrono::duration<double, std::nano>(Clock::now() - item->pushed).count());
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		const auto start = Clock::now();
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (pacing.count() > 0)
+			{
+				const auto due = start + pacing * i;
+				while (Clock::now() < due)
+				{
+					std::this_thread::yield();
+				}
+			}
+			items[i].pushed = Clock::now();
+			while (!queue.push(&items[i]))
+			{
+				std::this_thread::yield();
+			}
+		}
+		consumer.join();
+		const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		std::sort(latencies.begin(), latencies.end());
+		const auto percentile = [&latencies](double p)
+		{
+			return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+		};
+		std::printf("%-24s p50 %8.0f ns  p99 %8.0f ns  p99.9 %8.0f ns  max %10.0f ns  %6.2f M items/s\n",
+					name, percentile(0.5), percentile(0.99), percentile(0.999), latencies.back(), count / seconds / 1e6);
+	}
+}
+
+int main()
+{
+	const size_t count = 1000000;
+	measure("paced (every 2 us)", 4, count / 10, std::chrono::microseconds(2));
+	measure("saturated, capacity 4", 4, count, std::chrono::nanoseconds(0));
+	measure("saturated, capacity 64", 64, count, std::chrono::nanoseconds(0));
+	return 0;
+}
@@ -0,0 +1,150 @@
+// Stress test for SpscQueue: one producer and one consumer thread exchange a few million items
+// through a small queue, under both full-queue policies. Every item carries its sequence number, so
+// the consumer can check that items arrive in order and exactly once, and that the items that were
+// dropped add up to the queue's own counts. Built a second time with ThreadSanitizer.
+
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool condition, const char* what, uint64_t expected, uint64_t actual)
+	{
+		if (!condition)
+		{
+			std::printf("FAILED: %s (expected %llu, got %llu)\n", what, static_cast<unsigned long long>(expected), static_cast<unsigned long long>(actual));
+			++failures;
+		}
+	}
+
+	struct Result
+	{
+		uint64_t received = 0;
+		uint64_t dropped = 0;
+		uint64_t outOfOrder = 0;
+		uint64_t duplicates = 0;
+	};
+
+	// Pushes `count` items through a queue of `capacity`. With `retry`, rejected pushes are repeated
+	// until they succeed, so nothing may be lost.
+	Result exchange(typename SpscQueue<uint64_t>::Policy policy, size_t capacity, uint64_t count, bool retry)
+	{
+		std::vector<uint64_t> items(count);
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			items[i] = i;
+		}
+
+		SpscQueue<uint64_t> queue(capacity, policy);
+		std::atomic<bool> producing(true);
+		Result result;
+
+		std::thread consumer([&]()
+		{
+			std::vector<bool> seen(count, false);
+			uint64_t* item = nullptr;
+			bool any = false;
+			uint64_t last = 0;
+			while (true)
+			{
+				// Checked before popping, so that items pushed just before the flag drops are still taken.
+				const bool finished = !producing.load(std::memory_order_acquire);
+				if (!queue.pop(&item))
+				{
+					if (finished)
+					{
+						break;
+					}
+					std::this_thread::yield();
+					continue;
+				}
+
+				const uint64_t value = *item;
+				if (any && value <= last)
+				{
+					++result.outOfOrder;
+				}
+				if (seen[value])
+				{
+					++result.duplicates;
+				}
+				seen[value] = true;
+				last = value;
+				any = true;
+				++result.received;
+			}
+		});
+
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			uint64_t* evicted = nullptr;
+			while (!queue.push(&items[i], &evicted))
+			{
+				if (!retry)
+				{
+					++result.dropped;
+					break;
+				}
+				std::this_thread::yield();
+			}
+			if (evicted != nullptr)
+			{
+				++result.dropped;
+			}
+		}
+		producing.store(false, std::memory_order_release);
+		consumer.join();
+
+		const uint64_t counted = policy == SpscQueue<uint64_t>::Policy::OverwriteOldest ? queue.overwrittenCount() : queue.rejectedCount();
+		if (!retry)
+		{
+			check(counted == result.dropped, "queue's drop count matches the producer's", result.dropped, counted);
+		}
+		check(queue.empty(), "queue is drained", 0, queue.size());
+		return result;
+	}
+
+	void run(const char* name, typename SpscQueue<uint64_t>::Policy policy, size_t capacity, uint64_t count, bool retry)
+	{
+		const Result result = exchange(policy, capacity, count, retry);
+		std::printf("%s: capacity %zu, %llu items, %llu received, %llu dropped\n", name, capacity,
+					static_cast<unsigned long long>(count), static_cast<unsigned long long>(result.received), static_cast<unsigned long long>(result.dropped));
+
+		check(result.outOfOrder == 0, "items arrive in order", 0, result.outOfOrder);
+		check(result.duplicates == 0, "items arrive at most once", 0, result.duplicates);
+		check(result.received + result.dropped == count, "every item is either received or dropped", count, result.received + result.dropped);
+		if (retry)
+		{
+			check(result.dropped == 0, "nothing is dropped when rejected pushes are retried", 0, result.dropped);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// ThreadSanitizer slows everything down, so its build passes a smaller count.
+	const uint64_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+
+	for (size_t capacity : { 1, 2, 4, 64 })
+	{
+		run("RejectNewest, retried", SpscQueue<uint64_t>::Policy::RejectNewest, capacity, count, true);
+		run("RejectNewest, dropped", SpscQueue<uint64_t>::Policy::RejectNewest, capacity, count, false);
+		run("OverwriteOldest", SpscQueue<uint64_t>::Policy::OverwriteOldest, capacity, count, false);
+	}
+
+	if (failures > 0)
+	{
+		std::printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,186 @@
+// Checks `fingerprintTile` against a plain per-pixel average, for every pixel format, with tiles at
+// odd offsets and cells whose rows aren't a whole number of vectors (16 bytes, 4 floats), so that
+// both the vectorized sums and their scalar tails are covered. Alpha must not count: changing it
+// alone leaves the fingerprint as it was.
+
+#include "TileFingerprint.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	const PixelFormat formats[] = { PixelFormat::BGRA8, PixelFormat::RGBA32F, PixelFormat::R8, PixelFormat::R32F };
+	const char* formatNames[] = { "BGRA8", "RGBA32F", "R8", "R32F" };
+
+	struct Image
+	{
+		int width;
+		int height;
+		int components;
+		bool floats;
+		std::vector<uint8_t> bytes;
+		std::vector<float> values;
+
+		const void* data() const
+		{
+			return floats ? static_cast<const void*>(values.data()) : static_cast<const void*>(bytes.data());
+		}
+
+		// A component's value on the 0-1 scale.
+		double value(int x, int y, int c) const
+		{
+			const size_t i = (static_cast<size_t>(y) * width + x) * components + c;
+			return floats ? values[i] : bytes[i] / 255.0;
+		}
+	};
+
+	Image makeImage(PixelFormat format, int width, int height, std::mt19937* random)
+	{
+		Image image;
+		image.width = width;
+		image.height = height;
+		image.floats = format == PixelFormat::RGBA32F || format == PixelFormat::R32F;
+		image.components = format == PixelFormat::BGRA8 || format == PixelFormat::RGBA32F ? 4 : 1;
+		const size_t count = static_cast<size_t>(width) * height * image.components;
+		std::uniform_int_distribution<int> byte(0, 255);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (image.floats)
+			{
+				image.values.push_back(unit(*random));
+			}
+			else
+			{
+				image.bytes.push_back(static_cast<uint8_t>(byte(*random)));
+			}
+		}
+		return image;
+	}
+
+	// The average of the color components (all but alpha) over each cell, one pixel at a time.
+	TileFingerprint referenceFingerprint(const Image& image, const Letterbox& tile)
+	{
+		const int colors = image.components == 4 ? 3 : image.components;
+		TileFingerprint fingerprint;
+		for (int cellY = 0; cellY < 4; ++cellY)
+		{
+			const int top = tile.y + (tile.height * cellY) / 4;
+			const int bottom = tile.y + (tile.height * (cellY + 1)) / 4;
+			for (int cellX = 0; cellX < 4; ++cellX)
+			{
+				const int left = tile.x + (tile.width * cellX) / 4;
+				const int right = tile.x + (tile.width * (cellX + 1)) / 4;
+				double sum = 0.0;
+				size_t total = 0;
+				for (int y = top; y < bottom; ++y)
+				{
+					for (int x = left; x < right; ++x)
+					{
+						for (int c = 0; c < colors; ++c)
+						{
+							sum += image.value(x, y, c);
+							++total;
+						}
+					}
+				}
+				fingerprint[cellY * 4 + cellX] = total > 0 ? static_cast<float>(sum / total) : 0.0f;
+			}
+		}
+		return fingerprint;
+	}
+
+	void compare(const char* formatName, int width, const Letterbox& tile, const TileFingerprint& expected, const TileFingerprint& actual)
+	{
+		for (int cell = 0; cell < 16; ++cell)
+		{
+			// The float sums are accumulated in single precision, four lanes at a time.
+			if (std::fabs(expected[cell] - actual[cell]) > 1e-5f)
+			{
+				std::printf("FAILED: %s, %d pixels wide, tile %dx%d at %d,%d, cell %d: expected %f, got %f\n", formatName, width,
+							tile.width, tile.height, tile.x, tile.y, cell, expected[cell], actual[cell]);
+				++failures;
+				return;
+			}
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 random(3);
+	int tiles = 0;
+	for (int f = 0; f < 4; ++f)
+	{
+		const PixelFormat format = formats[f];
+		for (int width : { 4, 5, 7, 9, 15, 17, 23, 31, 33, 47, 63, 65, 100, 131 })
+		{
+			const int height = 21;
+			Image image = makeImage(format, width, height, &random);
+
+			// Whole images, and tiles at odd offsets whose cells are 1 to 32 pixels wide.
+			std::vector<Letterbox> regions;
+			Letterbox whole;
+			whole.width = width;
+			whole.height = height;
+			regions.push_back(whole);
+			for (int tileWidth = 4; tileWidth <= width - 1; tileWidth += 3)
+			{
+				Letterbox tile;
+				tile.x = 1 + (width - tileWidth) / 2;
+				tile.y = 3;
+				tile.width = tileWidth;
+				tile.height = 13;
+				regions.push_back(tile);
+			}
+
+			for (const Letterbox& tile : regions)
+			{
+				TileFingerprint actual;
+				fingerprintTile(image.data(), width, format, tile, &actual);
+				compare(formatNames[f], width, tile, referenceFingerprint(image, tile), actual);
+
+				// The same pixels with different alpha.
+				if (image.components == 4)
+				{
+					Image changed = image;
+					for (size_t i = 3; i < (changed.floats ? changed.values.size() : changed.bytes.size()); i += 4)
+					{
+						if (changed.floats)
+						{
+							changed.values[i] = 1.0f - changed.values[i];
+						}
+						else
+						{
+							changed.bytes[i] = static_cast<uint8_t>(255 - changed.bytes[i]);
+						}
+					}
+					TileFingerprint changedAlpha;
+					fingerprintTile(changed.data(), width, format, tile, &changedAlpha);
+					const float distance = fingerprintDistance(actual, changedAlpha);
+					if (distance != 0.0f)
+					{
+						std::printf("FAILED: %s, %d pixels wide: changing alpha moved the fingerprint by %f\n", formatNames[f], width, distance);
+						++failures;
+					}
+				}
+				++tiles;
+			}
+		}
+	}
+	std::printf("%d tiles compared with the reference\n", tiles);
+
+	if (failures > 0)
+	{
+		std::printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}